@@ -31,9 +31,9 @@ SOURCES+= ../src/libraw_datastream.cpp ../src/decoders/canon_600.cpp \
 	../src/decoders/decoders_libraw_dcrdefs.cpp ../src/decoders/pana8.cpp \
 	../src/decompressors/losslessjpeg.cpp ../src/decoders/sonycc.cpp \
 	../src/decoders/olympus14.cpp \
-	../src/decoders/decoders_libraw.cpp ../src/decoders/dng.cpp \
+	../src/decoders/decoders_libraw.cpp ../src/decoders/dng.cpp ../src/decoders/dng_opcodes.cpp \
 	../src/decoders/fp_dng.cpp ../src/decoders/fuji_compressed.cpp \
-	../src/decoders/generic.cpp ../src/decoders/kodak_decoders.cpp \
+	../src/decoders/generic.cpp ../src/decoders/raw_rows.cpp ../src/decoders/kodak_decoders.cpp \
 	../src/decoders/load_mfbacks.cpp ../src/decoders/smal.cpp \
 	../src/decoders/unpack_thumb.cpp ../src/decoders/unpack.cpp \
 	../src/demosaic/aahd_demosaic.cpp ../src/demosaic/ahd_demosaic.cpp \
@@ -53,18 +53,18 @@ SOURCES+= ../src/libraw_datastream.cpp ../src/decoders/canon_600.cpp \
 	../src/metadata/p1.cpp ../src/metadata/pentax.cpp \
 	../src/metadata/samsung.cpp ../src/metadata/sony.cpp \
 	../src/metadata/tiff.cpp ../src/postprocessing/aspect_ratio.cpp \
-	../src/postprocessing/dcraw_process.cpp ../src/postprocessing/mem_image.cpp \
+	../src/postprocessing/dcraw_process.cpp ../src/postprocessing/render_cache.cpp ../src/postprocessing/fused_output.cpp ../src/postprocessing/output_resample.cpp ../src/postprocessing/mem_image.cpp \
 	../src/postprocessing/postprocessing_aux.cpp \
 	../src/postprocessing/postprocessing_utils_dcrdefs.cpp \
 	../src/postprocessing/postprocessing_utils.cpp \
-	../src/preprocessing/ext_preprocess.cpp ../src/preprocessing/raw2image.cpp \
+	../src/preprocessing/ext_preprocess.cpp ../src/preprocessing/calibration_data.cpp ../src/preprocessing/raw2image.cpp \
 	../src/preprocessing/subtract_black.cpp ../src/tables/cameralist.cpp \
-	../src/tables/colorconst.cpp ../src/tables/colordata.cpp \
+	../src/tables/colorconst.cpp ../src/tables/luts.cpp ../src/tables/colordata.cpp \
 	../src/tables/wblists.cpp ../src/utils/curves.cpp \
 	../src/utils/decoder_info.cpp ../src/utils/init_close_utils.cpp \
 	../src/utils/open.cpp ../src/utils/phaseone_processing.cpp \
-	../src/utils/read_utils.cpp ../src/utils/thumb_utils.cpp \
-	../src/utils/utils_dcraw.cpp ../src/utils/utils_libraw.cpp \
+	../src/utils/read_utils.cpp ../src/utils/thumb_utils.cpp ../src/utils/frames.cpp ../src/utils/snapshot.cpp \
+	../src/utils/utils_dcraw.cpp ../src/utils/utils_libraw.cpp ../src/utils/raw_stats.cpp \
 	../src/write/apply_profile.cpp ../src/write/file_write.cpp \
 	../src/write/tiff_writer.cpp ../src/x3f/x3f_parse_process.cpp \
 	../src/x3f/x3f_utils_patched.cpp \
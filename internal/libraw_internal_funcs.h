@@ -21,6 +21,10 @@ it under the terms of the one of two licenses as you choose:
 #error "This file should be used only for libraw library build"
 #else
 
+/* AHD tile size: 26*TILE*TILE bytes of per-thread scratch, keep it
+   L2-sized. Sizes ahd_interpolate_*() array parameters, not configurable */
+#define LIBRAW_AHD_TILE 128
+
 /* inline functions */
 	static int stread(char *buf, size_t len, LibRaw_abstract_datastream *fp);
 	static int getwords(char *line, char *words[], int maxwords, int maxlen);
@@ -61,6 +65,35 @@ it under the terms of the one of two licenses as you choose:
 	void    parseCR3_Free();
 	int     parseCR3_CTMD(short trackNum);
 	int     selectCRXFrame(short trackNum, unsigned frameIndex);
+	void    init_frame_index();
+	void    free_frame_index();
+	int     open_datastream_tail();
+	bool    snapshot_select_decoder(const char *name);
+	bool    snapshot_restore(const uchar *data, size_t size);
+	unsigned raw_rows_block_size();
+	ushort *raw_rows_block(unsigned block);
+	void    raw_rows_decode(unsigned block, unsigned block_rows, ushort *dst);
+	void    free_raw_rows_cache();
+	int     render_cache_restore();
+	void    render_cache_store(int stage);
+	void    free_render_cache();
+	void    apply_user_flip();
+	void    fused_output_init(float out_cam[3][4]);
+	void    fused_output_reset();
+	void    fused_output_histogram();
+	ushort  (*fused_output_grid())[4];
+	void    fused_output_row(int soff, int cstep, int count, ushort (*out)[4]);
+	void    mem_image_gamma_curve();
+	void    mem_image_geometry(int *soff, int *cstep, int *rstep, int *width, int *height);
+	void    output_target_size(int width, int height, int *twidth, int *theight) const;
+	int     output_auto_half();
+	void    output_row_linear(int soff, int cstep, int count, ushort (*out)[4]);
+	int     output_resampled_rows(int soff, int cstep, int rstep, int width, int height,
+                                  int twidth, int theight, int y0, int y1,
+                                  void (*sink)(void *ctx, int row, const ushort (*data)[4]),
+                                  void *ctx);
+	void    publish_raw_rows(int row_end);
+	void    set_raw_rows_ready(unsigned rows);
 	void	setCanonBodyFeatures (unsigned long long id);
 	void	processCanonCameraInfo (unsigned long long id, uchar *CameraInfo, unsigned maxlen, unsigned type, unsigned dng_writer);
 	static float _CanonConvertAperture(ushort in);
@@ -135,6 +168,7 @@ it under the terms of the one of two licenses as you choose:
 	float		getrealf(int type) { return float(getreal(type)); }
 	double      sgetreal(int type, uchar *s);
 	void        read_shorts (ushort *pixel, unsigned count);
+	void        read_shorts_rows (ushort *pixel, unsigned rows, unsigned rowlen);
 
 /* Canon P&S cameras */
 	void        canon_600_fixed_wb (int temp);
@@ -164,6 +198,7 @@ it under the terms of the one of two licenses as you choose:
 	void        crw_init_tables (unsigned table, ushort *huff[2]);
 	int         canon_has_lowbits();
 	void        canon_load_raw();
+	int         canon_crw_decode_groups(ushort *huff[2], int lowbits);
 	void        lossless_jpeg_load_raw();
 	void        canon_sraw_load_raw();
 // Adobe DNG
@@ -172,8 +207,16 @@ it under the terms of the one of two licenses as you choose:
 	void        deflate_dng_load_raw();
 	void        packed_dng_load_raw();
     void        packed_tiled_dng_load_raw();
+	int         packed_dng_fastpath();
+	void        packed_dng_copy_rows(const uchar *data, unsigned ntiles, unsigned rows, unsigned rowbytes, unsigned row0, unsigned tile_w, int linear_curve);
     void        uncompressed_fp_dng_load_raw();
+	float       fp_int_scale(float dmin, float dmax, float dtarget);
+	void        set_int_rawdata(ushort *raw_alloc, int samples);
+	void        convertHalfToInt(ushort *data, int samples);
 	void        lossy_dng_load_raw();
+	void        apply_dng_opcodes();
+	int         dng_opcodes_pending();
+	int         apply_dng_opcode_list(const uchar *data, unsigned len, int stage);
 //void        adobe_dng_load_raw_nc();
 
 // Pentax
@@ -222,6 +265,7 @@ it under the terms of the one of two licenses as you choose:
 	void        phase_one_load_raw_c();
     void		phase_one_load_raw_s();
 	void        hasselblad_load_raw();
+	int         hasselblad_decode_rows(struct jhead *jh, int shot, int sh);
 	void        leaf_hdr_load_raw();
 	void        sinar_4shot_load_raw();
 	void        imacon_full_load_raw();
@@ -280,6 +324,8 @@ it under the terms of the one of two licenses as you choose:
 	void        jxl_dng_load_raw_placeholder();
 // It's a Sony (and K&M)
 	void        sony_decrypt (unsigned *data, int len, int start, int key);
+	static void sony_decrypt_init(unsigned *pad, unsigned key);
+	static void sony_decrypt_at(const unsigned *pad, INT64 pos, unsigned *data, int len);
 	void        sony_load_raw();
 	void        sony_arw_load_raw();
 	void        sony_arw2_load_raw();
@@ -339,6 +385,7 @@ it under the terms of the one of two licenses as you choose:
 	void        parse_exif (INT64 base);
 	void        parse_exif_interop(INT64 base);
 	void        linear_table(unsigned len);
+	void        tiff_ifd_alloc_black(int ifd);
 	void        Kodak_DCR_WBtags(int wb, unsigned type, int wbi);
 	void        Kodak_KDC_WBtags(int wb, int wbi);
 	short       KodakIllumMatrix (unsigned type, float *romm_camIllum);
@@ -384,6 +431,7 @@ it under the terms of the one of two licenses as you choose:
 	int  crxParseImageHeader(uchar *cmp1TagData, int nTrack, INT64 size);
 	void panasonicC6_load_raw();
 	void panasonicC7_load_raw();
+	void panasonicCS_read_rows(int rowbytes, int kind);
 	void panasonicC8_load_raw();
 
 	void nikon_14bit_load_raw();
@@ -102,6 +102,12 @@ extern "C"
 #endif
 
   DllDef int libraw_open_buffer(libraw_data_t *, const void *buffer, size_t size);
+  DllDef int libraw_save_snapshot(libraw_data_t *, void **snapshot,
+                                  size_t *snapshot_size);
+  DllDef void libraw_free_snapshot(void *snapshot);
+  DllDef int libraw_open_file_with_snapshot(libraw_data_t *, const char *fname,
+                                            const void *snapshot,
+                                            size_t snapshot_size);
   DllDef int libraw_open_bayer(libraw_data_t *lr, unsigned char *data,
                                unsigned datalen, ushort _raw_width,
                                ushort _raw_height, ushort _left_margin,
@@ -111,6 +117,18 @@ extern "C"
                                unsigned unused_bits, unsigned otherflags,
                                unsigned black_level);
   DllDef int libraw_unpack(libraw_data_t *);
+  DllDef int libraw_frame_count(libraw_data_t *);
+  DllDef size_t libraw_frame_buffer_size(libraw_data_t *);
+  DllDef int libraw_select_frame(libraw_data_t *, unsigned frame);
+  DllDef int libraw_unpack_frame(libraw_data_t *, unsigned frame, void *buffer,
+                                 size_t buffer_size);
+  DllDef int libraw_get_raw_rows(libraw_data_t *, unsigned first,
+                                 unsigned count, ushort *dst);
+  DllDef int libraw_get_raw_stats(libraw_data_t *, libraw_raw_stats_t *stats,
+                                  unsigned step);
+  DllDef unsigned libraw_raw_rows_ready(libraw_data_t *);
+  DllDef libraw_processed_image_t *
+  libraw_make_mem_rows_preview(libraw_data_t *lr, int scale, int *errc);
   DllDef int libraw_unpack_thumb(libraw_data_t *);
   DllDef int libraw_unpack_thumb_ex(libraw_data_t *,int);
   DllDef void libraw_recycle_datastream(libraw_data_t *);
@@ -137,6 +155,8 @@ extern "C"
                                            void *datap);
   DllDef void libraw_set_progress_handler(libraw_data_t *, progress_callback cb,
                                           void *datap);
+  DllDef void libraw_set_rows_handler(libraw_data_t *, rows_callback cb,
+                                      void *datap);
   DllDef const char *libraw_unpack_function_name(libraw_data_t *lr);
   DllDef int libraw_get_decoder_info(libraw_data_t *lr,
                                      libraw_decoder_info_t *d);
@@ -154,7 +174,19 @@ extern "C"
   libraw_dcraw_make_mem_image(libraw_data_t *lr, int *errc);
   DllDef libraw_processed_image_t *
   libraw_dcraw_make_mem_thumb(libraw_data_t *lr, int *errc);
+  DllDef libraw_processed_image_t *
+  libraw_dcraw_make_mem_jpeg(libraw_data_t *lr, int quality, int *errc);
   DllDef void libraw_dcraw_clear_mem(libraw_processed_image_t *);
+  DllDef int libraw_load_dark_frame(libraw_dark_frame_t *df,
+                                    const char *fname);
+  DllDef int libraw_dark_frame_from_buffer(libraw_dark_frame_t *df,
+                                           void *buffer, size_t size);
+  DllDef int libraw_save_dark_frame(const libraw_dark_frame_t *df,
+                                    const char *fname);
+  DllDef void libraw_free_dark_frame(libraw_dark_frame_t *df);
+  DllDef int libraw_load_bad_pixels(libraw_bad_pixels_t *bp,
+                                    const char *fname);
+  DllDef void libraw_free_bad_pixels(libraw_bad_pixels_t *bp);
   /* getters/setters used by 3DLut Creator */
   DllDef void libraw_set_demosaic(libraw_data_t *lr, int value);
   DllDef void libraw_set_output_color(libraw_data_t *lr, int value);
@@ -208,6 +240,13 @@ public:
 #endif
   int open_buffer(const void *buffer, size_t size);
   virtual int open_datastream(LibRaw_abstract_datastream *);
+  /* metadata snapshot: reopen without identify() */
+  int save_snapshot(void **snapshot, size_t *snapshot_size);
+  static void free_snapshot(void *snapshot);
+  int open_with_snapshot(LibRaw_abstract_datastream *stream,
+                         const void *snapshot, size_t snapshot_size);
+  int open_file_with_snapshot(const char *fname, const void *snapshot,
+                              size_t snapshot_size);
   virtual int open_bayer(const unsigned char *data, unsigned datalen,
                          ushort _raw_width, ushort _raw_height,
                          ushort _left_margin, ushort _top_margin,
@@ -218,6 +257,19 @@ public:
   int error_count() { return libraw_internal_data.unpacker_data.data_error; }
   void recycle_datastream();
   int unpack(void);
+  /* multi-frame files: CR3 bursts, CINE, pixel shift */
+  int frame_count();
+  size_t frame_buffer_size();
+  int select_frame(unsigned frame);
+  int unpack_frame(unsigned frame, void *buffer = NULL, size_t buffer_size = 0);
+  /* raw rows access without full unpack() */
+  int get_raw_rows(unsigned first, unsigned count, ushort *dst);
+  /* one pass statistics over unpacked raw data */
+  int get_raw_stats(libraw_raw_stats_t *stats, unsigned step = 1);
+  /* progressive unpack: rows of raw_image decoded so far and preview */
+  unsigned raw_rows_ready();
+  libraw_processed_image_t *make_mem_rows_preview(int scale,
+                                                  int *errcode = NULL);
   int unpack_thumb(void);
   int unpack_thumb_ex(int);
   int thumbOK(INT64 maxsz = -1);
@@ -250,6 +302,11 @@ public:
     callbacks.progresscb_data = data;
     callbacks.progress_cb = pcb;
   }
+  void set_rows_handler(rows_callback cb, void *data)
+  {
+    callbacks.rowscb_data = data;
+    callbacks.rows_cb = cb;
+  }
 
   static const char* cameramakeridx2maker(unsigned maker);
   int setMakeFromIndex(unsigned index);
@@ -287,8 +344,20 @@ public:
   /* memory writers */
   virtual libraw_processed_image_t *dcraw_make_mem_image(int *errcode = NULL);
   virtual libraw_processed_image_t *dcraw_make_mem_thumb(int *errcode = NULL);
+  libraw_processed_image_t *dcraw_make_mem_jpeg(int quality,
+                                                int *errcode = NULL);
   static void dcraw_clear_mem(libraw_processed_image_t *);
 
+  /* preparsed dark frame and bad pixels map (imgdata.params.dark_frame_data,
+     imgdata.params.bad_pixels_data) */
+  static int load_dark_frame(libraw_dark_frame_t *df, const char *fname);
+  static int dark_frame_from_buffer(libraw_dark_frame_t *df, void *buffer,
+                                    size_t size);
+  static int save_dark_frame(const libraw_dark_frame_t *df, const char *fname);
+  static void free_dark_frame(libraw_dark_frame_t *df);
+  static int load_bad_pixels(libraw_bad_pixels_t *bp, const char *fname);
+  static void free_bad_pixels(libraw_bad_pixels_t *bp);
+
   /* Additional calls for make_mem_image */
   void get_mem_image_format(int *width, int *height, int *colors,
                             int *bps) const;
@@ -374,6 +443,8 @@ protected:
   virtual void convert_to_rgb_loop(float out_cam[3][4]);
   virtual void lin_interpolate_loop(int *code, int size);
   virtual void scale_colors_loop(float scale_mul[4]);
+  /* Pixel shift merge (Pentax/Sinar 4-shot), override for motion-robust merge */
+  virtual void multishot_merge(struct libraw_multishot_t *ms);
 
   /* Fujifilm compressed decoder public interface (to make parallel decoder) */
   virtual void
@@ -446,7 +517,7 @@ protected:
   void lin_interpolate();
   void vng_interpolate();
   void ppg_interpolate();
-  void cielab(ushort rgb[3], short lab[3]);
+  void cielab(ushort rgb[3], short lab[3], const float *cbrt = 0);
   void xtrans_interpolate(int);
   void ahd_interpolate();
   void dht_interpolate();
@@ -457,7 +528,9 @@ protected:
   void exp_bef(float expos, float preser);
 
   void bad_pixels(const char *);
-  void subtract(const char *);
+  void bad_pixels(const libraw_bad_pixels_t *);
+  int subtract(const char *);
+  int subtract(const libraw_dark_frame_t *);
   void hat_transform(float *temp, float *base, int st, int size, int sc);
   void wavelet_denoise();
   void scale_colors();
@@ -76,7 +76,31 @@ LIBRAW_MEMPOOL_CHECK define will result in error on pool overflow */
 #define LIBRAW_CRXTRACKS_MAXCOUNT 16
 #define LIBRAW_AFDATA_MAXCOUNT 4
 
-#define LIBRAW_AHD_TILE 512
+/* X-Trans (Markesteijn) tile size; tile size affects X-Trans output */
+#define LIBRAW_XTRANS_TILE 512
+/* get_raw_rows(): rows per cached block (DNG tiles: tile height) and
+   number of cached blocks */
+#ifndef LIBRAW_RAWROWS_BLOCK
+#define LIBRAW_RAWROWS_BLOCK 64
+#endif
+#ifndef LIBRAW_RAWROWS_CACHE
+#define LIBRAW_RAWROWS_CACHE 8
+#endif
+/* get_raw_stats(): histogram bins per channel, bin is value >> 3 */
+#define LIBRAW_RAWSTATS_HISTOGRAM_SIZE 0x2000
+/* save_snapshot()/open_with_snapshot(): format version and number of
+   file header bytes hashed for validation */
+#define LIBRAW_SNAPSHOT_VERSION 1
+#define LIBRAW_SNAPSHOT_HEADBYTES 4096
+/* imgdata.params.fused_output: ICC transform is sampled on
+   LIBRAW_FUSED_LUT_SIZE^3 grid */
+#ifndef LIBRAW_FUSED_LUT_SIZE
+#define LIBRAW_FUSED_LUT_SIZE 33
+#endif
+/* dcraw_make_mem_jpeg(): rows of MCUs per independently encoded strip */
+#ifndef LIBRAW_MEMJPEG_STRIP_MCUROWS
+#define LIBRAW_MEMJPEG_STRIP_MCUROWS 8
+#endif
 
 #ifndef LIBRAW_NO_IOSTREAMS_DATASTREAM
 
@@ -262,7 +286,8 @@ enum LibRaw_dng_processing
 enum LibRaw_output_flags
 {
     LIBRAW_OUTPUT_FLAGS_NONE = 0,
-    LIBRAW_OUTPUT_FLAGS_PPMMETA = 1
+    LIBRAW_OUTPUT_FLAGS_PPMMETA = 1,
+    LIBRAW_OUTPUT_FLAGS_AUTO_HALFSIZE = 1 << 1
 };
 
 enum LibRaw_runtime_capabilities
@@ -678,7 +703,26 @@ enum LibRaw_processing_options
   LIBRAW_RAWOPTIONS_DNG_STAGE3_IFPRESENT = 1 << 21,
   LIBRAW_RAWOPTIONS_DNG_ADD_MASKS = 1 << 22,
   LIBRAW_RAWOPTIONS_CANON_IGNORE_MAKERNOTES_ROTATION = 1 << 23,
-  LIBRAW_RAWOPTIONS_ALLOW_JPEGXL_PREVIEWS = 1 << 24
+  LIBRAW_RAWOPTIONS_ALLOW_JPEGXL_PREVIEWS = 1 << 24,
+  LIBRAW_RAWOPTIONS_DNG_LOSSY_HALFSIZE = 1 << 25,
+  LIBRAW_RAWOPTIONS_DNG_APPLY_OPCODES = 1 << 26
+};
+
+/* imgdata.params.render_cache: dcraw_process() intermediate results kept
+   for next call with changed parameters */
+enum LibRaw_rendercache_stages
+{
+  LIBRAW_RENDERCACHE_POSTBLACK = 1,
+  LIBRAW_RENDERCACHE_POSTDEMOSAIC = 1 << 1,
+  LIBRAW_RENDERCACHE_POSTHIGHLIGHTS = 1 << 2,
+  LIBRAW_RENDERCACHE_ALL = 7
+};
+#define LIBRAW_RENDERCACHE_STAGES 3
+
+enum LibRaw_resample_filters
+{
+  LIBRAW_RESAMPLE_LANCZOS3 = 0,
+  LIBRAW_RESAMPLE_MITCHELL = 1
 };
 
 enum LibRaw_decoder_flags
@@ -736,7 +780,9 @@ enum LibRaw_warnings
   LIBRAW_WARN_RAWSPEED3_NOTLISTED = 1 << 24,
   LIBRAW_WARN_VENDOR_CROP_SUGGESTED = 1 << 25,
   LIBRAW_WARN_DNG_NOT_PROCESSED = 1 << 26,
-  LIBRAW_WARN_DNG_NOT_PARSED = 1 << 27
+  LIBRAW_WARN_DNG_NOT_PARSED = 1 << 27,
+  LIBRAW_WARN_DNG_OPCODES_APPLIED = 1 << 28,
+  LIBRAW_WARN_DNG_OPCODES_SKIPPED = 1 << 29
 };
 
 enum LibRaw_exceptions
@@ -807,6 +853,7 @@ enum LibRaw_errors
   LIBRAW_INPUT_CLOSED = -7,
   LIBRAW_NOT_IMPLEMENTED = -8,
   LIBRAW_REQUEST_FOR_NONEXISTENT_THUMBNAIL = -9,
+  LIBRAW_SNAPSHOT_MISMATCH = -10,
   LIBRAW_UNSUFFICIENT_MEMORY = -100007,
   LIBRAW_DATA_ERROR = -100008,
   LIBRAW_IO_ERROR = -100009,
@@ -834,6 +881,15 @@ enum LibRaw_internal_thumbnail_formats
 	LIBRAW_INTERNAL_THUMBNAIL_JPEGXL
 };
 
+enum LibRaw_frameindex_kinds
+{
+  LIBRAW_FRAMEINDEX_NONE = 0,
+  LIBRAW_FRAMEINDEX_CR3 = 1,      /* CR3 roll burst: samples of selected track */
+  LIBRAW_FRAMEINDEX_CINE = 2,     /* Phantom CINE: image offsets table */
+  LIBRAW_FRAMEINDEX_TIFFIFD = 3,  /* Pentax pixel shift: same-sized raw IFDs */
+  LIBRAW_FRAMEINDEX_SINAR4SHOT = 4 /* Sinar 4-shot: shot_select 1..4 */
+};
+
 
 enum LibRaw_thumbnail_formats
 {
@@ -52,7 +52,7 @@ public:
   uchar jpeg_buffer[4096];
   struct
   {
-    float cbrt[0x10000], xyz_cam[3][4];
+    float xyz_cam[3][4];
   } ahd_data;
   void init()
   {
@@ -61,7 +61,6 @@ public:
     ph1_bits.bitbuf = 0;
     ph1_bits.vbits = 0;
     pana_data.vpos = 0;
-    ahd_data.cbrt[0] = -2.0f;
   }
 };
 
@@ -79,6 +78,15 @@ public:
   static const double dcip3d65_rgb[3][3];
   static const double rec2020_rgb[3][3];
 };
+
+/* Process-wide lookup tables: built once on first use, read-only and
+   shared by all LibRaw objects/threads */
+class LibRaw_tables
+{
+public:
+  static const float *cielab_cbrt(); /* 0x10000 entries, AHD/X-Trans */
+  static const float *aahd_gamma();  /* 0x10000 entries, AAHD */
+};
 #endif /* __cplusplus */
 
 typedef struct
@@ -93,14 +101,35 @@ typedef struct
   INT64 profile_offset;
   INT64 toffset;
   unsigned pana_black[4];
+  void *user_raw_buffer; /* caller-supplied raw_image storage, see unpack_frame() */
+  size_t user_raw_buffer_size;
+  long raw_rows_ready;  /* raw_image rows [0,raw_rows_ready) are final,
+                          accessed by set_raw_rows_ready()/raw_rows_ready() */
+  int raw_rows_publish;    /* set by unpack() while load_raw() is running */
+  ushort identified_width, identified_height; /* before open_datastream_tail() */
+  unsigned raw_decode_scale; /* 2: lossy DNG decoded at half size */
 
 } internal_data_t;
 
 #define LIBRAW_HISTOGRAM_SIZE 0x2000
+
+/* imgdata.params.fused_output: dcraw_process() leaves image in camera
+   colors, output functions convert it row by row */
+typedef struct
+{
+  int active;
+  int colors;    /* imgdata.image colors, before convert_to_rgb() */
+  int raw_color; /* no color matrix */
+  int histogram_ready;
+  float out_cam[3][4];
+  ushort (*lut)[4]; /* ICC transform grid (LIBRAW_FUSED_LUT_SIZE^3) or NULL */
+} fused_output_t;
+
 typedef struct
 {
   int (*histogram)[LIBRAW_HISTOGRAM_SIZE];
   unsigned *oprof;
+  fused_output_t fused;
 } output_data_t;
 
 typedef struct
@@ -148,6 +177,7 @@ typedef struct
   int32_t *sample_sizes;
   uint32_t chunk_count;
   INT64  *chunk_offsets;
+  INT64  *sample_offsets; /* per-sample offsets, built on first selectCRXFrame() */
 } crx_data_header_t;
 
 typedef struct 
@@ -209,8 +239,55 @@ typedef struct
 
   unsigned dng_frames[LIBRAW_IFD_MAXCOUNT*2]; /* bits: 0-7: shot_select, 8-15: IFD#, 16-31: low 16 bit of newsubfile type */
   unsigned short raw_stride;
+  INT64 dng_opcodes_offset[3]; /* OpcodeList1..3 of selected raw IFD */
+  unsigned dng_opcodes_len[3];
 } unpacker_data_t;
 
+typedef struct
+{
+  INT64 offset, size;
+  unsigned shot_select;
+  int ifd;
+} frame_index_entry_t;
+
+typedef struct
+{
+  unsigned kind;  /* LIBRAW_FRAMEINDEX_* */
+  unsigned count; /* 0 if file is not indexed (single frame) */
+  unsigned selected;
+  frame_index_entry_t *frames;
+  void *saved_state; /* post-identify state, restored by select_frame() */
+} frame_index_t;
+
+/* LRU cache of raw row blocks decoded by get_raw_rows() */
+typedef struct
+{
+  ushort *data[LIBRAW_RAWROWS_CACHE]; /* NULL: slot is empty */
+  unsigned block[LIBRAW_RAWROWS_CACHE];
+  unsigned used[LIBRAW_RAWROWS_CACHE];
+  unsigned clock;
+  unsigned block_rows;
+} raw_rows_cache_t;
+
+/* dcraw_process() stage results, see imgdata.params.render_cache */
+typedef struct
+{
+  void *stage[LIBRAW_RENDERCACHE_STAGES]; /* NULL: stage is not saved */
+} render_cache_t;
+
+/* Pixel shift (multi-shot) merge job: shot s sample at (row,col) goes to
+   dest[(row+shift_row[s])*dest_width + col+shift_col[s]][channel[s][row&1][col&1]] */
+typedef struct libraw_multishot_t
+{
+  ushort *planes[4];
+  int shots;
+  unsigned src_width, src_height;
+  int shift_row[4], shift_col[4];
+  unsigned char channel[4][2][2];
+  ushort (*dest)[4];
+  unsigned dest_width, dest_height;
+} libraw_multishot_t;
+
 typedef struct
 {
   internal_data_t internal_data;
@@ -218,6 +295,9 @@ typedef struct
   output_data_t output_data;
   identify_data_t identify_data;
   unpacker_data_t unpacker_data;
+  frame_index_t frame_index;
+  raw_rows_cache_t raw_rows_cache;
+  render_cache_t render_cache;
 } libraw_internal_data_t;
 
 struct decode
@@ -226,11 +306,32 @@ struct decode
   int leaf;
 };
 
+/* Same as libraw_dng_levels_t, but (rarely used) black level arrays
+   of LIBRAW_CBLACK_SIZE values are allocated on first use, see
+   tiff_ifd_alloc_black() */
+struct tiff_ifd_levels_t
+{
+  unsigned parsedfields;
+  unsigned *dng_cblack;
+  unsigned dng_black;
+  float *dng_fcblack;
+  float dng_fblack;
+  unsigned dng_whitelevel[4];
+  ushort default_crop[4]; /* Origin and size */
+  float user_crop[4];
+  unsigned preview_colorspace;
+  float analogbalance[4];
+  float asshotneutral[4];
+  float baseline_exposure;
+  float LinearResponseLimit;
+};
+
 struct tiff_ifd_t
 {
   int t_width, t_height, bps, comp, phint, t_flip, samples, extrasamples;
   INT64 offset, bytes;
   int t_tile_width, t_tile_length, sample_format, predictor;
+  int tile_bytes_type; /* TileByteCounts tag type (SHORT or LONG) */
   int rows_per_strip;
   INT64 *strip_offsets;
   int strip_offsets_count;
@@ -242,10 +343,12 @@ struct tiff_ifd_t
   float t_shutter;
   /* Per-IFD DNG fields */
   INT64 opcode2_offset;
+  INT64 opcode_offset[3]; /* OpcodeList1..3 */
+  unsigned opcode_len[3];
   INT64 lineartable_offset;
   int lineartable_len;
   libraw_dng_color_t dng_color[2];
-  libraw_dng_levels_t dng_levels;
+  tiff_ifd_levels_t dng_levels;
   int newsubfiletype;
 };
 
@@ -148,6 +148,8 @@ typedef unsigned long long UINT64;
   typedef int (*pre_identify_callback)(void *ctx);
   typedef void (*post_identify_callback)(void *ctx);
   typedef void (*process_step_callback)(void *ctx);
+  typedef void (*rows_callback)(void *data, unsigned rows_ready,
+                                unsigned raw_height);
 
   typedef struct
   {
@@ -165,6 +167,8 @@ typedef unsigned long long UINT64;
         pre_preinterpolate_cb, pre_interpolate_cb, interpolate_bayer_cb,
         interpolate_xtrans_cb, post_interpolate_cb, pre_converttorgb_cb,
         post_converttorgb_cb;
+    rows_callback rows_cb; /* progressive unpack, see set_rows_handler() */
+    void *rowscb_data;
   } libraw_callbacks_t;
 
   typedef struct
@@ -906,6 +910,43 @@ typedef unsigned long long UINT64;
     int afcount;
   } libraw_metadata_common_t;
 
+  /* Preparsed dark frame (-K) and bad pixels map (-P), may be shared by
+     several LibRaw objects; see LibRaw::load_dark_frame() and
+     LibRaw::load_bad_pixels() */
+  typedef struct
+  {
+    unsigned width, height;
+    ushort *data;  /* width*height values, native byte order */
+    unsigned owned; /* data is freed by LibRaw::free_dark_frame() */
+  } libraw_dark_frame_t;
+
+  typedef struct
+  {
+    int col, row, time;
+  } libraw_bad_pixel_t;
+
+  typedef struct
+  {
+    unsigned count;
+    libraw_bad_pixel_t *pixels;
+  } libraw_bad_pixels_t;
+
+  /* Raw data statistics, see LibRaw::get_raw_stats(). Channels are CFA
+     colors (0 for monochrome), values are in raw units before black
+     subtraction */
+  typedef struct
+  {
+    unsigned step;                 /* sampling step, in CFA periods */
+    INT64 count[4], sum[4];        /* visible area pixels */
+    INT64 clipped[4];              /* values >= color.maximum */
+    unsigned data_maximum;         /* visible area maximum */
+    unsigned channel_minimum[4], channel_maximum[4];
+    INT64 masked_count[4];         /* masked (optical black) pixels */
+    double masked_black[4];        /* masked pixels average */
+    double awb_sum[4], awb_count[4]; /* auto white balance (-a) sums */
+    unsigned histogram[4][LIBRAW_RAWSTATS_HISTOGRAM_SIZE];
+  } libraw_raw_stats_t;
+
   typedef struct
   {
     unsigned greybox[4];   /* -A  x1 y1 x2 y2 */
@@ -952,6 +993,18 @@ typedef unsigned long long UINT64;
     int no_auto_scale;
     /* Disable intepolation */
     int no_interpolation;
+    /* preparsed -K/-P data, used instead of dark_frame/bad_pixels files */
+    const libraw_dark_frame_t *dark_frame_data;
+    const libraw_bad_pixels_t *bad_pixels_data;
+    /* dcraw_process() stages to keep for re-rendering, LIBRAW_RENDERCACHE_* */
+    unsigned render_cache;
+    /* convert colors in output functions instead of dcraw_process() */
+    int fused_output;
+    /* memory output (copy_mem_image, dcraw_make_mem_image/jpeg) size,
+       0: full size, one of two 0: keep aspect ratio */
+    int output_width, output_height;
+    /* LIBRAW_RESAMPLE_* filter for output size */
+    int output_resample;
   } libraw_output_params_t;
 
   typedef struct  
@@ -91,6 +91,8 @@ int main(int ac, char *av[])
       fprintf(stderr, "Cannot unpack %s: %s\n", av[i], libraw_strerror(ret));
       continue;
     }
+    // keep demosaiced data between renderings: flip-only changes skip demosaic
+    RawProcessor.imgdata.params.render_cache = LIBRAW_RENDERCACHE_ALL;
     process_once(RawProcessor, 0, 0, 0, 1, -1, av[i]); // default flip
     process_once(RawProcessor, 1, 0, 1, 2, -1, av[i]);
     process_once(RawProcessor, 1, 1, 0, 3, -1, av[i]); // default flip
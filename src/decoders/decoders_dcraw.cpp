@@ -199,6 +199,224 @@ int LibRaw::canon_has_lowbits()
   return ret;
 }
 
+namespace
+{
+/* getbithuff() over in-memory data with 0xff 0x00 pairs already collapsed:
+   refill is byte by byte as in getbithuff(), so number of consumed bytes
+   matches the sequential decoder. */
+struct crw_bits_t
+{
+  const uchar *data;
+  unsigned pos, end;
+  unsigned bitbuf;
+  int vbits;
+  int carry;
+
+  unsigned get(int nbits, const ushort *huff)
+  {
+    if (nbits == 0 || vbits < 0)
+      return 0;
+    while (vbits < nbits && pos < end)
+    {
+      bitbuf = (bitbuf << 8) + data[pos++];
+      vbits += 8;
+    }
+    unsigned c = vbits == 0 ? 0 : bitbuf << (32 - vbits) >> (32 - nbits);
+    if (huff)
+    {
+      vbits -= huff[c] >> 8;
+      c = (uchar)huff[c];
+    }
+    else
+      vbits -= nbits;
+    return c;
+  }
+};
+
+/* One 8-row group: Huffman decode of nblocks 64-pixel blocks, then (if
+   pixel is set) pixel reconstruction and low bits merge. Returns number of
+   out of range pixels, errpos gets reader position at the first one. */
+template <bool decode>
+unsigned crw_decode_group(crw_bits_t &br, ushort *huff[2], int nblocks,
+                          ushort *pixel, int rwidth, const uchar *low,
+                          unsigned *errpos)
+{
+  int diffbuf[64], base[2] = {512, 512};
+  int rowleft = 0;
+  unsigned errors = 0;
+  for (int block = 0; block < nblocks; block++)
+  {
+    int dc = 0;
+    if (decode)
+      memset(diffbuf, 0, sizeof diffbuf);
+    for (int i = 0; i < 64; i++)
+    {
+      int leaf = br.get(*huff[i > 0], huff[i > 0] + 1);
+      if (leaf == 0 && i)
+        break;
+      if (leaf == 0xff)
+        continue;
+      i += leaf >> 4;
+      int len = leaf & 15;
+      if (len == 0)
+        continue;
+      int diff = br.get(len, 0);
+      /* scan needs DC term only, to track carry */
+      if (!decode && i)
+        continue;
+      if ((diff & (1 << (len - 1))) == 0)
+        diff -= (1 << len) - 1;
+      if (!decode)
+        dc = diff;
+      else if (i < 64)
+        diffbuf[i] = diff;
+    }
+    if (!decode)
+    {
+      br.carry += dc;
+      continue;
+    }
+    diffbuf[0] += br.carry;
+    br.carry = diffbuf[0];
+    ushort *bp = pixel + (block << 6);
+    for (int i = 0; i < 64; i++)
+    {
+      if (!rowleft--)
+      {
+        base[0] = base[1] = 512;
+        rowleft = rwidth - 1;
+      }
+      if ((bp[i] = base[i & 1] += diffbuf[i]) >> 10)
+        if (!errors++)
+          *errpos = br.pos;
+    }
+  }
+  if (decode && low)
+  {
+    ushort *prow = pixel;
+    for (int i = 0; i < rwidth * 2; i++)
+    {
+      int c = low[i];
+      for (int r = 0; r < 8; r += 2, prow++)
+      {
+        int val = (*prow << 2) + ((c >> r) & 3);
+        if (rwidth == 2672 && val < 512)
+          val += 2;
+        *prow = val;
+      }
+    }
+  }
+  return errors;
+}
+/* file offset (from stream start) after k bytes of collapsed stream */
+INT64 crw_stream_pos(const uchar *data, unsigned k)
+{
+  INT64 pos = k;
+  for (unsigned i = 0; i < k; i++)
+    pos += data[i] == 0xff;
+  return pos;
+}
+} // namespace
+
+/*
+   Canon CRW data is read into memory at once. If OpenMP is enabled, fast
+   Huffman-only scan records bit reader state and DC carry at each 8-row
+   group start, then groups are decoded in parallel; low bits are merged
+   in the same pass. Returns 0 (nothing is reported) if the bitstream ends
+   prematurely or rows are not aligned to groups, sequential decoder should
+   be used then.
+ */
+int LibRaw::canon_crw_decode_groups(ushort *huff[2], int lowbits)
+{
+  if (raw_width & 7)
+    return 0;
+  const INT64 start = ftell(ifp);
+  const INT64 fsize = libraw_internal_data.internal_data.input->size();
+  if (fsize <= start || fsize - start > INT64(UINT_MAX))
+    return 0;
+
+  /* compressed stream: 0xff 0x00 to 0xff, 0xff followed by anything else
+     (or by EOF) ends it */
+  std::vector<uchar> data(size_t(fsize - start));
+  size_t got = fread(data.data(), 1, data.size(), ifp);
+  size_t end = 0;
+  for (size_t i = 0; i < got; i++, end++)
+  {
+    uchar c = data[i];
+    if (c == 0xff)
+    {
+      if (i + 1 >= got || data[i + 1])
+        break;
+      i++;
+    }
+    data[end] = c;
+  }
+
+  const int groups = (raw_height + 7) / 8;
+  std::vector<uchar> low;
+  if (lowbits)
+  {
+    low.resize(size_t(groups) * raw_width * 2);
+    fseek(ifp, 26, SEEK_SET);
+    size_t lgot = fread(low.data(), 1, low.size(), ifp);
+    /* fgetc() at EOF: all low bits set */
+    if (lgot < low.size())
+      memset(&low[lgot], 0xff, low.size() - lgot);
+  }
+
+  /* with one thread scan pass is skipped, groups are decoded in order */
+  bool scan = false;
+#ifdef LIBRAW_USE_OPENMP
+  scan = omp_get_max_threads() > 1;
+#endif
+  crw_bits_t br = {data.data(), 0, unsigned(end), 0, 0, 0};
+  std::vector<crw_bits_t> state(groups);
+  std::vector<unsigned> errors(groups), errpos(groups);
+  for (int g = 0; g < groups; g++)
+  {
+    checkCancel();
+    const int nblocks = MIN(8, raw_height - g * 8) * raw_width >> 6;
+    state[g] = br;
+    if (scan)
+      crw_decode_group<false>(br, huff, nblocks, 0, raw_width, 0, 0);
+    else
+      errors[g] = crw_decode_group<true>(
+          br, huff, nblocks, raw_image + size_t(g) * 8 * raw_width, raw_width,
+          lowbits ? &low[size_t(g) * raw_width * 2] : 0, &errpos[g]);
+    /* premature end: sequential decoder reports it in place */
+    if (br.vbits < 0 || br.pos >= br.end)
+      return 0;
+  }
+  if (scan)
+  {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int g = 0; g < groups; g++)
+    {
+      crw_bits_t gbr = state[g];
+      const int nblocks = MIN(8, raw_height - g * 8) * raw_width >> 6;
+      errors[g] = crw_decode_group<true>(
+          gbr, huff, nblocks, raw_image + size_t(g) * 8 * raw_width,
+          raw_width, lowbits ? &low[size_t(g) * raw_width * 2] : 0,
+          &errpos[g]);
+    }
+  }
+
+  /* only the first error position is reported by derror() */
+  for (int g = 0; g < groups; g++)
+    if (errors[g])
+    {
+      fseek(ifp, start + crw_stream_pos(data.data(), errpos[g]), SEEK_SET);
+      for (int k = g; k < groups; k++)
+        for (unsigned i = 0; i < errors[k]; i++)
+          derror();
+      break;
+    }
+  fseek(ifp, start + crw_stream_pos(data.data(), br.pos), SEEK_SET);
+  return 1;
+}
+
 void LibRaw::canon_load_raw()
 {
   ushort *pixel, *prow, *huff[2];
@@ -215,7 +433,11 @@ void LibRaw::canon_load_raw()
   getbits(-1);
   try
   {
-    for (row = 0; row < raw_height; row += 8)
+    save = ftell(ifp);
+    int done = canon_crw_decode_groups(huff, lowbits);
+    if (!done)
+      fseek(ifp, save, SEEK_SET);
+    for (row = 0; !done && row < raw_height; row += 8)
     {
       checkCancel();
       pixel = raw_image + row * raw_width;
@@ -593,6 +815,9 @@ void LibRaw::lossless_jpeg_load_raw()
         if (++col >= raw_width)
           col = (row++, 0);
       }
+      /* sliced and interlaced layouts complete rows only at the end */
+      if (!cr2_slice[0] && !(load_flags & 1))
+        publish_raw_rows(raw_width == 3984 ? row - 1 : row);
     }
   }
   catch (...)
@@ -607,7 +832,7 @@ void LibRaw::canon_sraw_load_raw()
 {
   struct jhead jh;
   short *rp = 0, (*ip)[4];
-  int jwide, slice, scol, ecol, row, col, jrow = 0, jcol = 0, pix[3], c;
+  int jwide, slice, scol, ecol, row, col, jrow = 0, jcol = 0, c;
   int v[3] = {0, 0, 0}, ver, hue;
   int saved_w = width, saved_h = height;
   char *cp;
@@ -700,57 +925,88 @@ void LibRaw::canon_sraw_load_raw()
     if (unique_id >= 0x80000281ULL ||
         (unique_id == 0x80000218ULL && ver > 1000006))
       hue = jh.sraw << 1;
-    ip = (short(*)[4])image;
-    rp = ip[0];
-    for (row = 0; row < height; row++, ip += width)
+    /* Chroma interpolation: vertical pass of odd rows reads even columns of
+       even rows only, horizontal pass writes odd columns only, so rows are
+       independent. */
+    const int vshift = jh.sraw >> 1;
+    checkCancel();
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int r = 0; r < height; r++)
     {
-      checkCancel();
-      if (row & (jh.sraw >> 1))
+      short(*rip)[4] = (short(*)[4])image + size_t(r) * width;
+      if (r & vshift)
       {
-        for (col = 0; col < width; col += 2)
-          for (c = 1; c < 3; c++)
-            if (row == height - 1)
-            {
-              ip[col][c] = ip[col - width][c];
-            }
-            else
-            {
-              ip[col][c] = (ip[col - width][c] + ip[col + width][c] + 1) >> 1;
-            }
+        if (r == height - 1)
+          for (int k = 0; k < width; k += 2)
+          {
+            rip[k][1] = rip[k - width][1];
+            rip[k][2] = rip[k - width][2];
+          }
+        else
+          for (int k = 0; k < width; k += 2)
+          {
+            rip[k][1] = (rip[k - width][1] + rip[k + width][1] + 1) >> 1;
+            rip[k][2] = (rip[k - width][2] + rip[k + width][2] + 1) >> 1;
+          }
+      }
+      int k;
+      for (k = 1; k < width - 1; k += 2)
+      {
+        rip[k][1] = (rip[k - 1][1] + rip[k + 1][1] + 1) >> 1;
+        rip[k][2] = (rip[k - 1][2] + rip[k + 1][2] + 1) >> 1;
+      }
+      if (k == width - 1)
+      {
+        rip[k][1] = rip[k - 1][1];
+        rip[k][2] = rip[k - 1][2];
       }
-      for (col = 1; col < width; col += 2)
-        for (c = 1; c < 3; c++)
-          if (col == width - 1)
-            ip[col][c] = ip[col - 1][c];
-          else
-            ip[col][c] = (ip[col - 1][c] + ip[col + 1][c] + 1) >> 1;
     }
     if (!(imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SRAW_NO_RGB))
-      for (; rp < ip[0]; rp += 4)
+    {
+      /* camera-specific conversion is selected once, not per pixel */
+      const bool ycc14 = (unique_id == CanonID_EOS_5D_Mark_II) ||
+                         (unique_id == CanonID_EOS_7D) ||
+                         (unique_id == CanonID_EOS_50D) ||
+                         (unique_id == CanonID_EOS_1D_Mark_IV) ||
+                         (unique_id == CanonID_EOS_60D);
+      const short yoff = unique_id < CanonID_EOS_5D_Mark_II ? 512 : 0;
+      const int mul[3] = {sraw_mul[0], sraw_mul[1], sraw_mul[2]};
+      checkCancel();
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (int r = 0; r < height; r++)
       {
-        checkCancel();
-        if ((unique_id == CanonID_EOS_5D_Mark_II) ||
-            (unique_id == CanonID_EOS_7D)         ||
-            (unique_id == CanonID_EOS_50D)        ||
-            (unique_id == CanonID_EOS_1D_Mark_IV) ||
-            (unique_id == CanonID_EOS_60D))
-        {
-          rp[1] = (rp[1] << 2) + hue;
-          rp[2] = (rp[2] << 2) + hue;
-          pix[0] = rp[0] + ((50 * rp[1] + 22929 * rp[2]) >> 14);
-          pix[1] = rp[0] + ((-5640 * rp[1] - 11751 * rp[2]) >> 14);
-          pix[2] = rp[0] + ((29040 * rp[1] - 101 * rp[2]) >> 14);
-        }
+        short *p = (short *)image[0] + size_t(r) * width * 4;
+        short *const pend = p + size_t(width) * 4;
+        int px[3];
+        if (ycc14)
+          for (; p < pend; p += 4)
+          {
+            p[1] = (p[1] << 2) + hue;
+            p[2] = (p[2] << 2) + hue;
+            px[0] = p[0] + ((50 * p[1] + 22929 * p[2]) >> 14);
+            px[1] = p[0] + ((-5640 * p[1] - 11751 * p[2]) >> 14);
+            px[2] = p[0] + ((29040 * p[1] - 101 * p[2]) >> 14);
+            p[0] = CLIP15(px[0] * mul[0] >> 10);
+            p[1] = CLIP15(px[1] * mul[1] >> 10);
+            p[2] = CLIP15(px[2] * mul[2] >> 10);
+          }
         else
-        {
-          if (unique_id < CanonID_EOS_5D_Mark_II)
-            rp[0] -= 512;
-          pix[0] = rp[0] + rp[2];
-          pix[2] = rp[0] + rp[1];
-          pix[1] = rp[0] + ((-778 * rp[1] - (rp[2] << 11)) >> 12);
-        }
-        FORC3 rp[c] = CLIP15(pix[c] * sraw_mul[c] >> 10);
+          for (; p < pend; p += 4)
+          {
+            p[0] -= yoff;
+            px[0] = p[0] + p[2];
+            px[2] = p[0] + p[1];
+            px[1] = p[0] + ((-778 * p[1] - (p[2] << 11)) >> 12);
+            p[0] = CLIP15(px[0] * mul[0] >> 10);
+            p[1] = CLIP15(px[1] * mul[1] >> 10);
+            p[2] = CLIP15(px[2] * mul[2] >> 10);
+          }
       }
+    }
   }
   catch (...)
   {
@@ -953,28 +1209,49 @@ void LibRaw::nikon_yuv_load_raw()
 {
   if (!image)
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
-  int row, col, yuv[4]={0,0,0,0}, rgb[3], b, c;
-  UINT64 bitbuf = 0;
+  int row, c;
   float cmul[4];
   FORC4 { cmul[c] = cam_mul[c] > 0.001f ? cam_mul[c] : 1.f; }
-  for (row = 0; row < raw_height; row++)
+
+  /* 6 bytes per pixel pair, rows are read by blocks and converted in
+     parallel. Bytes past EOF are 0xff, as fgetc() returning -1 gave. */
+  const int rw = raw_width, iw = width;
+  const size_t rowbytes = size_t((rw + 1) / 2) * 6;
+  const int blockrows =
+      MAX(1, MIN(int(raw_height), int((16u << 20) / (rowbytes + 1))));
+  std::vector<uchar> buf(size_t(blockrows) * rowbytes);
+  for (row = 0; row < raw_height; row += blockrows)
   {
     checkCancel();
-
-    for (col = 0; col < raw_width; col++)
+    const int rows = MIN(blockrows, raw_height - row);
+    const size_t want = size_t(rows) * rowbytes;
+    const size_t got = fread(buf.data(), 1, want, ifp);
+    if (got < want)
+      memset(&buf[got], 0xff, want - got);
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) if (iw >= rw)
+#endif
+    for (int r = 0; r < rows; r++)
     {
-      if (!(b = col & 1))
+      const uchar *bp = &buf[size_t(r) * rowbytes];
+      ushort(*ip)[4] = image + size_t(row + r) * iw;
+      int yuv[4], rgb[3];
+      for (int col = 0; col < rw; col += 2, bp += 6)
       {
-        bitbuf = 0;
-        FORC(6) bitbuf |= (UINT64)fgetc(ifp) << c * 8;
-        FORC(4) yuv[c] = (bitbuf >> c * 12 & 0xfff) - (c >> 1 << 11);
+        UINT64 bitbuf = 0;
+        for (int k = 0; k < 6; k++)
+          bitbuf |= (UINT64)bp[k] << k * 8;
+        for (int k = 0; k < 4; k++)
+          yuv[k] = (bitbuf >> k * 12 & 0xfff) - (k >> 1 << 11);
+        for (int b = 0; b < 2 && col + b < rw; b++)
+        {
+          rgb[0] = int(yuv[b] + 1.370705f * yuv[3]);
+          rgb[1] = int(yuv[b] - 0.337633f * yuv[2] - 0.698001f * yuv[3]);
+          rgb[2] = int(yuv[b] + 1.732446f * yuv[2]);
+          for (int k = 0; k < 3; k++)
+            ip[col + b][k] = ushort(curve[LIM(rgb[k], 0, 0xfff)] / cmul[k]);
+        }
       }
-      rgb[0] = int(yuv[b] + 1.370705f * yuv[3]);
-      rgb[1] = int(yuv[b] - 0.337633f * yuv[2] - 0.698001f * yuv[3]);
-      rgb[2] = int(yuv[b] + 1.732446f * yuv[2]);
-      FORC3 image[row * width + col][c] = 
-		  ushort(
-			curve[LIM(rgb[c], 0, 0xfff)] / cmul[c]);
     }
   }
 }
@@ -1338,17 +1615,72 @@ void LibRaw::sony_load_raw()
   for (i = 26; i-- > 22;)
     key = key << 8 | head[i];
 
+  /* Rows are read by blocks and decrypted in parallel (keystream of each
+     row is started at its own position), bad pixels are reported in row
+     order after each block. */
+  unsigned pad[127];
+  sony_decrypt_init(pad, key);
+  const unsigned words = raw_width / 2;
+  const unsigned blockrows = MAX(1u, MIN(unsigned(raw_height),
+                                         (16u << 20) / (raw_width * 2u + 1u)));
+  std::vector<unsigned> errors(blockrows);
   fseek(ifp, data_offset, SEEK_SET);
-  for (row = 0; row < raw_height; row++)
+  for (row = 0; raw_width && row < raw_height;)
   {
     checkCancel();
-    pixel = raw_image + row * raw_width;
-    if (fread(pixel, 2, raw_width, ifp) < raw_width)
-      derror();
-    sony_decrypt((unsigned *)pixel, raw_width / 2, !row, key);
-    for (col = 0; col < raw_width; col++)
-      if ((pixel[col] = ntohs(pixel[col])) >> 14)
+    const unsigned rows = MIN(blockrows, unsigned(raw_height) - row);
+    const INT64 start = ftell(ifp);
+    pixel = raw_image + size_t(row) * raw_width;
+    const unsigned full =
+        unsigned(fread(pixel, 2, size_t(rows) * raw_width, ifp)) / raw_width;
+    const int chunks = int((full + 255) / 256);
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int k = 0; k < chunks; k++)
+    {
+      const unsigned r0 = unsigned(k) * 256, r1 = MIN(full, r0 + 256);
+      ushort *px = raw_image + size_t(row + r0) * raw_width;
+      /* even width: keystream of chunk rows is contiguous */
+      if (!(raw_width & 1))
+        sony_decrypt_at(pad, INT64(row + r0) * words, (unsigned *)px,
+                        int((r1 - r0) * words));
+      for (unsigned r = r0; r < r1; r++, px += raw_width)
+      {
+        if (raw_width & 1)
+          sony_decrypt_at(pad, INT64(row + r) * words, (unsigned *)px,
+                          int(words));
+        unsigned err = 0;
+        for (unsigned c = 0; c < raw_width; c++)
+          if ((px[c] = ntohs(px[c])) >> 14)
+            err++;
+        errors[r] = err;
+      }
+    }
+    for (unsigned r = 0; r < full; r++)
+      if (errors[r])
+      {
+        fseek(ifp, start + INT64(r + 1) * raw_width * 2, SEEK_SET);
+        for (i = 0; i < errors[r]; i++)
+          derror();
+      }
+    row += full;
+    fseek(ifp, start + INT64(full) * raw_width * 2, SEEK_SET);
+    if (full == rows)
+      continue;
+
+    /* truncated data: row by row, as sequential decoder did */
+    for (; row < raw_height; row++)
+    {
+      checkCancel();
+      pixel = raw_image + size_t(row) * raw_width;
+      if (fread(pixel, 2, raw_width, ifp) < raw_width)
         derror();
+      sony_decrypt_at(pad, INT64(row) * words, (unsigned *)pixel, int(words));
+      for (col = 0; col < raw_width; col++)
+        if ((pixel[col] = ntohs(pixel[col])) >> 14)
+          derror();
+    }
   }
   maximum = 0x3ff0;
 }
@@ -1484,6 +1816,7 @@ void LibRaw::sony_arw2_load_raw()
             RAW(row, col) = curve[pix[i] << 1];
         col -= col & 1 ? 1 : 31;
       }
+      publish_raw_rows(row + 1);
     }
   }
   catch (...)
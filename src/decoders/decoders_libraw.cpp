@@ -21,7 +21,6 @@
 
 void LibRaw::sony_arq_load_raw()
 {
-  int row, col;
   if (imgdata.idata.filters || imgdata.idata.colors < 3)
 	  throw LIBRAW_EXCEPTION_IO_CORRUPT;
 
@@ -33,32 +32,86 @@ void LibRaw::sony_arq_load_raw()
   if(imgdata.rawparams.options & LIBRAW_RAWOPTIONS_ARQ_SKIP_CHANNEL_SWAP)
     return;
 
-  for (row = 0; row < imgdata.sizes.raw_height; row++)
+  const int raw_height = imgdata.sizes.raw_height,
+            raw_width = imgdata.sizes.raw_width;
+  const unsigned top = imgdata.sizes.top_margin,
+                 left = imgdata.sizes.left_margin,
+                 height = imgdata.sizes.height, width = imgdata.sizes.width,
+                 maximum = imgdata.color.maximum;
+  ushort(*raw)[4] = (ushort(*)[4])imgdata.rawdata.raw_image;
+  int errs = 0;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for reduction(+ : errs)
+#endif
+  for (int row = 0; row < raw_height; row++)
   {
-    unsigned short(*rowp)[4] =
-        (unsigned short(*)[4]) &
-        imgdata.rawdata.raw_image[row * imgdata.sizes.raw_width * 4];
-    for (col = 0; col < imgdata.sizes.raw_width; col++)
+    ushort(*rowp)[4] = &raw[size_t(row) * raw_width];
+    for (int col = 0; col < raw_width; col++)
     {
-      unsigned short g2 = rowp[col][2];
+      ushort g2 = rowp[col][2];
       rowp[col][2] = rowp[col][3];
       rowp[col][3] = g2;
-      if (((unsigned)(row - imgdata.sizes.top_margin) < imgdata.sizes.height) &&
-          ((unsigned)(col - imgdata.sizes.left_margin) < imgdata.sizes.width) &&
-          (MAX(MAX(rowp[col][0], rowp[col][1]),
-               MAX(rowp[col][2], rowp[col][3])) > imgdata.color.maximum))
-        derror();
+    }
+    if ((unsigned)(row - top) >= height)
+      continue;
+    ushort vmax = 0;
+    for (unsigned col = left; col < MIN(left + width, unsigned(raw_width)); col++)
+      vmax = MAX(vmax, MAX(MAX(rowp[col][0], rowp[col][1]),
+                           MAX(rowp[col][2], rowp[col][3])));
+    if (vmax > maximum)
+      for (unsigned col = left; col < MIN(left + width, unsigned(raw_width)); col++)
+        if (MAX(MAX(rowp[col][0], rowp[col][1]),
+                MAX(rowp[col][2], rowp[col][3])) > maximum)
+          errs++;
+  }
+  if (errs)
+  {
+    derror(); // data callback called once, as before
+    libraw_internal_data.unpacker_data.data_error += errs - 1;
+  }
+}
+
+void LibRaw::multishot_merge(libraw_multishot_t *ms)
+{
+  const int dheight = ms->dest_height;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int drow = 0; drow < dheight; drow++)
+  {
+    ushort(*dst)[4] = &ms->dest[size_t(drow) * ms->dest_width];
+    // shots are applied in order, later shot wins on overlap
+    for (int s = 0; s < ms->shots; s++)
+    {
+      int srow = drow - ms->shift_row[s];
+      if (srow < 0 || srow >= int(ms->src_height))
+        continue;
+      const ushort *src = ms->planes[s] + size_t(srow) * ms->src_width;
+      const int shift = ms->shift_col[s];
+      const int cstart = MAX(0, -shift);
+      const int cend = MIN(int(ms->src_width), int(ms->dest_width) - shift);
+      for (int parity = 0; parity < 2; parity++)
+      {
+        const int c = ms->channel[s][srow & 1][parity];
+        for (int col = cstart + ((cstart ^ parity) & 1); col < cend; col += 2)
+          dst[col + shift][c] = src[col];
+      }
     }
   }
 }
 
 void LibRaw::pentax_4shot_load_raw()
 {
+  const size_t plane_sz =
+      size_t(imgdata.sizes.raw_width) * size_t(imgdata.sizes.raw_height);
+  /* all 4 sub-frames are kept until merge */
+  if (INT64(plane_sz) * 4 * INT64(sizeof(ushort)) >
+      INT64(imgdata.rawparams.max_raw_memory_mb) * INT64(1024 * 1024))
+    throw LIBRAW_EXCEPTION_TOOBIG;
 #ifdef LIBRAW_CALLOC_RAWSTORE
-  ushort *plane = (ushort *)calloc(size_t(imgdata.sizes.raw_width) * size_t(imgdata.sizes.raw_height), sizeof(ushort));
+  ushort *planes = (ushort *)calloc(plane_sz * 4, sizeof(ushort));
 #else
-  ushort *plane = (ushort *)malloc(size_t(imgdata.sizes.raw_width) *
-                                   size_t(imgdata.sizes.raw_height) * sizeof(ushort));
+  ushort *planes = (ushort *)malloc(plane_sz * 4 * sizeof(ushort));
 #endif
   size_t alloc_sz = size_t(imgdata.sizes.raw_width) * (size_t(imgdata.sizes.raw_height) + 16) * 4 *
                  sizeof(ushort);
@@ -77,6 +130,14 @@ void LibRaw::pentax_4shot_load_raw()
       {1, 0},
   };
 
+  libraw_multishot_t ms;
+  memset(&ms, 0, sizeof(ms));
+  ms.src_width = ms.dest_width = imgdata.sizes.raw_width;
+  ms.src_height = ms.dest_height = imgdata.sizes.raw_height;
+  ms.dest = result;
+
+  // Sub-frames share the component decoder state, so they are decoded one
+  // after another; the shift-and-merge is done in one pass afterwards
   int tidx = 0;
   for (int i = 0; i < 4; i++)
   {
@@ -99,24 +160,22 @@ void LibRaw::pentax_4shot_load_raw()
         break;
     if (tidx >= 16)
       break;
-    imgdata.rawdata.raw_image = plane;
+    checkCancel();
+    imgdata.rawdata.raw_image = planes + plane_sz * i;
     ID.input->seek(tiff_ifd[tidx].offset, SEEK_SET);
     imgdata.idata.filters = 0xb4b4b4b4;
     libraw_internal_data.unpacker_data.data_offset = tiff_ifd[tidx].offset;
     (this->*pentax_component_load_raw)();
-    for (int row = 0; row < imgdata.sizes.raw_height - move_row; row++)
-    {
-      int colors[2];
+    ms.planes[i] = imgdata.rawdata.raw_image;
+    ms.shift_row[i] = move_row;
+    ms.shift_col[i] = move_col;
+    for (int r = 0; r < 2; r++)
       for (int c = 0; c < 2; c++)
-        colors[c] = COLOR(row, c);
-      ushort *srcrow = &plane[imgdata.sizes.raw_width * row];
-      ushort(*dstrow)[4] =
-          &result[(imgdata.sizes.raw_width) * (row + move_row) + move_col];
-      for (int col = 0; col < imgdata.sizes.raw_width - move_col; col++)
-        dstrow[col][colors[col % 2]] = srcrow[col];
-    }
+        ms.channel[i][r][c] = COLOR(r, c);
+    ms.shots = i + 1;
     tidx++;
   }
+  multishot_merge(&ms);
 
   if (imgdata.color.cblack[4] == 2 && imgdata.color.cblack[5] == 2)
     for (int c = 0; c < 4; c++)
@@ -131,7 +190,7 @@ void LibRaw::pentax_4shot_load_raw()
   imgdata.sizes.raw_pitch = imgdata.sizes.raw_width * 8;
   imgdata.idata.filters = 0;
   imgdata.rawdata.raw_alloc = imgdata.rawdata.color4_image = result;
-  free(plane);
+  free(planes);
   imgdata.rawdata.raw_image = 0;
 }
 
@@ -364,25 +423,21 @@ void LibRaw::nikon_load_striped_packed_raw()
   }
 }
 
-struct pana_cs6_page_decoder
-{
-  unsigned int pixelbuffer[18], lastoffset, maxoffset;
-  unsigned char current, *buffer;
-  pana_cs6_page_decoder(unsigned char *_buffer, unsigned int bsize)
-      : lastoffset(0), maxoffset(bsize), current(0), buffer(_buffer)
-  {
-  }
-  void read_page(); // will throw IO error if not enough space in buffer
-  void read_page12(); // 12-bit variant
-  unsigned int nextpixel() { return current < 14 ? pixelbuffer[current++] : 0; }
-  unsigned int nextpixel12() { return current < 18 ? pixelbuffer[current++] : 0; }
-};
+/*
+   Panasonic CS6/CS7: every row is a sequence of independent 16-byte blocks,
+   rows are read by groups of 16 (last incomplete group is not decoded).
+   Rows are decoded in parallel from blocks of rows read at once.
+ */
+#define LIBRAW_PANA_CS_READ_BLOCK (16 << 20)
 
-void pana_cs6_page_decoder::read_page()
+namespace
+{
+/* 14 fields for 14-bit data: 11 pixels and 3 base codes; wbuffer(i) is
+   byte 15-i of the block */
+inline void pana_cs6_unpack_block(const unsigned char *buffer,
+                                  unsigned *pixelbuffer)
 {
-  if (!buffer || (maxoffset - lastoffset < 16))
-    throw LIBRAW_EXCEPTION_IO_EOF;
-#define wbuffer(i) ((unsigned short)buffer[lastoffset + 15 - i])
+#define wbuffer(i) ((unsigned short)buffer[15 - i])
   pixelbuffer[0] = (wbuffer(0) << 6) | (wbuffer(1) >> 2);                                         // 14 bit
   pixelbuffer[1] = (((wbuffer(1) & 0x3) << 12) | (wbuffer(2) << 4) | (wbuffer(3) >> 4)) & 0x3fff; // 14 bit
   pixelbuffer[2] = (wbuffer(3) >> 2) & 0x3;                                                       // 2
@@ -398,19 +453,17 @@ void pana_cs6_page_decoder::read_page()
   pixelbuffer[12] = (((wbuffer(13) << 2) & 0x3fc) | wbuffer(14) >> 6) & 0x3ff;
   pixelbuffer[13] = ((wbuffer(14) << 4) | (wbuffer(15) >> 4)) & 0x3ff;
 #undef wbuffer
-  current = 0;
-  lastoffset += 16;
 }
 
-void pana_cs6_page_decoder::read_page12()
+/* 18 fields for 12-bit data: 14 pixels and 4 base codes */
+inline void pana_cs6_unpack_block12(const unsigned char *buffer,
+                                    unsigned *pixelbuffer)
 {
-  if (!buffer || (maxoffset - lastoffset < 16))
-    throw LIBRAW_EXCEPTION_IO_EOF;
-#define wb(i) ((unsigned short)buffer[lastoffset + 15 - i])
+#define wb(i) ((unsigned short)buffer[15 - i])
   pixelbuffer[0] = (wb(0) << 4) | (wb(1) >> 4);              // 12 bit: 8/0 + 4 upper bits of /1
   pixelbuffer[1] = (((wb(1) & 0xf) << 8) | (wb(2))) & 0xfff; // 12 bit: 4l/1 + 8/2
-  
-  pixelbuffer[2] = (wb(3) >> 6) & 0x3;                       // 2; 2u/3, 6 low bits remains in wb(3) 
+
+  pixelbuffer[2] = (wb(3) >> 6) & 0x3;                       // 2; 2u/3, 6 low bits remains in wb(3)
   pixelbuffer[3] = ((wb(3) & 0x3f) << 2) | (wb(4) >> 6);     // 8; 6l/3 + 2u/4; 6 low bits remains in wb(4)
   pixelbuffer[4] = ((wb(4) & 0x3f) << 2) | (wb(5) >> 6);     // 8: 6l/4 + 2u/5; 6 low bits remains in wb(5)
   pixelbuffer[5] = ((wb(5) & 0x3f) << 2) | (wb(6) >> 6);     // 8: 6l/5 + 2u/6, 6 low bits remains in wb(6)
@@ -430,152 +483,174 @@ void pana_cs6_page_decoder::read_page12()
   pixelbuffer[16] = wb(14);
   pixelbuffer[17] = wb(15);
 #undef wb
-  current = 0;
-  lastoffset += 16;
 }
 
-void LibRaw::panasonicC6_load_raw()
+template <bool _12bit>
+void pana_cs6_decode_row(const unsigned char *bytes, unsigned short *rowptr,
+                         int blocksperrow)
 {
-  const int rowstep = 16;
-  const bool _12bit = libraw_internal_data.unpacker_data.pana_bpp == 12;
-  const int pixperblock =  _12bit ? 14 : 11;
-  const int blocksperrow = imgdata.sizes.raw_width / pixperblock;
-  const int rowbytes = blocksperrow * 16;
+  const int pixperblock = _12bit ? 14 : 11;
   const unsigned pixelbase0 = _12bit ? 0x80 : 0x200;
   const unsigned pixelbase_compare = _12bit ? 0x800 : 0x2000;
   const unsigned spix_compare = _12bit ? 0x3fff : 0xffff;
   const unsigned pixel_mask = _12bit ? 0xfff : 0x3fff;
+  unsigned pixelbuffer[18];
+  int col = 0;
+
+  for (int rblock = 0; rblock < blocksperrow; rblock++, bytes += 16)
+  {
+    if (_12bit)
+      pana_cs6_unpack_block12(bytes, pixelbuffer);
+    else
+      pana_cs6_unpack_block(bytes, pixelbuffer);
+    const unsigned *next = pixelbuffer;
+    unsigned oddeven[2] = {0, 0}, nonzero[2] = {0, 0};
+    unsigned pmul = 0, pixel_base = 0;
+    for (int pix = 0; pix < pixperblock; pix++)
+    {
+      if (pix % 3 == 2)
+      {
+        unsigned base = *next++; /* 2-bit field */
+        if (base == 3)
+          base = 4;
+        pixel_base = pixelbase0 << base;
+        pmul = 1 << base;
+      }
+      unsigned epixel = *next++;
+      if (oddeven[pix % 2])
+      {
+        epixel *= pmul;
+        if (pixel_base < pixelbase_compare && nonzero[pix % 2] > pixel_base)
+          epixel += nonzero[pix % 2] - pixel_base;
+        nonzero[pix % 2] = epixel;
+      }
+      else
+      {
+        oddeven[pix % 2] = epixel;
+        if (epixel)
+          nonzero[pix % 2] = epixel;
+        else
+          epixel = nonzero[pix % 2];
+      }
+      unsigned spix = epixel - 0xf;
+      if (spix <= spix_compare)
+        rowptr[col++] = spix & spix_compare;
+      else
+      {
+        epixel = (((signed int)(epixel + 0x7ffffff1)) >> 0x1f);
+        rowptr[col++] = epixel & pixel_mask;
+      }
+    }
+  }
+}
+
+void pana_cs7_decode_row(const unsigned char *bytes, unsigned short *rowptr,
+                         int width, int bpp)
+{
+  if (bpp == 14)
+    for (int col = 0; col < width - 9 + 1; col += 9, bytes += 16)
+    {
+      rowptr[col] = bytes[0] + ((bytes[1] & 0x3F) << 8);
+      rowptr[col + 1] =
+          (bytes[1] >> 6) + 4 * (bytes[2]) + ((bytes[3] & 0xF) << 10);
+      rowptr[col + 2] =
+          (bytes[3] >> 4) + 16 * (bytes[4]) + ((bytes[5] & 3) << 12);
+      rowptr[col + 3] = ((bytes[5] & 0xFC) >> 2) + (bytes[6] << 6);
+      rowptr[col + 4] = bytes[7] + ((bytes[8] & 0x3F) << 8);
+      rowptr[col + 5] =
+          (bytes[8] >> 6) + 4 * bytes[9] + ((bytes[10] & 0xF) << 10);
+      rowptr[col + 6] =
+          (bytes[10] >> 4) + 16 * bytes[11] + ((bytes[12] & 3) << 12);
+      rowptr[col + 7] = ((bytes[12] & 0xFC) >> 2) + (bytes[13] << 6);
+      rowptr[col + 8] = bytes[14] + ((bytes[15] & 0x3F) << 8);
+    }
+  else if (bpp == 12) // have not seen in the wild yet
+    for (int col = 0; col < width - 10 + 1; col += 10, bytes += 16)
+    {
+      rowptr[col] = ((bytes[1] & 0xF) << 8) + bytes[0];
+      rowptr[col + 1] = 16 * bytes[2] + (bytes[1] >> 4);
+      rowptr[col + 2] = ((bytes[4] & 0xF) << 8) + bytes[3];
+      rowptr[col + 3] = 16 * bytes[5] + (bytes[4] >> 4);
+      rowptr[col + 4] = ((bytes[7] & 0xF) << 8) + bytes[6];
+      rowptr[col + 5] = 16 * bytes[8] + (bytes[7] >> 4);
+      rowptr[col + 6] = ((bytes[10] & 0xF) << 8) + bytes[9];
+      rowptr[col + 7] = 16 * bytes[11] + (bytes[10] >> 4);
+      rowptr[col + 8] = ((bytes[13] & 0xF) << 8) + bytes[12];
+      rowptr[col + 9] = 16 * bytes[14] + (bytes[13] >> 4);
+    }
+}
+} // namespace
+
+/*
+   Reads rows [0, raw_height/16*16) by blocks and decodes them with
+   panasonicC6/C7 row decoder; IO_EOF if data ends before last 16-row group
+   (previous groups are decoded).
+ */
+void LibRaw::panasonicCS_read_rows(int rowbytes, int kind)
+{
+  const int rowstep = 16;
+  const int bpp = libraw_internal_data.unpacker_data.pana_bpp;
+  const int fullrows = imgdata.sizes.raw_height / rowstep * rowstep;
+  if (fullrows < 1)
+    return;
+  if (rowbytes < 1)
+    throw LIBRAW_EXCEPTION_IO_CORRUPT;
+  const int blockrows =
+      MIN(fullrows, MAX(rowstep, LIBRAW_PANA_CS_READ_BLOCK / rowbytes / rowstep *
+                                     rowstep));
   std::vector<unsigned char> iobuf;
   try
   {
-      iobuf.resize(rowbytes * rowstep);
+    iobuf.resize(size_t(rowbytes) * blockrows);
   }
   catch (...)
   {
     throw LIBRAW_EXCEPTION_ALLOC;
   }
 
-  for (int row = 0; row < imgdata.sizes.raw_height - rowstep + 1;
-       row += rowstep)
+  for (int row = 0; row < fullrows; row += blockrows)
   {
-    int rowstoread = MIN(rowstep, imgdata.sizes.raw_height - row);
-    if (libraw_internal_data.internal_data.input->read(
-            iobuf.data(), rowbytes, rowstoread) != rowstoread)
-      throw LIBRAW_EXCEPTION_IO_EOF;
-    pana_cs6_page_decoder page(iobuf.data(), rowbytes * rowstoread);
-    for (int crow = 0, col = 0; crow < rowstoread; crow++, col = 0)
+    checkCancel();
+    const int rows = MIN(blockrows, fullrows - row);
+    const int got = libraw_internal_data.internal_data.input->read(
+        iobuf.data(), rowbytes, rows);
+    const int ready = MAX(got, 0) / rowstep * rowstep;
+    const unsigned char *src = iobuf.data();
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int crow = 0; crow < ready; crow++)
     {
       unsigned short *rowptr =
           &imgdata.rawdata
-               .raw_image[(row + crow) * imgdata.sizes.raw_pitch / 2];
-      for (int rblock = 0; rblock < blocksperrow; rblock++)
-      {
-          if (_12bit)
-              page.read_page12();
-          else
-              page.read_page();
-        unsigned oddeven[2] = {0, 0}, nonzero[2] = {0, 0};
-        unsigned pmul = 0, pixel_base = 0;
-        for (int pix = 0; pix < pixperblock; pix++)
-        {
-          if (pix % 3 == 2)
-          {
-            unsigned base = _12bit ? page.nextpixel12(): page.nextpixel();
-            if (base > 3)
-              throw LIBRAW_EXCEPTION_IO_CORRUPT; // not possible b/c of 2-bit
-                                                 // field, but....
-            if (base == 3)
-              base = 4;
-            pixel_base = pixelbase0 << base;
-            pmul = 1 << base;
-          }
-          unsigned epixel = _12bit ? page.nextpixel12() : page.nextpixel();
-          if (oddeven[pix % 2])
-          {
-            epixel *= pmul;
-            if (pixel_base < pixelbase_compare && nonzero[pix % 2] > pixel_base)
-              epixel += nonzero[pix % 2] - pixel_base;
-            nonzero[pix % 2] = epixel;
-          }
-          else
-          {
-            oddeven[pix % 2] = epixel;
-            if (epixel)
-              nonzero[pix % 2] = epixel;
-            else
-              epixel = nonzero[pix % 2];
-          }
-          unsigned spix = epixel - 0xf;
-          if (spix <= spix_compare)
-            rowptr[col++] = spix & spix_compare;
-          else
-          {
-            epixel = (((signed int)(epixel + 0x7ffffff1)) >> 0x1f);
-            rowptr[col++] = epixel & pixel_mask;
-          }
-        }
-      }
+               .raw_image[size_t(row + crow) * (imgdata.sizes.raw_pitch / 2)];
+      if (kind == 7)
+        pana_cs7_decode_row(src + size_t(crow) * rowbytes, rowptr,
+                            imgdata.sizes.raw_width, bpp);
+      else if (bpp == 12)
+        pana_cs6_decode_row<true>(src + size_t(crow) * rowbytes, rowptr,
+                                  rowbytes / 16);
+      else
+        pana_cs6_decode_row<false>(src + size_t(crow) * rowbytes, rowptr,
+                                   rowbytes / 16);
     }
+    if (got != rows)
+      throw LIBRAW_EXCEPTION_IO_EOF;
   }
 }
 
+void LibRaw::panasonicC6_load_raw()
+{
+  const int pixperblock =
+      libraw_internal_data.unpacker_data.pana_bpp == 12 ? 14 : 11;
+  panasonicCS_read_rows(imgdata.sizes.raw_width / pixperblock * 16, 6);
+}
 
 void LibRaw::panasonicC7_load_raw()
 {
-  const int rowstep = 16;
-  int pixperblock = libraw_internal_data.unpacker_data.pana_bpp == 14 ? 9 : 10;
-  int rowbytes = imgdata.sizes.raw_width / pixperblock * 16;
-  unsigned char *iobuf = (unsigned char *)calloc(rowbytes * rowstep,1);
-  for (int row = 0; row < imgdata.sizes.raw_height - rowstep + 1;
-       row += rowstep)
-  {
-    int rowstoread = MIN(rowstep, imgdata.sizes.raw_height - row);
-    if (libraw_internal_data.internal_data.input->read(
-            iobuf, rowbytes, rowstoread) != rowstoread)
-      throw LIBRAW_EXCEPTION_IO_EOF;
-    unsigned char *bytes = iobuf;
-    for (int crow = 0; crow < rowstoread; crow++)
-    {
-      unsigned short *rowptr =
-          &imgdata.rawdata
-               .raw_image[(row + crow) * imgdata.sizes.raw_pitch / 2];
-      for (int col = 0; col < imgdata.sizes.raw_width - pixperblock + 1;
-           col += pixperblock, bytes += 16)
-      {
-        if (libraw_internal_data.unpacker_data.pana_bpp == 14)
-        {
-          rowptr[col] = bytes[0] + ((bytes[1] & 0x3F) << 8);
-          rowptr[col + 1] =
-              (bytes[1] >> 6) + 4 * (bytes[2]) + ((bytes[3] & 0xF) << 10);
-          rowptr[col + 2] =
-              (bytes[3] >> 4) + 16 * (bytes[4]) + ((bytes[5] & 3) << 12);
-          rowptr[col + 3] = ((bytes[5] & 0xFC) >> 2) + (bytes[6] << 6);
-          rowptr[col + 4] = bytes[7] + ((bytes[8] & 0x3F) << 8);
-          rowptr[col + 5] =
-              (bytes[8] >> 6) + 4 * bytes[9] + ((bytes[10] & 0xF) << 10);
-          rowptr[col + 6] =
-              (bytes[10] >> 4) + 16 * bytes[11] + ((bytes[12] & 3) << 12);
-          rowptr[col + 7] = ((bytes[12] & 0xFC) >> 2) + (bytes[13] << 6);
-          rowptr[col + 8] = bytes[14] + ((bytes[15] & 0x3F) << 8);
-        }
-        else if (libraw_internal_data.unpacker_data.pana_bpp ==
-                 12) // have not seen in the wild yet
-        {
-          rowptr[col] = ((bytes[1] & 0xF) << 8) + bytes[0];
-          rowptr[col + 1] = 16 * bytes[2] + (bytes[1] >> 4);
-          rowptr[col + 2] = ((bytes[4] & 0xF) << 8) + bytes[3];
-          rowptr[col + 3] = 16 * bytes[5] + (bytes[4] >> 4);
-          rowptr[col + 4] = ((bytes[7] & 0xF) << 8) + bytes[6];
-          rowptr[col + 5] = 16 * bytes[8] + (bytes[7] >> 4);
-          rowptr[col + 6] = ((bytes[10] & 0xF) << 8) + bytes[9];
-          rowptr[col + 7] = 16 * bytes[11] + (bytes[10] >> 4);
-          rowptr[col + 8] = ((bytes[13] & 0xF) << 8) + bytes[12];
-          rowptr[col + 9] = 16 * bytes[14] + (bytes[13] >> 4);
-        }
-      }
-    }
-  }
-  free(iobuf);
+  const int pixperblock =
+      libraw_internal_data.unpacker_data.pana_bpp == 14 ? 9 : 10;
+  panasonicCS_read_rows(imgdata.sizes.raw_width / pixperblock * 16, 7);
 }
 
 void LibRaw::unpacked_load_raw_fuji_f700s20()
@@ -639,44 +714,40 @@ void LibRaw::nikon_load_sraw()
   {
     return; // no CbCr interpolation
   }
-  // Interpolate CC channels
-  int row, col;
-  for (row = 0; row < imgdata.sizes.raw_height; row++)
+  // Interpolate CC channels: odd columns are written from even ones only,
+  // so rows are independent (odd width row tail spills into the next row,
+  // keep sequential order there)
+  const int rw = imgdata.sizes.raw_width, rh = imgdata.sizes.raw_height;
+  checkCancel(); // will throw out
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) if (!(rw & 1))
+#endif
+  for (int row = 0; row < rh; row++)
   {
-    checkCancel(); // will throw out
-    for (col = 0; col < imgdata.sizes.raw_width; col += 2)
+    ushort(*ip)[4] = imgdata.image + size_t(row) * rw;
+    for (int col = 0; col < rw; col += 2)
     {
-      int col2 = col < imgdata.sizes.raw_width - 2 ? col + 2 : col;
-      imgdata.image[row * imgdata.sizes.raw_width + col + 1][1] =
-          (unsigned short)(int(imgdata.image[row * imgdata.sizes.raw_width +
-                                             col][1] +
-                               imgdata.image[row * imgdata.sizes.raw_width +
-                                             col2][1]) /
-                           2);
-      imgdata.image[row * imgdata.sizes.raw_width + col + 1][2] =
-          (unsigned short)(int(imgdata.image[row * imgdata.sizes.raw_width +
-                                             col][2] +
-                               imgdata.image[row * imgdata.sizes.raw_width +
-                                             col2][2]) /
-                           2);
+      int col2 = col < rw - 2 ? col + 2 : col;
+      ip[col + 1][1] = (unsigned short)(int(ip[col][1] + ip[col2][1]) / 2);
+      ip[col + 1][2] = (unsigned short)(int(ip[col][2] + ip[col2][2]) / 2);
     }
   }
   if (imgdata.rawparams.specials & LIBRAW_RAWSPECIAL_SRAW_NO_RGB)
     return;
 
-  for (row = 0; row < imgdata.sizes.raw_height; row++)
+  const ushort *cv = imgdata.color.curve;
+  checkCancel(); // will throw out
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int row = 0; row < rh; row++)
   {
-    checkCancel(); // will throw out
-    for (col = 0; col < imgdata.sizes.raw_width; col++)
+    ushort(*ip)[4] = imgdata.image + size_t(row) * rw;
+    for (int col = 0; col < rw; col++)
     {
-      float Y =
-          float(imgdata.image[row * imgdata.sizes.raw_width + col][0]) / 2549.f;
-      float Ch2 =
-          float(imgdata.image[row * imgdata.sizes.raw_width + col][1] - 1280) /
-          1536.f;
-      float Ch3 =
-          float(imgdata.image[row * imgdata.sizes.raw_width + col][2] - 1280) /
-          1536.f;
+      float Y = float(ip[col][0]) / 2549.f;
+      float Ch2 = float(ip[col][1] - 1280) / 1536.f;
+      float Ch3 = float(ip[col][2] - 1280) / 1536.f;
       if (Y > 1.f)
         Y = 1.f;
       if (Y > 0.803f)
@@ -696,12 +767,9 @@ void LibRaw::nikon_load_sraw()
         b = 1.f;
       if (b < 0.f)
         b = 0.f;
-      imgdata.image[row * imgdata.sizes.raw_width + col][0] =
-          imgdata.color.curve[int(r * 3072.f)];
-      imgdata.image[row * imgdata.sizes.raw_width + col][1] =
-          imgdata.color.curve[int(g * 3072.f)];
-      imgdata.image[row * imgdata.sizes.raw_width + col][2] =
-          imgdata.color.curve[int(b * 3072.f)];
+      ip[col][0] = cv[int(r * 3072.f)];
+      ip[col][1] = cv[int(g * 3072.f)];
+      ip[col][2] = cv[int(b * 3072.f)];
     }
   }
   C.maximum = 16383;
@@ -20,6 +20,8 @@ void LibRaw::packed_tiled_dng_load_raw()
   ushort *rp;
   unsigned row, col;
 
+  if (!tile_width || !tile_length)
+    throw LIBRAW_EXCEPTION_IO_CORRUPT;
   int ss = shot_select;
   shot_select = libraw_internal_data.unpacker_data.dng_frames[LIM(ss, 0, (LIBRAW_IFD_MAXCOUNT * 2 - 1))] & 0xff;
   std::vector<ushort> pixel;
@@ -34,6 +36,49 @@ void LibRaw::packed_tiled_dng_load_raw()
   {
     throw LIBRAW_EXCEPTION_ALLOC; // rethrow
   }
+  if (packed_dng_fastpath())
+  {
+    /* one row of tiles is read at once, tiles rows are unpacked in
+       parallel */
+    const unsigned ntiles = (raw_width + tile_width - 1) / tile_width;
+    const unsigned rowbytes =
+        tiff_bps == 16 ? tile_width * tiff_samples * 2
+                       : unsigned((INT64(tile_width) * tiff_samples * tiff_bps + 7) / 8);
+    const int linear = is_curve_linear();
+    try
+    {
+      std::vector<uchar> data;
+      for (unsigned trow = 0; trow < raw_height; trow += tile_length)
+      {
+        checkCancel();
+        unsigned rows = MIN(tile_length, unsigned(raw_height) - trow);
+        size_t tilebytes = size_t(rows) * rowbytes;
+        data.resize(tilebytes * ntiles);
+        for (unsigned t = 0; t < ntiles; t++)
+        {
+          INT64 save = ftell(ifp);
+          fseek(ifp, get4(), SEEK_SET);
+          size_t got = fread(data.data() + tilebytes * t, 1, tilebytes, ifp);
+          if (got < tilebytes)
+          {
+            memset(data.data() + tilebytes * t + got, 0, tilebytes - got);
+            derror();
+          }
+          fseek(ifp, save + 4, SEEK_SET);
+        }
+        packed_dng_copy_rows(data.data(), ntiles, rows, rowbytes, trow,
+                             tile_width, linear);
+      }
+    }
+    catch (...)
+    {
+      shot_select = ss;
+      throw;
+    }
+    shot_select = ss;
+    return;
+  }
+
   try
   {
       unsigned trow = 0, tcol = 0;
@@ -17,6 +17,7 @@
  */
 
 #include "../../internal/dcraw_defs.h"
+#include <algorithm>
 
 void LibRaw::vc5_dng_load_raw_placeholder()
 {
@@ -53,6 +54,136 @@ void LibRaw::adobe_copy_pixel(unsigned row, unsigned col, ushort **rp)
   if (tiff_samples == 2 && shot_select)
     (*rp)--;
 }
+
+/* MSB-first packed samples (bps < 16), same bit order as getbits() */
+static void dng_unpack_bits(const uchar *src, ushort *dst, unsigned count,
+                            unsigned bps)
+{
+  unsigned i = 0;
+  switch (bps)
+  {
+  case 8:
+    for (; i < count; i++)
+      dst[i] = src[i];
+    return;
+  case 10:
+    for (; i + 4 <= count; i += 4, src += 5)
+    {
+      dst[i] = src[0] << 2 | src[1] >> 6;
+      dst[i + 1] = (src[1] & 0x3f) << 4 | src[2] >> 4;
+      dst[i + 2] = (src[2] & 0xf) << 6 | src[3] >> 2;
+      dst[i + 3] = (src[3] & 0x3) << 8 | src[4];
+    }
+    break;
+  case 12:
+    for (; i + 2 <= count; i += 2, src += 3)
+    {
+      dst[i] = src[0] << 4 | src[1] >> 4;
+      dst[i + 1] = (src[1] & 0xf) << 8 | src[2];
+    }
+    break;
+  case 14:
+    for (; i + 4 <= count; i += 4, src += 7)
+    {
+      dst[i] = src[0] << 6 | src[1] >> 2;
+      dst[i + 1] = (src[1] & 0x3) << 12 | src[2] << 4 | src[3] >> 4;
+      dst[i + 2] = (src[3] & 0xf) << 10 | src[4] << 2 | src[5] >> 6;
+      dst[i + 3] = (src[5] & 0x3f) << 8 | src[6];
+    }
+    break;
+  }
+  /* other bit depths and row tail: groups above end at byte boundary */
+  unsigned acc = 0;
+  int bits = 0;
+  for (; i < count; i++)
+  {
+    while (bits < int(bps))
+    {
+      acc = acc << 8 | *src++;
+      bits += 8;
+    }
+    bits -= bps;
+    dst[i] = (acc >> bits) & ((1u << bps) - 1);
+  }
+}
+
+/*
+   Packed DNG data already in memory: ntiles tiles (stored one after
+   another) of rows x rowbytes, tile_w pixels per tile row; each row starts
+   at byte boundary. Result is the same as getbits()/read_shorts() and
+   adobe_copy_pixel() per pixel, rows are processed in parallel.
+ */
+void LibRaw::packed_dng_copy_rows(const uchar *data, unsigned ntiles,
+                                  unsigned rows, unsigned rowbytes,
+                                  unsigned row0, unsigned tile_w,
+                                  int linear_curve)
+{
+  const unsigned ns = tiff_samples, bps = tiff_bps;
+  const unsigned s0 = (ns == 2 && shot_select) ? 1 : 0;
+  const unsigned count = tile_w * ns;
+  const int items = int(ntiles * rows);
+  const int le = order == 0x4949;
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<ushort> pixel(count + ns + 1, 0);
+    ushort *px = pixel.data();
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (int k = 0; k < items; k++)
+    {
+      const unsigned tile = unsigned(k) % ntiles, r = unsigned(k) / ntiles;
+      const unsigned row = row0 + r, col0 = tile * tile_w;
+      if (row >= raw_height || col0 >= raw_width)
+        continue;
+      const unsigned cols = MIN(tile_w, unsigned(raw_width) - col0);
+      const uchar *src = data + (size_t(tile) * rows + r) * rowbytes;
+      if (bps == 16)
+      {
+        if (le)
+          for (unsigned i = 0; i < count; i++, src += 2)
+            px[i] = src[0] | src[1] << 8;
+        else
+          for (unsigned i = 0; i < count; i++, src += 2)
+            px[i] = src[0] << 8 | src[1];
+      }
+      else
+        dng_unpack_bits(src, px, count, bps);
+
+      if (raw_image)
+      {
+        ushort *dst = raw_image + size_t(row) * (raw_pitch / 2) + col0;
+        const ushort *sp = px + s0;
+        if (linear_curve && ns == 1)
+          memcpy(dst, sp, cols * sizeof(ushort));
+        else if (linear_curve)
+          for (unsigned c = 0; c < cols; c++)
+            dst[c] = sp[c * ns];
+        else
+          for (unsigned c = 0; c < cols; c++)
+            dst[c] = curve[sp[c * ns]];
+      }
+      else
+      {
+        ushort(*dst)[4] = image + size_t(row) * raw_width + col0;
+        const ushort *sp = px + s0;
+        for (unsigned c = 0; c < cols; c++, sp += ns)
+          for (unsigned i = 0; i < ns; i++)
+            dst[c][i] = curve[sp[i]];
+      }
+    }
+  }
+}
+
+/* fast path: samples up to 16 bit, no 0xff 0x00 stuffing */
+int LibRaw::packed_dng_fastpath()
+{
+  return tiff_bps > 0 && tiff_bps <= 16 && (tiff_bps == 16 || !zero_after_ff) &&
+         tiff_samples > 0 && tiff_samples <= 4;
+}
 void LibRaw::lossless_dng_load_raw()
 {
   unsigned trow = 0, tcol = 0, jwide, jrow, jcol, row, col, i, j;
@@ -149,6 +280,42 @@ void LibRaw::packed_dng_load_raw()
   int ss = shot_select;
   shot_select = libraw_internal_data.unpacker_data.dng_frames[LIM(ss,0,(LIBRAW_IFD_MAXCOUNT*2-1))] & 0xff;
 
+  if (packed_dng_fastpath())
+  {
+    /* read by blocks of rows, unpack rows in parallel */
+    const unsigned rowbytes =
+        tiff_bps == 16 ? raw_width * tiff_samples * 2
+                       : unsigned((INT64(raw_width) * tiff_samples * tiff_bps + 7) / 8);
+    const unsigned block = MAX(1u, MIN(unsigned(raw_height),
+                                       (16u << 20) / MAX(rowbytes, 1u)));
+    const int linear = is_curve_linear();
+    try
+    {
+      std::vector<uchar> data(size_t(block) * rowbytes);
+      for (row = 0; row < raw_height; row += block)
+      {
+        checkCancel();
+        unsigned rows = MIN(block, unsigned(raw_height) - row);
+        size_t want = size_t(rows) * rowbytes;
+        size_t got = fread(data.data(), 1, want, ifp);
+        if (got < want)
+        {
+          memset(data.data() + got, 0, want - got);
+          derror();
+        }
+        packed_dng_copy_rows(data.data(), 1, rows, rowbytes, row, raw_width,
+                             linear);
+      }
+    }
+    catch (...)
+    {
+      shot_select = ss;
+      throw;
+    }
+    shot_select = ss;
+    return;
+  }
+
   pixel = (ushort *)calloc(raw_width, tiff_samples * sizeof *pixel);
   try
   {
@@ -185,15 +352,32 @@ static void jpegErrorExit_d(j_common_ptr /*cinfo*/)
   throw LIBRAW_EXCEPTION_DECODE_JPEG;
 }
 
+namespace
+{
+struct lossy_dng_tile_t
+{
+  unsigned row, col; /* tile position in full size image */
+  INT64 offset, bytes;
+  size_t data; /* position in data buffer */
+
+  struct by_offset
+  {
+    const std::vector<lossy_dng_tile_t> &tiles;
+    by_offset(const std::vector<lossy_dng_tile_t> &t) : tiles(t) {}
+    bool operator()(size_t a, size_t b) const
+    {
+      return tiles[a].offset < tiles[b].offset;
+    }
+  };
+};
+} // namespace
+
 void LibRaw::lossy_dng_load_raw()
 {
   if (!image)
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
-  struct jpeg_decompress_struct cinfo;
 
   unsigned sorder = order, ntags, opcode, deg, i, j, c;
-  unsigned trow = 0, tcol = 0, row, col;
-  INT64 save = data_offset - 4;
   ushort cur[4][256];
   double coeff[9], tot;
 
@@ -235,57 +419,199 @@ void LibRaw::lossy_dng_load_raw()
     FORC4 memcpy(cur[c], curve, sizeof cur[0]);
   }
 
-  struct jpeg_error_mgr pub;
-  cinfo.err = jpeg_std_error(&pub);
-  pub.error_exit = jpegErrorExit_d;
+  /* Tiles list: same order and offsets as tiles walk in sequential
+     decoder; tile data size from TileByteCounts (SHORT or LONG) if valid
+     and not overlapping next tile, or up to next tile (or end of file) */
+  if (!tile_width || !tile_length)
+    throw LIBRAW_EXCEPTION_DECODE_JPEG;
+  const bool tiled = tile_length < INT_MAX;
+  std::vector<lossy_dng_tile_t> tiles;
+  for (INT64 tr = 0; tr < raw_height; tr += tile_length)
+    for (INT64 tc = 0; tc < raw_width; tc += tile_width)
+    {
+      if (tiles.size() >= 1000000)
+        throw LIBRAW_EXCEPTION_DECODE_JPEG;
+      lossy_dng_tile_t t;
+      t.row = unsigned(tr);
+      t.col = unsigned(tc);
+      t.offset = data_offset + 4 * INT64(tiles.size());
+      t.bytes = 0;
+      tiles.push_back(t);
+    }
+  if (tiled)
+  {
+    fseek(ifp, data_offset, SEEK_SET);
+    for (i = 0; i < tiles.size(); i++)
+      tiles[i].offset = get4();
+  }
 
-  std::vector<JSAMPLE> buf;
+  const INT64 fsize = ifp->size();
+  int iifd = find_ifd_by_offset(data_offset);
+  if (iifd >= 0 && iifd < int(tiff_nifds) &&
+      tiff_ifd[iifd].bytes > 0)
+  {
+    if (tiles.size() == 1)
+      tiles[0].bytes = tiff_ifd[iifd].bytes;
+    else if (tiled)
+    {
+      fseek(ifp, tiff_ifd[iifd].bytes, SEEK_SET);
+      for (i = 0; i < tiles.size(); i++)
+        tiles[i].bytes = getint(tiff_ifd[iifd].tile_bytes_type);
+    }
+  }
+  std::vector<INT64> starts;
+  for (i = 0; i < tiles.size(); i++)
+    starts.push_back(tiles[i].offset);
+  std::sort(starts.begin(), starts.end());
+  INT64 total = 0;
+  for (i = 0; i < tiles.size(); i++)
+  {
+    lossy_dng_tile_t &t = tiles[i];
+    if (t.offset < 0 || t.offset >= fsize)
+      throw LIBRAW_EXCEPTION_DECODE_JPEG;
+    std::vector<INT64>::iterator next =
+        std::upper_bound(starts.begin(), starts.end(), t.offset);
+    const INT64 avail = (next == starts.end() ? fsize : *next) - t.offset;
+    if (t.bytes <= 0 || t.bytes > avail)
+      t.bytes = avail;
+    total += t.bytes;
+  }
+  if (total > INT64(imgdata.rawparams.max_raw_memory_mb) * INT64(1024 * 1024))
+    throw LIBRAW_EXCEPTION_TOOBIG;
 
-  jpeg_create_decompress(&cinfo);
+  /* DCT-domain downscale (libjpeg scale_denom): tiles should start at
+     even positions */
+  const unsigned scale =
+      (half_size &&
+       (imgdata.rawparams.options & LIBRAW_RAWOPTIONS_DNG_LOSSY_HALFSIZE) &&
+       (tile_width >= raw_width || !(tile_width & 1)) &&
+       (tile_length >= raw_height || !(tile_length & 1)))
+          ? 2
+          : 1;
+  const unsigned owidth = (width + scale - 1) / scale,
+                 oheight = (height + scale - 1) / scale;
 
-  while (trow < raw_height)
+  /* compressed data is read sequentially, tiles are decoded in parallel */
+  std::vector<uchar> data(size_t(total) + 1);
   {
-    fseek(ifp, save += 4, SEEK_SET);
-    if (tile_length < INT_MAX)
-      fseek(ifp, get4(), SEEK_SET);
-    if (libraw_internal_data.internal_data.input->jpeg_src(&cinfo) == -1)
+    std::vector<size_t> byoffset(tiles.size());
+    for (i = 0; i < tiles.size(); i++)
+      byoffset[i] = i;
+    std::sort(byoffset.begin(), byoffset.end(), lossy_dng_tile_t::by_offset(tiles));
+    size_t pos = 0;
+    for (i = 0; i < tiles.size(); i++)
     {
-      jpeg_destroy_decompress(&cinfo);
-      throw LIBRAW_EXCEPTION_DECODE_JPEG;
+      lossy_dng_tile_t &t = tiles[byoffset[i]];
+      checkCancel();
+      fseek(ifp, t.offset, SEEK_SET);
+      t.data = pos;
+      t.bytes = fread(data.data() + pos, 1, size_t(t.bytes), ifp);
+      pos += size_t(t.bytes);
     }
-    jpeg_read_header(&cinfo, TRUE);
-    jpeg_start_decompress(&cinfo);
-	if (cinfo.output_components != colors)
-		throw LIBRAW_EXCEPTION_DECODE_JPEG;
-
-	if (buf.size() < cinfo.output_width * cinfo.output_components)
-		buf = std::vector<JSAMPLE>(cinfo.output_width * cinfo.output_components,0);
+  }
 
+  const int tcolors = colors;
+  int errors = 0;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel shared(errors)
+#endif
+  {
+    /* one decompressor per thread */
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr pub;
+    cinfo.err = jpeg_std_error(&pub);
+    pub.error_exit = jpegErrorExit_d;
+    int created = 0;
     try
     {
-      JSAMPLE *buffer_array[1];
-      buffer_array[0] = buf.data();
-      while (cinfo.output_scanline < cinfo.output_height &&
-             (row = trow + cinfo.output_scanline) < height)
+      jpeg_create_decompress(&cinfo);
+      created = 1;
+    }
+    catch (...)
+    {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic
+#endif
+      errors++;
+    }
+    std::vector<JSAMPLE> buf;
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int t = 0; t < int(tiles.size()); t++)
+    {
+      int failed;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic read
+#endif
+      failed = errors;
+      if (failed)
+        continue;
+      const lossy_dng_tile_t &tile = tiles[t];
+      try
       {
-        checkCancel();
-        jpeg_read_scanlines(&cinfo, buffer_array, 1);
-        for (col = 0; col < cinfo.output_width && tcol + col < width; col++)
+        jpeg_mem_src(&cinfo, data.data() + tile.data,
+                     (unsigned long)tile.bytes);
+        jpeg_read_header(&cinfo, TRUE);
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = scale;
+        jpeg_start_decompress(&cinfo);
+        if (cinfo.output_components != tcolors)
+          throw LIBRAW_EXCEPTION_DECODE_JPEG;
+        if (buf.size() < cinfo.output_width * cinfo.output_components)
+          buf.resize(cinfo.output_width * cinfo.output_components);
+
+        JSAMPLE *buffer_array[1];
+        buffer_array[0] = buf.data();
+        const unsigned trow = tile.row / scale, tcol = tile.col / scale;
+        unsigned row, col;
+        while (cinfo.output_scanline < cinfo.output_height &&
+               (row = trow + cinfo.output_scanline) < oheight)
         {
-          FORC(colors) image[row * width + tcol + col][c] = cur[c][buf[col*colors+c]];
+          jpeg_read_scanlines(&cinfo, buffer_array, 1);
+          ushort(*ip)[4] = image + size_t(row) * owidth + tcol;
+          const JSAMPLE *bp = buf.data();
+          for (col = 0; col < cinfo.output_width && tcol + col < owidth;
+               col++, bp += tcolors)
+            for (int c = 0; c < tcolors; c++)
+              ip[col][c] = cur[c][bp[c]];
         }
+        jpeg_abort_decompress(&cinfo);
+      }
+      catch (...)
+      {
+        jpeg_abort_decompress(&cinfo);
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic
+#endif
+        errors++;
       }
     }
-    catch (...)
-    {
+    if (created)
       jpeg_destroy_decompress(&cinfo);
-      throw;
+  }
+  if (errors)
+    throw LIBRAW_EXCEPTION_DECODE_JPEG;
+
+  if (scale > 1)
+  {
+    /* decoded at half size: sizes saved by unpack() are the new ones */
+    width = owidth;
+    height = oheight;
+    raw_pitch = owidth * 8;
+    libraw_internal_data.internal_data.raw_decode_scale = scale;
+    for (int k = 0; k < 2; k++)
+    {
+      libraw_raw_inset_crop_t &crop = imgdata.sizes.raw_inset_crops[k];
+      if (crop.cleft != 0xffff)
+        crop.cleft /= 2;
+      if (crop.ctop != 0xffff)
+        crop.ctop /= 2;
+      crop.cwidth = (crop.cwidth + 1) / 2;
+      crop.cheight = (crop.cheight + 1) / 2;
     }
-    jpeg_abort_decompress(&cinfo);
-    if ((tcol += tile_width) >= raw_width)
-      trow += tile_length + (tcol = 0);
   }
-  jpeg_destroy_decompress(&cinfo);
   maximum = 0xffff;
 }
 #endif
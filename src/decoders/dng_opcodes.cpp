@@ -0,0 +1,821 @@
+/* -*- C++ -*-
+ * Copyright 2019-2024 LibRaw LLC (info@libraw.org)
+ *
+ * Native DNG OpcodeList1/OpcodeList2 interpreter: GainMap, MapTable,
+ * MapPolynomial, DeltaPerRow/Column, ScalePerRow/Column and
+ * FixBadPixelsConstant/List applied in place to unpacked raw data,
+ * without DNG SDK.
+
+ LibRaw is free software; you can redistribute it and/or modify
+ it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+
+#include "../../internal/libraw_cxx_defs.h"
+#include <algorithm>
+
+namespace
+{
+enum dng_opcode_ids
+{
+  DNG_OP_FIXBADPIXELSCONSTANT = 4,
+  DNG_OP_FIXBADPIXELSLIST = 5,
+  DNG_OP_MAPTABLE = 7,
+  DNG_OP_MAPPOLYNOMIAL = 8,
+  DNG_OP_GAINMAP = 9,
+  DNG_OP_DELTAPERROW = 10,
+  DNG_OP_DELTAPERCOLUMN = 11,
+  DNG_OP_SCALEPERROW = 12,
+  DNG_OP_SCALEPERCOLUMN = 13
+};
+
+/* Opcode lists are always big-endian */
+struct dng_oplist_reader_t
+{
+  const uchar *p, *end;
+  dng_oplist_reader_t(const uchar *data, size_t len) : p(data), end(data + len)
+  {
+  }
+  bool has(size_t n) const { return size_t(end - p) >= n; }
+  unsigned u32()
+  {
+    if (!has(4))
+    {
+      p = end;
+      return 0;
+    }
+    unsigned v = unsigned(p[0]) << 24 | unsigned(p[1]) << 16 |
+                 unsigned(p[2]) << 8 | p[3];
+    p += 4;
+    return v;
+  }
+  ushort u16()
+  {
+    if (!has(2))
+    {
+      p = end;
+      return 0;
+    }
+    ushort v = ushort(p[0] << 8 | p[1]);
+    p += 2;
+    return v;
+  }
+  float f32()
+  {
+    unsigned v = u32();
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+  }
+  double f64()
+  {
+    UINT64 v = UINT64(u32()) << 32;
+    v |= u32();
+    double d;
+    memcpy(&d, &v, sizeof(d));
+    return d;
+  }
+};
+
+struct dng_op_area_t
+{
+  int top, left, bottom, right;
+  unsigned plane, planes, rowpitch, colpitch;
+  /* opcode values in full resolution coordinates, see dng_op_image_t::scale */
+  int top0, left0;
+  unsigned rowpitch0, colpitch0;
+  int nrows() const { return (bottom - top + int(rowpitch) - 1) / int(rowpitch); }
+  int ncols() const { return (right - left + int(colpitch) - 1) / int(colpitch); }
+};
+
+/*
+   Stage image: part of unpacked buffer addressed by opcodes. Stage 1 is the
+   whole raw frame, stage 2 is the active area (width x height at
+   top_margin/left_margin). Opcodes operate on 0..1 values: integer stage 1
+   data is scaled by 1/65535, stage 2 data is normalized to black..maximum
+   (as DNG SDK linearization does), float data is used as is.
+   Lossy DNG decoded at half size (LIBRAW_RAWOPTIONS_DNG_LOSSY_HALFSIZE)
+   has scale 2: opcode coordinates are divided by it.
+ */
+struct dng_op_image_t
+{
+  ushort *u;
+  float *f;
+  size_t stride; /* samples */
+  int channels, rows, cols, row0, col0;
+  int normalize;
+  float white;
+  float black[4];
+  const unsigned *pattern;
+  int prows, pcols;
+  int cfa; /* single-plane Bayer data, colors from cfa[][] */
+  int scale;
+  unsigned char cfacolor[48][48];
+
+  size_t index(int row, int col, unsigned p) const
+  {
+    return size_t(row0 + row) * stride + size_t(col0 + col) * channels + p;
+  }
+  void level(int row, int col, unsigned p, float &base, float &range) const
+  {
+    if (!normalize)
+    {
+      base = 0.f;
+      range = u ? 65535.f : 1.f;
+      return;
+    }
+    int c = channels > 1 ? int(p) : cfacolor[row % 48][col % 48];
+    base = black[c & 3];
+    if (pattern)
+      base += pattern[(row % prows) * pcols + col % pcols];
+    range = white - base;
+    if (range < 1.f)
+      range = 1.f;
+  }
+  /* level() for ncols area columns (col, col + colpitch, ...) and planes
+     p..p+np-1 of row, layout [column][plane]; modulos are taken once */
+  void levels(int row, int col, unsigned colpitch, int ncols, unsigned p,
+              unsigned np, float *base, float *range) const
+  {
+    const int n = ncols * int(np);
+    if (!normalize)
+    {
+      const float r = u ? 65535.f : 1.f;
+      for (int k = 0; k < n; k++)
+      {
+        base[k] = 0.f;
+        range[k] = r;
+      }
+      return;
+    }
+    const unsigned char *crow = cfacolor[row % 48];
+    const unsigned *prow = pattern ? pattern + (row % prows) * pcols : 0;
+    const int cstep = int(colpitch % 48), pstep = prow ? int(colpitch % pcols) : 0;
+    int cc = col % 48, pc = prow ? col % pcols : 0;
+    for (int ci = 0, k = 0; ci < ncols; ci++)
+    {
+      for (unsigned pi = 0; pi < np; pi++, k++)
+      {
+        int c = channels > 1 ? int(p + pi) : crow[cc];
+        base[k] = black[c & 3];
+        if (prow)
+          base[k] += prow[pc];
+        range[k] = white - base[k];
+        if (range[k] < 1.f)
+          range[k] = 1.f;
+      }
+      if ((cc += cstep) >= 48)
+        cc -= 48;
+      if (prow && (pc += pstep) >= pcols)
+        pc -= pcols;
+    }
+  }
+  float get(int row, int col, unsigned p) const
+  {
+    float base, range;
+    size_t i = index(row, col, p);
+    if (f)
+      return f[i];
+    level(row, col, p, base, range);
+    return (u[i] - base) / range;
+  }
+};
+
+/*
+   Runs op over every row of the area: samples are gathered to 0..1 floats
+   (layout [column][plane]), transformed by op(row, x) and stored back.
+   Rows are independent, so they are processed in parallel.
+ */
+template <class Op>
+void dng_op_rows(const dng_op_image_t &im, const dng_op_area_t &a, const Op &op)
+{
+  const int nrows = a.nrows(), ncols = a.ncols();
+  const unsigned np = a.planes;
+  const int n = ncols * int(np);
+  const float white = im.normalize ? im.white : 65535.f;
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<float> buf(size_t(n) * 3);
+    float *x = buf.data(), *base = x + n, *range = base + n;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+    for (int ri = 0; ri < nrows; ri++)
+    {
+      const int row = a.top + ri * int(a.rowpitch);
+      if (im.f)
+      {
+        for (int ci = 0, k = 0; ci < ncols; ci++)
+        {
+          const float *src = im.f + im.index(row, a.left + ci * a.colpitch, a.plane);
+          for (unsigned pi = 0; pi < np; pi++, k++)
+            x[k] = src[pi];
+        }
+        op(row, x);
+        for (int ci = 0, k = 0; ci < ncols; ci++)
+        {
+          float *dst = im.f + im.index(row, a.left + ci * a.colpitch, a.plane);
+          for (unsigned pi = 0; pi < np; pi++, k++)
+            dst[pi] = x[k];
+        }
+        continue;
+      }
+      im.levels(row, a.left, a.colpitch, ncols, a.plane, np, base, range);
+      for (int ci = 0, k = 0; ci < ncols; ci++)
+      {
+        const ushort *src = im.u + im.index(row, a.left + ci * a.colpitch, a.plane);
+        for (unsigned pi = 0; pi < np; pi++, k++)
+          x[k] = (src[pi] - base[k]) / range[k];
+      }
+      op(row, x);
+      for (int ci = 0, k = 0; ci < ncols; ci++)
+      {
+        ushort *dst = im.u + im.index(row, a.left + ci * a.colpitch, a.plane);
+        for (unsigned pi = 0; pi < np; pi++, k++)
+        {
+          float v = base[k] + x[k] * range[k];
+          dst[pi] = ushort(v < 0.f ? 0.f : (v > white ? white : v) + 0.5f);
+        }
+      }
+    }
+  }
+}
+
+/* MapTable and MapPolynomial on integer data: 16-bit input table */
+struct dng_op_lut_t
+{
+  const float *lut;
+  int n;
+  void operator()(int, float *x) const
+  {
+    for (int k = 0; k < n; k++)
+    {
+      float v = x[k] * 65535.f + 0.5f;
+      x[k] = lut[v < 0.f ? 0 : (v > 65535.f ? 65535 : int(v))];
+    }
+  }
+};
+
+struct dng_op_polynomial_t
+{
+  double coeff[9];
+  int degree, n;
+  float eval(float x) const
+  {
+    double v = coeff[degree];
+    for (int d = degree - 1; d >= 0; d--)
+      v = v * x + coeff[d];
+    return float(v);
+  }
+  void operator()(int, float *x) const
+  {
+    for (int k = 0; k < n; k++)
+      x[k] = eval(x[k]);
+  }
+};
+
+/* DeltaPer*, ScalePer*: one value per area row or per area column,
+   indexed in full resolution coordinates */
+struct dng_op_perline_t
+{
+  const float *values;
+  unsigned count, np;
+  int top0, rowpitch0, imscale, ncols;
+  int percolumn, scale;
+  const int *cidx; /* value index per area column, -1 if none */
+  void operator()(int row, float *x) const
+  {
+    if (!percolumn)
+    {
+      unsigned i = unsigned(MAX(row * imscale - top0, 0)) / rowpitch0;
+      if (i >= count)
+        return;
+      const float v = values[i];
+      const int n = ncols * np;
+      if (scale)
+        for (int k = 0; k < n; k++)
+          x[k] *= v;
+      else
+        for (int k = 0; k < n; k++)
+          x[k] += v;
+      return;
+    }
+    for (int ci = 0; ci < ncols; ci++)
+    {
+      if (cidx[ci] < 0)
+        continue;
+      const float v = values[cidx[ci]];
+      float *px = x + size_t(ci) * np;
+      if (scale)
+        for (unsigned pi = 0; pi < np; pi++)
+          px[pi] *= v;
+      else
+        for (unsigned pi = 0; pi < np; pi++)
+          px[pi] += v;
+    }
+  }
+};
+
+/* Map point index and fraction for image position, as in DNG SDK */
+inline void dng_gainmap_pos(double pos, double origin, double spacing,
+                            int points, int &idx, float &fract)
+{
+  double f = spacing > 0. ? (pos - origin) / spacing : 0.;
+  if (f <= 0.)
+  {
+    idx = 0;
+    fract = 0.f;
+  }
+  else if (f >= points - 1)
+  {
+    idx = points - 1;
+    fract = 0.f;
+  }
+  else
+  {
+    idx = int(f);
+    fract = float(f - idx);
+  }
+}
+
+struct dng_op_gainmap_t
+{
+  const float *gains;
+  int pv, ph, mplanes, ncols, rows;
+  unsigned np;
+  double spacingv, originv;
+  const int *cidx;     /* per area column */
+  const float *cfract; /* per area column */
+  void operator()(int row, float *x) const
+  {
+    int r0;
+    float rf;
+    dng_gainmap_pos((row + 0.5) / rows, originv, spacingv, pv, r0, rf);
+    const int r1 = MIN(r0 + 1, pv - 1);
+    const float *g0 = gains + size_t(r0) * ph * mplanes;
+    const float *g1 = gains + size_t(r1) * ph * mplanes;
+    for (int ci = 0; ci < ncols; ci++)
+    {
+      const int c0 = cidx[ci] * mplanes, c1 = MIN(cidx[ci] + 1, ph - 1) * mplanes;
+      const float cf = cfract[ci];
+      float *px = x + size_t(ci) * np;
+      for (unsigned pi = 0; pi < np; pi++)
+      {
+        const int mp = MIN(int(pi), mplanes - 1);
+        float top = g0[c0 + mp] + (g0[c1 + mp] - g0[c0 + mp]) * cf;
+        float bottom = g1[c0 + mp] + (g1[c1 + mp] - g1[c0 + mp]) * cf;
+        px[pi] *= top + (bottom - top) * rf;
+      }
+    }
+  }
+};
+
+inline INT64 dng_bad_key(int row, int col) { return (INT64(row) << 32) | unsigned(col); }
+
+/*
+   Bad pixels are replaced by average of nearest same color neighbours
+   (distance 2 for Bayer red/blue, plus diagonals for green, distance 1 for
+   non-CFA data) which are not bad. bad[] is sorted.
+ */
+void dng_fix_bad_pixels(const dng_op_image_t &im, const std::vector<INT64> &bad,
+                        unsigned phase)
+{
+  static const int cross2[4][2] = {{-2, 0}, {2, 0}, {0, -2}, {0, 2}};
+  static const int diag1[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+  static const int cross1[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  const int count = int(bad.size());
+  std::vector<ushort> repl(bad.size());
+  std::vector<char> found(bad.size(), 0);
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < count; i++)
+  {
+    const int row = int(bad[i] >> 32), col = int(bad[i] & 0xffffffff);
+    const int green =
+        im.cfa && ((row + col + (phase == 1 || phase == 2 ? 1 : 0)) & 1);
+    for (int scale = 1; scale <= 2 && !found[i]; scale++)
+    {
+      unsigned sum = 0, n = 0;
+      for (int set = 0; set < 2; set++)
+      {
+        const int(*nb)[2] = im.cfa ? (set ? diag1 : cross2) : cross1;
+        if (set && !green)
+          break;
+        for (int k = 0; k < 4; k++)
+        {
+          int r = row + nb[k][0] * scale, c = col + nb[k][1] * scale;
+          if (r < 0 || c < 0 || r >= im.rows || c >= im.cols ||
+              std::binary_search(bad.begin(), bad.end(), dng_bad_key(r, c)))
+            continue;
+          sum += im.u[im.index(r, c, 0)];
+          n++;
+        }
+        if (!im.cfa)
+          break;
+      }
+      if (n)
+      {
+        repl[i] = ushort((sum + n / 2) / n);
+        found[i] = 1;
+      }
+    }
+  }
+  for (int i = 0; i < count; i++)
+    if (found[i])
+      im.u[im.index(int(bad[i] >> 32), int(bad[i] & 0xffffffff), 0)] = repl[i];
+}
+
+/* Reads and clips area spec, returns 0 if nothing to do */
+int dng_read_area(dng_oplist_reader_t &rd, const dng_op_image_t &im,
+                  dng_op_area_t &a)
+{
+  unsigned rect[4];
+  for (int i = 0; i < 4; i++)
+    rect[i] = rd.u32();
+  a.plane = rd.u32();
+  a.planes = rd.u32();
+  a.rowpitch0 = rd.u32();
+  a.colpitch0 = rd.u32();
+  if (!a.rowpitch0 || !a.colpitch0 || a.rowpitch0 > 65535 || a.colpitch0 > 65535)
+    return 0;
+  /* half size data: area is extended to cover partially affected pixels */
+  const unsigned s = unsigned(im.scale);
+  a.top0 = int(MIN(rect[0], unsigned(im.rows) * s));
+  a.left0 = int(MIN(rect[1], unsigned(im.cols) * s));
+  a.rowpitch = MAX(a.rowpitch0 / s, 1U);
+  a.colpitch = MAX(a.colpitch0 / s, 1U);
+  a.top = int(MIN(rect[0] / s, unsigned(im.rows)));
+  a.left = int(MIN(rect[1] / s, unsigned(im.cols)));
+  a.bottom = int(MIN(rect[2] / s + (rect[2] % s != 0), unsigned(im.rows)));
+  a.right = int(MIN(rect[3] / s + (rect[3] % s != 0), unsigned(im.cols)));
+  if (a.top >= a.bottom || a.left >= a.right ||
+      a.plane >= unsigned(im.channels) || !a.planes)
+    return 0;
+  a.planes = MIN(a.planes, unsigned(im.channels) - a.plane);
+  return 1;
+}
+} // namespace
+
+/*
+   Applies one opcode list to unpacked data. stage: 1 or 2 (coordinates
+   and value scale, see dng_op_image_t). Returns number of non-optional
+   opcodes not applied.
+ */
+int LibRaw::apply_dng_opcode_list(const uchar *data, unsigned len, int stage)
+{
+  dng_op_image_t im;
+  memset(&im, 0, sizeof(im));
+  im.scale = MAX(int(libraw_internal_data.internal_data.raw_decode_scale), 1);
+  if (imgdata.rawdata.raw_image)
+  {
+    im.u = imgdata.rawdata.raw_image;
+    im.channels = 1;
+    im.stride = S.raw_pitch / 2;
+  }
+  else if (imgdata.rawdata.color4_image)
+  {
+    im.u = (ushort *)imgdata.rawdata.color4_image;
+    im.channels = 4;
+    im.stride = S.raw_pitch / 2;
+  }
+  else if (imgdata.rawdata.float_image)
+  {
+    im.f = imgdata.rawdata.float_image;
+    im.channels = 1;
+    im.stride = S.raw_pitch / 4;
+  }
+  else if (imgdata.rawdata.float3_image)
+  {
+    im.f = (float *)imgdata.rawdata.float3_image;
+    im.channels = 3;
+    im.stride = S.raw_pitch / 4;
+  }
+  else if (imgdata.rawdata.float4_image)
+  {
+    im.f = (float *)imgdata.rawdata.float4_image;
+    im.channels = 4;
+    im.stride = S.raw_pitch / 4;
+  }
+  else
+    return 0;
+
+  if (stage == 1)
+  {
+    im.rows = S.raw_height;
+    im.cols = S.raw_width;
+  }
+  else
+  {
+    im.rows = MIN(int(S.height), int(S.raw_height) - int(S.top_margin));
+    im.cols = MIN(int(S.width), int(S.raw_width) - int(S.left_margin));
+    im.row0 = S.top_margin;
+    im.col0 = S.left_margin;
+    if (im.u)
+    {
+      if (C.maximum <= C.black)
+        return 0;
+      im.normalize = 1;
+      im.white = float(C.maximum);
+      for (int c = 0; c < 4; c++)
+        im.black[c] = float(C.black + C.cblack[c]);
+      if (C.cblack[4] && C.cblack[5] &&
+          C.cblack[4] * C.cblack[5] <= LIBRAW_CBLACK_SIZE - 6)
+      {
+        im.pattern = C.cblack + 6;
+        im.prows = C.cblack[4];
+        im.pcols = C.cblack[5];
+      }
+    }
+  }
+  if (im.rows <= 0 || im.cols <= 0)
+    return 0;
+  /* Bayer data: colors of visible area pixels (levels and bad pixels) */
+  if (im.channels == 1 && P1.filters)
+  {
+    im.cfa = P1.filters != 1 && P1.filters != 9;
+    if (im.normalize)
+      for (int r = 0; r < 48; r++)
+        for (int c = 0; c < 48; c++)
+          im.cfacolor[r][c] = fcol(r, c) & 3;
+  }
+
+  int skipped = 0;
+  dng_oplist_reader_t rd(data, len);
+  unsigned count = rd.u32();
+  while (count-- && rd.has(16))
+  {
+    checkCancel();
+    const unsigned id = rd.u32();
+    rd.u32(); /* version */
+    const unsigned flags = rd.u32();
+    const unsigned bytes = rd.u32();
+    if (!rd.has(bytes))
+      break;
+    dng_oplist_reader_t op(rd.p, bytes);
+    rd.p += bytes;
+    dng_op_area_t a;
+    int done = 0;
+  
+    switch (id)
+    {
+    case DNG_OP_FIXBADPIXELSCONSTANT:
+    case DNG_OP_FIXBADPIXELSLIST:
+    {
+      /* half size data has no single sample pixels */
+      if (!im.u || im.channels != 1 || (P1.filters && !im.cfa) || im.scale > 1)
+        break;
+      std::vector<INT64> bad;
+      unsigned phase;
+      if (id == DNG_OP_FIXBADPIXELSCONSTANT)
+      {
+        const unsigned constant = op.u32();
+        phase = op.u32();
+        std::vector<std::vector<INT64> > rowbad(im.rows);
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int row = 0; row < im.rows; row++)
+          for (int col = 0; col < im.cols; col++)
+          {
+            float v = im.u[im.index(row, col, 0)];
+            if (im.normalize)
+              v = im.get(row, col, 0) * 65535.f + 0.5f;
+            if (v >= 0.f && unsigned(v) == constant)
+              rowbad[row].push_back(dng_bad_key(row, col));
+          }
+        for (int row = 0; row < im.rows; row++)
+          bad.insert(bad.end(), rowbad[row].begin(), rowbad[row].end());
+      }
+      else
+      {
+        phase = op.u32();
+        const unsigned points = op.u32(), rects = op.u32();
+        if (!op.has(size_t(points) * 8 + size_t(rects) * 16))
+          break;
+        const INT64 limit = INT64(im.rows) * im.cols;
+        for (unsigned i = 0; i < points; i++)
+        {
+          unsigned row = op.u32(), col = op.u32();
+          if (row < unsigned(im.rows) && col < unsigned(im.cols))
+            bad.push_back(dng_bad_key(row, col));
+        }
+        for (unsigned i = 0; i < rects; i++)
+        {
+          unsigned rect[4];
+          for (int k = 0; k < 4; k++)
+            rect[k] = op.u32();
+          int t = int(MIN(rect[0], unsigned(im.rows)));
+          int l = int(MIN(rect[1], unsigned(im.cols)));
+          int b = int(MIN(rect[2], unsigned(im.rows)));
+          int r = int(MIN(rect[3], unsigned(im.cols)));
+          if (INT64(bad.size()) + INT64(MAX(b - t, 0)) * MAX(r - l, 0) > limit)
+            break;
+          for (int row = t; row < b; row++)
+            for (int col = l; col < r; col++)
+              bad.push_back(dng_bad_key(row, col));
+        }
+        std::sort(bad.begin(), bad.end());
+        bad.erase(std::unique(bad.begin(), bad.end()), bad.end());
+      }
+      if (!bad.empty())
+        dng_fix_bad_pixels(im, bad, phase & 3);
+      done = 1;
+      break;
+    }
+    case DNG_OP_MAPTABLE:
+    {
+      if (!dng_read_area(op, im, a))
+      {
+        done = 1;
+        break;
+      }
+      const unsigned size = op.u32();
+      if (!size || size > 65536 || !op.has(size_t(size) * 2))
+        break;
+      std::vector<float> lut(65536);
+      for (unsigned i = 0; i < size; i++)
+        lut[i] = op.u16() / 65535.f;
+      for (unsigned i = size; i < 65536; i++)
+        lut[i] = lut[size - 1];
+      dng_op_lut_t t = {lut.data(), a.ncols() * int(a.planes)};
+      dng_op_rows(im, a, t);
+      done = 1;
+      break;
+    }
+    case DNG_OP_MAPPOLYNOMIAL:
+    {
+      /* lossy DNG decoder applies it as tone curve */
+      if (stage == 2 && load_raw == &LibRaw::lossy_dng_load_raw)
+      {
+        done = 1;
+        break;
+      }
+      if (!dng_read_area(op, im, a))
+      {
+        done = 1;
+        break;
+      }
+      dng_op_polynomial_t poly;
+      poly.degree = int(op.u32());
+      if (poly.degree > 8 || !op.has(size_t(poly.degree + 1) * 8))
+        break;
+      for (int d = 0; d <= poly.degree; d++)
+        poly.coeff[d] = op.f64();
+      poly.n = a.ncols() * int(a.planes);
+      if (im.f)
+      {
+        dng_op_rows(im, a, poly);
+        done = 1;
+        break;
+      }
+      std::vector<float> lut(65536);
+      float *lp = lut.data();
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (int i = 0; i < 65536; i++)
+      {
+        float v = poly.eval(i / 65535.f);
+        lp[i] = LIM(v, 0.f, 1.f);
+      }
+      dng_op_lut_t t = {lp, poly.n};
+      dng_op_rows(im, a, t);
+      done = 1;
+      break;
+    }
+    case DNG_OP_GAINMAP:
+    {
+      if (!dng_read_area(op, im, a))
+      {
+        done = 1;
+        break;
+      }
+      dng_op_gainmap_t g;
+      const unsigned pv = op.u32(), ph = op.u32();
+      g.spacingv = op.f64();
+      const double spacingh = op.f64();
+      g.originv = op.f64();
+      const double originh = op.f64();
+      const unsigned mplanes = op.u32();
+      if (!pv || !ph || !mplanes || pv > 65535 || ph > 65535 || mplanes > 4)
+        break;
+      g.pv = int(pv);
+      g.ph = int(ph);
+      g.mplanes = int(mplanes);
+      if (!op.has(size_t(g.pv) * g.ph * g.mplanes * 4))
+        break;
+      std::vector<float> gains(size_t(g.pv) * g.ph * g.mplanes);
+      for (size_t i = 0; i < gains.size(); i++)
+        gains[i] = op.f32();
+      g.ncols = a.ncols();
+      g.np = a.planes;
+      g.rows = im.rows;
+      std::vector<int> cidx(g.ncols);
+      std::vector<float> cfract(g.ncols);
+      for (int ci = 0; ci < g.ncols; ci++)
+        dng_gainmap_pos((a.left + ci * a.colpitch + 0.5) / im.cols, originh,
+                        spacingh, g.ph, cidx[ci], cfract[ci]);
+      g.gains = gains.data();
+      g.cidx = cidx.data();
+      g.cfract = cfract.data();
+      dng_op_rows(im, a, g);
+      done = 1;
+      break;
+    }
+    case DNG_OP_DELTAPERROW:
+    case DNG_OP_DELTAPERCOLUMN:
+    case DNG_OP_SCALEPERROW:
+    case DNG_OP_SCALEPERCOLUMN:
+    {
+      if (!dng_read_area(op, im, a))
+      {
+        done = 1;
+        break;
+      }
+      const unsigned n = op.u32();
+      if (!op.has(size_t(n) * 4))
+        break;
+      std::vector<float> values(n ? n : 1);
+      for (unsigned i = 0; i < n; i++)
+        values[i] = op.f32();
+      dng_op_perline_t pl;
+      pl.values = values.data();
+      pl.count = n;
+      pl.np = a.planes;
+      pl.top0 = a.top0;
+      pl.rowpitch0 = int(a.rowpitch0);
+      pl.imscale = im.scale;
+      pl.ncols = a.ncols();
+      std::vector<int> cidx(pl.ncols);
+      for (int ci = 0; ci < pl.ncols; ci++)
+      {
+        unsigned i = unsigned(MAX((a.left + ci * int(a.colpitch)) * im.scale - a.left0, 0)) /
+                     a.colpitch0;
+        cidx[ci] = i < n ? int(i) : -1;
+      }
+      pl.cidx = cidx.data();
+      pl.percolumn = id == DNG_OP_DELTAPERCOLUMN || id == DNG_OP_SCALEPERCOLUMN;
+      pl.scale = id == DNG_OP_SCALEPERROW || id == DNG_OP_SCALEPERCOLUMN;
+      dng_op_rows(im, a, pl);
+      done = 1;
+      break;
+    }
+    default:
+      break;
+    }
+    if (!done && !(flags & 1))
+      skipped++;
+  }
+  return skipped;
+}
+
+/* Non-zero if apply_dng_opcodes() may change unpacked data */
+int LibRaw::dng_opcodes_pending()
+{
+  const unpacker_data_t &ud = libraw_internal_data.unpacker_data;
+  return imgdata.idata.dng_version &&
+         (imgdata.rawparams.options & LIBRAW_RAWOPTIONS_DNG_APPLY_OPCODES) &&
+         !(imgdata.process_warnings & LIBRAW_WARN_DNGSDK_PROCESSED) &&
+         (ud.dng_opcodes_offset[0] || ud.dng_opcodes_offset[1]);
+}
+
+/*
+   OpcodeList1 and OpcodeList2 of selected DNG frame, applied in place if
+   LIBRAW_RAWOPTIONS_DNG_APPLY_OPCODES is set and data was not processed by
+   DNG SDK. OpcodeList3 (lens corrections on demosaiced data) is not applied.
+ */
+void LibRaw::apply_dng_opcodes()
+{
+  if (!dng_opcodes_pending())
+    return;
+  unpacker_data_t &ud = libraw_internal_data.unpacker_data;
+  int skipped = 0, applied = 0;
+  for (int q = 0; q < 2; q++)
+  {
+    const unsigned len = ud.dng_opcodes_len[q];
+    if (!ud.dng_opcodes_offset[q] || len < 4 ||
+        INT64(len) > INT64(imgdata.rawparams.max_raw_memory_mb) * 1024 * 1024)
+      continue;
+    std::vector<uchar> data(len);
+    ID.input->seek(ud.dng_opcodes_offset[q], SEEK_SET);
+    if (ID.input->read(data.data(), 1, len) != int(len))
+      continue;
+    skipped += apply_dng_opcode_list(data.data(), len, q + 1);
+    applied++;
+  }
+  if (applied)
+    imgdata.process_warnings |= LIBRAW_WARN_DNG_OPCODES_APPLIED;
+  if (skipped)
+    imgdata.process_warnings |= LIBRAW_WARN_DNG_OPCODES_SKIPPED;
+}
@@ -252,6 +252,31 @@ static float expandFloats(unsigned char *dst, int tileWidth, int bytesps)
   return max;
 }
 
+/* FP16 data kept as is until integer conversion: for non-negative
+   finite halves the bit pattern order is the value order */
+static inline ushort halfMaxKey(ushort h)
+{
+  if ((h & 0x8000) || ((h & 0x7c00) == 0x7c00 && (h & 0x3ff)))
+    return 0; // negative or NaN
+  return h;
+}
+
+static ushort halfMax(const ushort *h, size_t count)
+{
+  ushort m = 0;
+  for (size_t i = 0; i < count; i++)
+    m = MAX(m, halfMaxKey(h[i]));
+  return m;
+}
+
+static float halfToFloat(ushort h)
+{
+  unsigned int u = __DNG_HalfToFloat(h);
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
 struct tile_stripe_data_t
 {
     bool tiled, striped;
@@ -349,11 +374,19 @@ void LibRaw::deflate_dng_load_raw()
   tiles.init(ifd, imgdata.sizes, libraw_internal_data.unpacker_data, libraw_internal_data.unpacker_data.order,
       libraw_internal_data.internal_data.input);
 
-  if (ifd->sample_format == 3)
-      float_raw_image = (float *)calloc(tiles.tileCnt * tiles.tileWidth * tiles.tileHeight *ifd->samples, sizeof(float));
-  else
+  if (ifd->sample_format != 3)
     throw LIBRAW_EXCEPTION_DECODE_RAW; // Only float deflated supported
 
+  int bytesps = ifd->bps >> 3;
+  // 16-bit float data to be converted to integer: no expansion to float32
+  bool keephalf = bytesps == 2 && (imgdata.rawparams.options & LIBRAW_RAWOPTIONS_CONVERTFLOAT_TO_INT);
+  ushort *half_raw_image = 0;
+  ushort hmax = 0;
+  if (keephalf)
+    half_raw_image = (ushort *)calloc(size_t(imgdata.sizes.raw_width) * size_t(imgdata.sizes.raw_height) * ifd->samples, sizeof(ushort));
+  else
+    float_raw_image = (float *)calloc(tiles.tileCnt * tiles.tileWidth * tiles.tileHeight *ifd->samples, sizeof(float));
+
   int xFactor;
   switch (ifd->predictor)
   {
@@ -396,7 +429,6 @@ void LibRaw::deflate_dng_load_raw()
         }
         else
         {
-          int bytesps = ifd->bps >> 3;
           size_t rowsInTile = y + tiles.tileHeight > imgdata.sizes.raw_height ? imgdata.sizes.raw_height - y : tiles.tileHeight;
           size_t colsInTile = x + tiles.tileWidth > imgdata.sizes.raw_width ? imgdata.sizes.raw_width - x : tiles.tileWidth;
 
@@ -405,6 +437,14 @@ void LibRaw::deflate_dng_load_raw()
               unsigned char *dst = uBuffer.data() + row * tiles.tileWidth * bytesps * ifd->samples;
               unsigned char *src = dst + tileRowBytes;
               DecodeFPDelta(src, dst, tiles.tileWidth / xFactor, ifd->samples * xFactor, bytesps);
+              if (keephalf)
+              {
+                ushort *hdst = &half_raw_image[((y + row) * imgdata.sizes.raw_width + x) * ifd->samples];
+                memmove(hdst, dst, colsInTile * ifd->samples * sizeof(ushort));
+                // whole tile row (padding too), as expandFloats() below
+                hmax = MAX(hmax, halfMax((ushort *)dst, tiles.tileWidth * ifd->samples));
+                continue;
+              }
               float lmax = expandFloats(dst, tiles.tileWidth * ifd->samples, bytesps);
             max = MAX(max, lmax);
             unsigned char *dst2 = (unsigned char *)&float_raw_image
@@ -414,7 +454,14 @@ void LibRaw::deflate_dng_load_raw()
         }
       }
     }
-  
+
+  if (keephalf)
+  {
+    imgdata.color.fmaximum = halfToFloat(hmax);
+    convertHalfToInt(half_raw_image, ifd->samples);
+    return;
+  }
+
   imgdata.color.fmaximum = max;
 
   // Set fields according to data format
@@ -464,34 +511,8 @@ int LibRaw::have_fpdata()
          imgdata.rawdata.float4_image;
 }
 
-void LibRaw::convertFloatToInt(float dmin /* =4096.f */,
-                               float dmax /* =32767.f */,
-                               float dtarget /*= 16383.f */)
+float LibRaw::fp_int_scale(float dmin, float dmax, float dtarget)
 {
-  int samples = 0;
-  float *data = 0;
-  void *orawalloc = imgdata.rawdata.raw_alloc;
-  if (imgdata.rawdata.float_image)
-  {
-    samples = 1;
-    data = imgdata.rawdata.float_image;
-  }
-  else if (imgdata.rawdata.float3_image)
-  {
-    samples = 3;
-    data = (float *)imgdata.rawdata.float3_image;
-  }
-  else if (imgdata.rawdata.float4_image)
-  {
-    samples = 4;
-    data = (float *)imgdata.rawdata.float4_image;
-  }
-  else
-    return;
-
-  ushort *raw_alloc = (ushort *)malloc(
-      imgdata.sizes.raw_height * imgdata.sizes.raw_width *
-      libraw_internal_data.unpacker_data.tiff_samples * sizeof(ushort));
   float tmax = float(MAX(imgdata.color.maximum, 1));
   float datamax = imgdata.color.fmaximum;
 
@@ -514,15 +535,11 @@ void LibRaw::convertFloatToInt(float dmin /* =4096.f */,
   }
   else
     imgdata.rawdata.color.fnorm = imgdata.color.fnorm = 0.f;
+  return multip;
+}
 
-  for (size_t i = 0; i < imgdata.sizes.raw_height * imgdata.sizes.raw_width *
-                             libraw_internal_data.unpacker_data.tiff_samples;
-       ++i)
-  {
-    float val = MAX(data[i], 0.f);
-    raw_alloc[i] = (ushort)(val * multip);
-  }
-
+void LibRaw::set_int_rawdata(ushort *raw_alloc, int samples)
+{
   if (samples == 1)
   {
     imgdata.rawdata.raw_alloc = imgdata.rawdata.raw_image = raw_alloc;
@@ -543,13 +560,94 @@ void LibRaw::convertFloatToInt(float dmin /* =4096.f */,
     imgdata.rawdata.sizes.raw_pitch = imgdata.sizes.raw_pitch =
         imgdata.sizes.raw_width * 8;
   }
-  if(orawalloc)
-    free(orawalloc); // remove old allocation
   imgdata.rawdata.float_image = 0;
   imgdata.rawdata.float3_image = 0;
   imgdata.rawdata.float4_image = 0;
 }
 
+void LibRaw::convertFloatToInt(float dmin /* =4096.f */,
+                               float dmax /* =32767.f */,
+                               float dtarget /*= 16383.f */)
+{
+  int samples = 0;
+  float *data = 0;
+  void *orawalloc = imgdata.rawdata.raw_alloc;
+  if (imgdata.rawdata.float_image)
+  {
+    samples = 1;
+    data = imgdata.rawdata.float_image;
+  }
+  else if (imgdata.rawdata.float3_image)
+  {
+    samples = 3;
+    data = (float *)imgdata.rawdata.float3_image;
+  }
+  else if (imgdata.rawdata.float4_image)
+  {
+    samples = 4;
+    data = (float *)imgdata.rawdata.float4_image;
+  }
+  else
+    return;
+
+  float multip = fp_int_scale(dmin, dmax, dtarget);
+  size_t count = size_t(imgdata.sizes.raw_height) * imgdata.sizes.raw_width *
+                 libraw_internal_data.unpacker_data.tiff_samples;
+  ushort *raw_alloc;
+
+  if (orawalloc && (void *)data == orawalloc)
+  {
+    // In-place: converted block is written behind the read position
+    const size_t block = 4096;
+    ushort buf[block];
+    for (size_t start = 0; start < count; start += block)
+    {
+      size_t n = MIN(block, count - start);
+      for (size_t i = 0; i < n; i++)
+      {
+        float val = MAX(data[start + i], 0.f);
+        buf[i] = (ushort)(val * multip);
+      }
+      memcpy((ushort *)orawalloc + start, buf, n * sizeof(ushort));
+    }
+    raw_alloc = (ushort *)realloc(orawalloc, MAX(count, size_t(1)) * sizeof(ushort));
+    orawalloc = 0;
+  }
+  else
+  {
+    raw_alloc = (ushort *)malloc(count * sizeof(ushort));
+    for (size_t i = 0; i < count; ++i)
+    {
+      float val = MAX(data[i], 0.f);
+      raw_alloc[i] = (ushort)(val * multip);
+    }
+  }
+
+  set_int_rawdata(raw_alloc, samples);
+  if(orawalloc)
+    free(orawalloc); // remove old allocation
+}
+
+void LibRaw::convertHalfToInt(ushort *data, int samples)
+{
+  float multip = fp_int_scale(4096.f, 32767.f, 16383.f);
+  // 64k entries table is cheaper than per-sample conversion
+  ushort *lut = (ushort *)malloc(0x10000 * sizeof(ushort));
+  for (int h = 0; h < 0x10000; h++)
+  {
+    float val = MAX(halfToFloat(ushort(h)), 0.f);
+    lut[h] = (ushort)(val * multip);
+  }
+  INT64 count = INT64(imgdata.sizes.raw_height) * imgdata.sizes.raw_width * samples;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (INT64 i = 0; i < count; i++)
+    data[i] = lut[data[i]];
+  free(lut);
+  set_int_rawdata(data, samples);
+}
+
 static
 #if (defined(_MSC_VER) && !defined(__clang__))
 _forceinline
@@ -615,11 +713,18 @@ void LibRaw::uncompressed_fp_dng_load_raw()
 	if (allocsz > INT64(imgdata.rawparams.max_raw_memory_mb) * INT64(1024 * 1024))
 		throw LIBRAW_EXCEPTION_TOOBIG;
 
-    if (ifd->sample_format == 3)
-        float_raw_image = (float *)calloc(tiles.tileCnt * tiles.tileWidth * tiles.tileHeight *ifd->samples, sizeof(float));
-    else
+    if (ifd->sample_format != 3)
         throw LIBRAW_EXCEPTION_DECODE_RAW; // Only float supported
 
+    // 16-bit float data to be converted to integer: no expansion to float32
+    bool keephalf = bytesps == 2 && (imgdata.rawparams.options & LIBRAW_RAWOPTIONS_CONVERTFLOAT_TO_INT);
+    ushort *half_raw_image = 0;
+    ushort hmax = 0;
+    if (keephalf)
+        half_raw_image = (ushort *)calloc(size_t(imgdata.sizes.raw_width) * size_t(imgdata.sizes.raw_height) * ifd->samples, sizeof(ushort));
+    else
+        float_raw_image = (float *)calloc(tiles.tileCnt * tiles.tileWidth * tiles.tileHeight *ifd->samples, sizeof(float));
+
     bool difford = (libraw_internal_data.unpacker_data.order == 0x4949) == (ntohs(0x1234) == 0x1234);
     float max = 0.f;
 
@@ -639,6 +744,19 @@ void LibRaw::uncompressed_fp_dng_load_raw()
 
             for (size_t row = 0; row < rowsInTile; ++row) // do not process full tile if not needed
             {
+                if (keephalf)
+                {
+                    ushort *hdst = &half_raw_image[((y + row) * imgdata.sizes.raw_width + x) * ifd->samples];
+                    unsigned char *dst = fullrowbytes > int(inrowbytes) ? rowbuf.data() : (unsigned char *)hdst;
+                    libraw_internal_data.internal_data.input->read(dst, 1, fullrowbytes);
+                    if (difford)
+                        libraw_swab(dst, fullrowbytes);
+                    if (fullrowbytes > int(inrowbytes))
+                        memmove(hdst, dst, inrowbytes);
+                    // whole tile row (padding too), as expandFloats() below
+                    hmax = MAX(hmax, halfMax((ushort *)dst, tiles.tileWidth * ifd->samples));
+                    continue;
+                }
                 unsigned char *dst = fullrowbytes > int(inrowbytes) ? rowbuf.data(): // last tile in row, use buffer
                     (unsigned char *)&float_raw_image
                     [((y + row) * imgdata.sizes.raw_width + x) * ifd->samples];
@@ -661,6 +779,13 @@ void LibRaw::uncompressed_fp_dng_load_raw()
         }
     }
 
+    if (keephalf)
+    {
+        imgdata.color.fmaximum = halfToFloat(hmax);
+        convertHalfToInt(half_raw_image, ifd->samples);
+        return;
+    }
+
     imgdata.color.fmaximum = max;
 
     // setup outpuf fields
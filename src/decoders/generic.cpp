@@ -18,23 +18,79 @@
 
 #include "../../internal/dcraw_defs.h"
 
+namespace
+{
+/* Byte swap and shift of one row in one pass (plain loop, vectorized by
+   compiler); returns number of values with bits above 'bits' in [x0,x1) */
+template <bool swap>
+unsigned unpacked_fix_row(ushort *p, int n, unsigned shift, int bits, int x0,
+                          int x1)
+{
+  for (int col = 0; col < n; col++)
+  {
+    ushort v = p[col];
+    if (swap)
+      v = ushort(v >> 8 | v << 8);
+    p[col] = v >> shift;
+  }
+  unsigned errors = 0;
+  for (int col = x0; col < x1; col++)
+    errors += (p[col] >> bits) != 0;
+  return errors;
+}
+} // namespace
+
 void LibRaw::unpacked_load_raw()
 {
-  int row, col, bits = 0;
+  int row, rows, bits = 0;
   while (1 << ++bits < (int)maximum)
     ;
-  read_shorts(raw_image, raw_width * raw_height);
-  fseek(ifp, -2, SEEK_CUR); // avoid EOF error
-  if (maximum < 0xffff || load_flags)
-    for (row = 0; row < raw_height; row++)
+  /* Data is read by blocks of rows; byte swap, shift and range check of
+     each block are done in one pass over rows, in parallel. derror() calls
+     are made after all data is read, as in two-pass code. */
+  const bool swap = (order == 0x4949) == (ntohs(0x1234) == 0x1234);
+  const bool check = maximum < 0xffff || load_flags;
+  const unsigned shift = check ? load_flags : 0;
+  const int x0 = MIN(int(left_margin), int(raw_width));
+  const int x1 = MIN(int(left_margin) + int(width), int(raw_width));
+  const int blockrows =
+      MAX(1, MIN(int(raw_height), (16 << 20) / MAX(1, raw_width * 2)));
+  std::vector<unsigned> errors(check ? raw_height : 0);
+  bool shortread = false;
+  for (row = 0; row < raw_height; row += rows)
+  {
+    checkCancel();
+    rows = MIN(blockrows, raw_height - row);
+    ushort *block = raw_image + size_t(row) * raw_width;
+    const size_t count = size_t(rows) * raw_width;
+    if (!shortread && fread(block, 2, count, ifp) < int(count))
+      shortread = true;
+    if (swap || shift || check)
     {
-      checkCancel();
-      for (col = 0; col < raw_width; col++)
-        if ((RAW(row, col) >>= load_flags) >> bits &&
-            (unsigned)(row - top_margin) < height &&
-            (unsigned)(col - left_margin) < width)
-          derror();
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (int r = 0; r < rows; r++)
+      {
+        ushort *p = block + size_t(r) * raw_width;
+        const bool active = check && unsigned(row + r - top_margin) < height;
+        const unsigned e =
+            swap ? unpacked_fix_row<true>(p, raw_width, shift, bits, x0,
+                                          active ? x1 : x0)
+                 : unpacked_fix_row<false>(p, raw_width, shift, bits, x0,
+                                           active ? x1 : x0);
+        if (check)
+          errors[row + r] = e;
+      }
     }
+    publish_raw_rows(row + rows);
+  }
+  if (shortread)
+    derror();
+  fseek(ifp, -2, SEEK_CUR); // avoid EOF error
+  for (row = 0; check && row < raw_height; row++)
+    for (unsigned i = 0; i < errors[row]; i++)
+      derror();
 }
 
 void LibRaw::packed_load_raw()
@@ -81,6 +137,8 @@ void LibRaw::packed_load_raw()
         derror();
     }
     vbits -= rbits;
+    if (!(load_flags & 2))
+      publish_raw_rows(irow + 1);
   }
 }
 
@@ -96,6 +154,7 @@ void LibRaw::eight_bit_load_raw()
           derror();
       for (col = 0; col < raw_width; col++)
           RAW(row, col) = curve[pixel[col]];
+      publish_raw_rows(row + 1);
   }
   maximum = curve[0xff];
 }
@@ -252,31 +252,276 @@ void LibRaw::kodak_dc120_load_raw()
   }
   maximum = 0xff;
 }
+namespace
+{
+/* Compressed data read into memory once, bytes past the end are read as
+   EOF (-1), same as fgetc() */
+struct kodak_membuf_t
+{
+  std::vector<uchar> data;
+  INT64 start; /* file offset of data[0] */
+  int byte(INT64 pos) const
+  {
+    return pos >= 0 && pos < INT64(data.size()) ? data[size_t(pos)] : -1;
+  }
+};
+
+/* Upper bound of bytes read by kodak_65000_decode() for bsize values */
+INT64 kodak_65000_maxbytes(int bsize)
+{
+  bsize = (bsize + 3) & -4;
+  INT64 packed = bsize / 2 + 2 + INT64(bsize * 12 + 31) / 32 * 4;
+  INT64 plain = INT64(bsize + 7) / 8 * 12;
+  return MAX(packed, plain);
+}
+
+/* Bytes read by kodak_65000_decode(): known from 4-bit lengths header */
+INT64 kodak_65000_blockbytes(const kodak_membuf_t &b, INT64 pos, int bsize)
+{
+  uchar c, blen[768];
+  int i, bits = 0;
+  INT64 bytes;
+
+  bsize = (bsize + 3) & -4;
+  for (i = 0; i < bsize; i += 2)
+  {
+    c = uchar(b.byte(pos + i / 2));
+    if ((blen[i] = c & 15) > 12 || (blen[i + 1] = c >> 4) > 12)
+      return INT64(bsize + 7) / 8 * 12;
+  }
+  bytes = bsize / 2;
+  if ((bsize & 7) == 4)
+  {
+    bytes += 2;
+    bits = 16;
+  }
+  for (i = 0; i < bsize; i++)
+  {
+    if (bits < blen[i])
+    {
+      bytes += 4;
+      bits += 32;
+    }
+    bits -= blen[i];
+  }
+  return bytes;
+}
+
+/* kodak_65000_decode() over memory buffer, err is incremented on data end
+   (once per 6 values, as read_shorts() in kodak_65000_decode() does) */
+int kodak_65000_decode_buf(const kodak_membuf_t &b, INT64 pos, short *out,
+                           int bsize, ushort byte_order, int &err)
+{
+  uchar c, blen[768];
+  ushort raw[6];
+  INT64 bitbuf = 0, p = pos;
+  int bits = 0, i, j, len, diff;
+
+  bsize = (bsize + 3) & -4;
+  for (i = 0; i < bsize; i += 2)
+  {
+    c = uchar(b.byte(p++));
+    if ((blen[i] = c & 15) > 12 || (blen[i + 1] = c >> 4) > 12)
+    {
+      p = pos;
+      for (i = 0; i < bsize; i += 8)
+      {
+        int short_read = 0;
+        for (j = 0; j < 6; j++, p += 2)
+        {
+          int b0 = b.byte(p), b1 = b.byte(p + 1);
+          if (b0 < 0 || b1 < 0)
+          {
+            short_read = 1;
+            b0 = b1 = 0;
+          }
+          raw[j] = byte_order == 0x4949 ? b0 | b1 << 8 : b0 << 8 | b1;
+        }
+        err += short_read;
+        out[i] = raw[0] >> 12 << 8 | raw[2] >> 12 << 4 | raw[4] >> 12;
+        out[i + 1] = raw[1] >> 12 << 8 | raw[3] >> 12 << 4 | raw[5] >> 12;
+        for (j = 0; j < 6; j++)
+          out[i + 2 + j] = raw[j] & 0xfff;
+      }
+      return 1;
+    }
+  }
+  if ((bsize & 7) == 4)
+  {
+    bitbuf = b.byte(p++) << 8;
+    bitbuf += b.byte(p++);
+    bits = 16;
+  }
+  for (i = 0; i < bsize; i++)
+  {
+    len = blen[i];
+    if (bits < len)
+    {
+      for (j = 0; j < 32; j += 8)
+        bitbuf += (INT64)b.byte(p++) << (bits + (j ^ 8));
+      bits += 32;
+    }
+    diff = bitbuf & (0xffff >> (16 - len));
+    bitbuf >>= len;
+    bits -= len;
+    if (len > 0 && (diff & (1 << (len - 1))) == 0)
+      diff -= (1 << len) - 1;
+    out[i] = diff;
+  }
+  return 0;
+}
+
+/*
+   Reads data for nrows rows of blocks (blockw*mult values each, last block
+   in row is shorter) from current position and finds each block offset,
+   so blocks may be decoded in any order. Returns bytes used.
+ */
+INT64 kodak_65000_index(LibRaw_abstract_datastream *in, int nrows, int w,
+                        int blockw, int mult, kodak_membuf_t &b,
+                        std::vector<INT64> &offsets)
+{
+  int nb = (w + blockw - 1) / blockw;
+  INT64 maxbytes = 0, pos = 0;
+  for (int col = 0; col < w; col += blockw)
+    maxbytes += kodak_65000_maxbytes(MIN(blockw, w - col) * mult);
+  maxbytes *= nrows;
+
+  b.start = in->tell();
+  b.data.resize(size_t(MAX(INT64(0), MIN(maxbytes, in->size() - b.start))));
+  if (b.data.size())
+    b.data.resize(in->read(b.data.data(), 1, b.data.size()));
+
+  offsets.resize(size_t(nrows) * nb + 1);
+  for (int row = 0, k = 0; row < nrows; row++)
+    for (int col = 0; col < w; col += blockw, k++)
+    {
+      offsets[k] = pos;
+      pos += kodak_65000_blockbytes(b, pos, MIN(blockw, w - col) * mult);
+    }
+  offsets[size_t(nrows) * nb] = pos;
+  return pos;
+}
+
+/*
+   Stream position of first error in sequential decoding order: end of
+   first bad block, so derror() there throws at EOF only if sequential
+   decoder would do the same. -1 if no errors.
+   errcount (per row/pair) is added to data_error after this single
+   derror() call, so error count is same as in sequential decoder.
+ */
+INT64 kodak_65000_errpos(const kodak_membuf_t &b,
+                         const std::vector<INT64> &offsets,
+                         const std::vector<int> &errblock)
+{
+  for (size_t i = 0; i < errblock.size(); i++)
+    if (errblock[i] >= 0)
+      return b.start + offsets[errblock[i] + 1];
+  return -1;
+}
+
+int kodak_errcount(const std::vector<int> &errcount)
+{
+  INT64 sum = 0;
+  for (size_t i = 0; i < errcount.size(); i++)
+    sum += errcount[i];
+  return int(MIN(sum, INT64(0x7fffffff)));
+}
+
+/* getbithuff()/ljpeg_diff() over memory buffer */
+struct kodak_bits_t
+{
+  const uchar *start, *p, *end;
+  unsigned bitbuf;
+  int vbits, reset, zero_ff;
+  INT64 errpos; /* bytes consumed at first error, -1 if none */
+  int errors;   /* derror() calls in sequential decoder */
+
+  kodak_bits_t(const uchar *data, size_t size, int zero_after_ff_)
+      : start(data), p(data), end(data + size), bitbuf(0), vbits(0),
+        reset(0), zero_ff(zero_after_ff_), errpos(-1), errors(0)
+  {
+  }
+  INT64 pos() const { return p - start; }
+  void error()
+  {
+    if (errpos < 0)
+      errpos = pos();
+    errors++;
+  }
+  unsigned get(int nbits, const ushort *huff)
+  {
+    unsigned c;
+    if (nbits > 25 || nbits == 0 || vbits < 0)
+      return 0;
+    while (!reset && vbits < nbits && p < end)
+    {
+      c = *p++;
+      if ((reset = zero_ff && c == 0xff && (p >= end || *p++)))
+        break;
+      bitbuf = (bitbuf << 8) + (uchar)c;
+      vbits += 8;
+    }
+    c = vbits == 0 ? 0 : bitbuf << (32 - vbits) >> (32 - nbits);
+    if (huff)
+    {
+      vbits -= huff[c] >> 8;
+      c = (uchar)huff[c];
+    }
+    else
+      vbits -= nbits;
+    if (vbits < 0)
+      error();
+    return c;
+  }
+  int diff(const ushort *huff, int len16)
+  {
+    int len = get(*huff, huff + 1), d;
+    if (len == 16 && len16)
+      return -32768;
+    d = get(len, 0);
+    if ((d & (1 << (len - 1))) == 0)
+      d -= (1 << len) - 1;
+    return d;
+  }
+};
+} // namespace
+
 void LibRaw::kodak_c330_load_raw()
 {
   if (!image)
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
-  int row, col, y, cb, cr, rgb[3], c;
+  /* 4 zero bytes after each row: last Cb/Cr pair may be read past it */
+  const size_t rowbytes = size_t(raw_width) * 2 + 4;
 
-  std::vector<uchar> pixel(raw_width*2 + 4);
+  /* read sequentially, convert rows in parallel */
+  std::vector<uchar> pixel(rowbytes * height);
+  for (int row = 0; row < height; row++)
+  {
+    checkCancel();
+    if (fread(pixel.data() + rowbytes * row, raw_width, 2, ifp) < 2)
+      derror();
+    if (load_flags && (row & 31) == 31)
+      fseek(ifp, raw_width * 32, SEEK_CUR);
+  }
 
-  for (row = 0; row < height; row++)
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int row = 0; row < height; row++)
   {
-      checkCancel();
-      if (fread(pixel.data(), raw_width, 2, ifp) < 2)
-          derror();
-      if (load_flags && (row & 31) == 31)
-          fseek(ifp, raw_width * 32, SEEK_CUR);
-      for (col = 0; col < width; col++)
-      {
-          y = pixel[col * 2];
-          cb = pixel[(col * 2 & -4) | 1] - 128;
-          cr = pixel[(col * 2 & -4) | 3] - 128;
-          rgb[1] = y - ((cb + cr + 2) >> 2);
-          rgb[2] = rgb[1] + cb;
-          rgb[0] = rgb[1] + cr;
-          FORC3 image[row * width + col][c] = curve[LIM(rgb[c], 0, 255)];
-      }
+    const uchar *px = pixel.data() + rowbytes * row;
+    ushort(*ip)[4] = image + size_t(row) * width;
+    int y, cb, cr, rgb[3], c;
+    for (int col = 0; col < width; col++)
+    {
+      y = px[col * 2];
+      cb = px[(col * 2 & -4) | 1] - 128;
+      cr = px[(col * 2 & -4) | 3] - 128;
+      rgb[1] = y - ((cb + cr + 2) >> 2);
+      rgb[2] = rgb[1] + cb;
+      rgb[0] = rgb[1] + cr;
+      FORC3 ip[col][c] = curve[LIM(rgb[c], 0, 255)];
+    }
   }
   maximum = curve[0xff];
 }
@@ -285,25 +530,35 @@ void LibRaw::kodak_c603_load_raw()
 {
   if (!image)
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
-  int row, col, y, cb, cr, rgb[3], c;
+  const size_t pairbytes = size_t(raw_width) * 3;
 
-  std::vector<uchar> pixel(raw_width * 3);
-  for (row = 0; row < height; row++)
+  /* one Y/Y/CbCr block per two rows */
+  std::vector<uchar> pixel(pairbytes * ((height + 1) / 2));
+  for (int row = 0; row < height; row += 2)
   {
-      checkCancel();
-      if (~row & 1)
-          if (fread(pixel.data(), raw_width, 3, ifp) < 3)
-              derror();
-      for (col = 0; col < width; col++)
-      {
-          y = pixel[width * 2 * (row & 1) + col];
-          cb = pixel[width + (col & -2)] - 128;
-          cr = pixel[width + (col & -2) + 1] - 128;
-          rgb[1] = y - ((cb + cr + 2) >> 2);
-          rgb[2] = rgb[1] + cb;
-          rgb[0] = rgb[1] + cr;
-          FORC3 image[row * width + col][c] = curve[LIM(rgb[c], 0, 255)];
-      }
+    checkCancel();
+    if (fread(pixel.data() + pairbytes * (row / 2), raw_width, 3, ifp) < 3)
+      derror();
+  }
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int row = 0; row < height; row++)
+  {
+    const uchar *px = pixel.data() + pairbytes * (row / 2);
+    ushort(*ip)[4] = image + size_t(row) * width;
+    int y, cb, cr, rgb[3], c;
+    for (int col = 0; col < width; col++)
+    {
+      y = px[width * 2 * (row & 1) + col];
+      cb = px[width + (col & -2)] - 128;
+      cr = px[width + (col & -2) + 1] - 128;
+      rgb[1] = y - ((cb + cr + 2) >> 2);
+      rgb[2] = rgb[1] + cb;
+      rgb[0] = rgb[1] + cr;
+      FORC3 ip[col][c] = curve[LIM(rgb[c], 0, 255)];
+    }
   }
   maximum = curve[0xff];
 }
@@ -316,26 +571,50 @@ void LibRaw::kodak_262_load_raw()
       {0, 3, 1, 1, 1, 1, 1, 2, 0, 0, 0, 0, 0,
        0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9}};
   ushort *huff[2];
-  int *strip, ns, c, row, col, chess, pi = 0, pi1, pi2, pred, val;
+  int c, ns, strips;
 
-  FORC(2) huff[c] = make_decoder(kodak_tree[c]);
   ns = (raw_height + 63) >> 5;
-  std::vector<uchar> pixel(raw_width * 32 + ns * 4);
-  strip = (int *)(pixel.data() + raw_width * 32);
+  strips = (raw_height + 31) >> 5;
+  std::vector<int> strip(ns);
   order = 0x4d4d;
   FORC(ns) strip[c] = get4();
-  try
+
+  /* strips of 32 rows are independent: read data once, decode in parallel.
+     Each strip may use up to 8 bytes per pixel (Huffman code + diff) */
+  const INT64 stripmax = INT64(raw_width) * 32 * 8 + 8;
+  INT64 lo = strip[0], hi = strip[0];
+  for (c = 0; c < strips; c++)
   {
-    for (row = 0; row < raw_height; row++)
-    {
-      checkCancel();
-      if ((row & 31) == 0)
-      {
-        fseek(ifp, strip[row >> 5], SEEK_SET);
-        getbits(-1);
-        pi = 0;
-      }
-      for (col = 0; col < raw_width; col++)
+    lo = MIN(lo, INT64(strip[c]));
+    hi = MAX(hi, INT64(strip[c]));
+  }
+  hi = MIN(hi + stripmax, ifp->size());
+  if (lo < 0 || hi - lo > INT64(raw_width) * raw_height * 8 + stripmax)
+    throw LIBRAW_EXCEPTION_IO_CORRUPT;
+  std::vector<uchar> data(size_t(MAX(hi - lo, INT64(0))));
+  fseek(ifp, lo, SEEK_SET);
+  if (data.size())
+    data.resize(fread(data.data(), 1, data.size(), ifp));
+  checkCancel();
+
+  FORC(2) huff[c] = make_decoder(kodak_tree[c]);
+  const int len16 = !dng_version || dng_version >= 0x1010000;
+  const int zero_ff = zero_after_ff;
+  /* per strip: bytes consumed at first error and at strip end */
+  std::vector<INT64> errpos(strips, -1), endpos(strips, 0);
+  std::vector<int> errcount(strips, 0);
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int s = 0; s < strips; s++)
+  {
+    std::vector<uchar> pixel(raw_width * 32);
+    size_t soff = size_t(strip[s] - lo);
+    kodak_bits_t bits(data.data() + MIN(soff, data.size()),
+                      soff < data.size() ? data.size() - soff : 0, zero_ff);
+    int pi = 0, pi1, pi2, pred, val, chess;
+    for (int row = s * 32; row < raw_height && row < s * 32 + 32; row++)
+      for (int col = 0; col < raw_width; col++)
       {
         chess = (row + col) & 1;
         pi1 = chess ? pi - 2 : pi - raw_width - 1;
@@ -349,20 +628,29 @@ void LibRaw::kodak_262_load_raw()
         if (pi1 < 0 && col > 1)
           pi1 = pi2 = pi - 2;
         pred = (pi1 < 0) ? 0 : (pixel[pi1] + pixel[pi2]) >> 1;
-        pixel[pi] = val = pred + ljpeg_diff(huff[chess]);
+        pixel[pi] = val = pred + bits.diff(huff[chess], len16);
         if (val >> 8)
-          derror();
-        val = curve[pixel[pi++]];
-        RAW(row, col) = val;
+          bits.error();
+        RAW(row, col) = curve[pixel[pi++]];
       }
-    }
-  }
-  catch (...)
-  {
-      FORC(2) free(huff[c]);
-      throw;
+    errpos[s] = bits.errpos;
+    endpos[s] = bits.pos();
+    errcount[s] = bits.errors;
   }
   FORC(2) free(huff[c]);
+
+  /* stream state as after sequential decoding: first error is reported at
+     its position, then the stream is left after the last strip */
+  for (c = 0; c < strips; c++)
+    if (errpos[c] >= 0)
+    {
+      fseek(ifp, strip[c] + errpos[c], SEEK_SET);
+      derror(); // data callback called once
+      data_error += kodak_errcount(errcount) - 1;
+      break;
+    }
+  if (strips > 0)
+    fseek(ifp, strip[strips - 1] + endpos[strips - 1], SEEK_SET);
 }
 
 int LibRaw::kodak_65000_decode(short *out, int bsize)
@@ -419,98 +707,189 @@ int LibRaw::kodak_65000_decode(short *out, int bsize)
 
 void LibRaw::kodak_65000_load_raw()
 {
-  short buf[272]; /* 264 looks enough */
-  int row, col, len, pred[2], ret, i;
-
-  for (row = 0; row < height; row++)
+  kodak_membuf_t b;
+  std::vector<INT64> offsets;
+  const int nb = (width + 255) / 256;
+  const ushort byte_order = order;
+  std::vector<int> errblock(height, -1), errcount(height, 0);
+
+  checkCancel();
+  INT64 used = kodak_65000_index(ifp, height, width, 256, 1, b, offsets);
+  checkCancel();
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int row = 0; row < height; row++)
   {
-    checkCancel();
-    for (col = 0; col < width; col += 256)
+    short buf[272]; /* 264 looks enough */
+    int pred[2];
+    for (int col = 0, k = row * nb; col < width; col += 256, k++)
     {
       pred[0] = pred[1] = 0;
-      len = MIN(256, width - col);
-      ret = kodak_65000_decode(buf, len);
-      for (i = 0; i < len; i++)
+      int len = MIN(256, width - col), errs = 0;
+      int ret = kodak_65000_decode_buf(b, offsets[k], buf, len, byte_order,
+                                       errs);
+      for (int i = 0; i < len; i++)
       {
         int idx = ret ? buf[i] : (pred[i & 1] += buf[i]);
         if (idx >= 0 && idx < 0xffff)
         {
           if ((RAW(row, col + i) = curve[idx]) >> 12)
-            derror();
+            errs++;
         }
         else
-          derror();
+          errs++;
       }
+      if (errs && errblock[row] < 0)
+        errblock[row] = k;
+      errcount[row] += errs;
     }
   }
+  INT64 errpos = kodak_65000_errpos(b, offsets, errblock);
+  if (errpos >= 0)
+  {
+    fseek(ifp, errpos, SEEK_SET);
+    derror(); // data callback called once
+    data_error += kodak_errcount(errcount) - 1;
+  }
+  fseek(ifp, b.start + used, SEEK_SET);
 }
 
 void LibRaw::kodak_ycbcr_load_raw()
 {
   if (!image)
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
-  short buf[384], *bp;
-  int row, col, len, c, i, j, k, y[2][2], cb, cr, rgb[3];
-  ushort *ip;
-
-  unsigned int bits =
+  kodak_membuf_t b;
+  std::vector<INT64> offsets;
+  const int pairs = (height + 1) / 2, nb = (width + 127) / 128;
+  const int pixels = int(width) * int(height);
+  const ushort byte_order = order;
+  const unsigned int bits =
       (load_flags && load_flags > 9 && load_flags < 17) ? load_flags : 10;
-  const int pixels = int(width)*int(height);
-  for (row = 0; row < height; row += 2)
+  std::vector<int> errblock(pairs, -1), errcount(pairs, 0);
+
+  checkCancel();
+  INT64 used = kodak_65000_index(ifp, pairs, width, 128, 3, b, offsets);
+  checkCancel();
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int pair = 0; pair < pairs; pair++)
   {
-    checkCancel();
-    for (col = 0; col < width; col += 128)
+    short buf[384];
+    int y[2][130], rgb[64][3];
+    const int row = pair * 2;
+    for (int col = 0, k = pair * nb; col < width; col += 128, k++)
     {
-      len = MIN(128, width - col);
-      kodak_65000_decode(buf, len * 3);
-      y[0][1] = y[1][1] = cb = cr = 0;
-      for (bp = buf, i = 0; i < len; i += 2, bp += 2)
+      int len = MIN(128, width - col), errs = 0;
+      kodak_65000_decode_buf(b, offsets[k], buf, len * 3, byte_order, errs);
+
+      /* predictors: two Y per row and one Cb/Cr per 2x2 cell */
+      int y0 = 0, y1 = 0, cb = 0, cr = 0;
+      const short *bp = buf;
+      for (int i = 0; i < len; i += 2, bp += 6)
       {
         cb += bp[4];
         cr += bp[5];
-        rgb[1] = -((cb + cr + 2) >> 2);
-        rgb[2] = rgb[1] + cb;
-        rgb[0] = rgb[1] + cr;
-        for (j = 0; j < 2; j++)
-          for (k = 0; k < 2; k++)
+        rgb[i >> 1][1] = -((cb + cr + 2) >> 2);
+        rgb[i >> 1][2] = rgb[i >> 1][1] + cb;
+        rgb[i >> 1][0] = rgb[i >> 1][1] + cr;
+        y[0][i] = y0 + bp[0];
+        y[0][i + 1] = y0 = y[0][i] + bp[1];
+        y[1][i] = y1 + bp[2];
+        y[1][i + 1] = y1 = y[1][i] + bp[3];
+        errs += (y[0][i] >> bits) != 0;
+        errs += (y[0][i + 1] >> bits) != 0;
+        errs += (y[1][i] >> bits) != 0;
+        errs += (y[1][i + 1] >> bits) != 0;
+      }
+      if (errs && errblock[pair] < 0)
+        errblock[pair] = k;
+      errcount[pair] += errs;
+
+      /* YCbCr to RGB. Odd last block writes one extra pixel (next row
+         start): for row+1 it is overwritten by next row pair, for row it
+         replaces first pixel of row+1, so row+1 goes first */
+      int xend = (len + 1) & ~1;
+      for (int j = 1; j >= 0; j--)
+      {
+        int base = (row + j) * width + col;
+        if (j == 1 && xend > len)
+          xend = len;
+        for (int x = 0; x < xend; x++)
+        {
+          int indx = base + x;
+          if (indx >= 0 && indx < pixels)
           {
-            if ((y[j][k] = y[j][k ^ 1] + *bp++) >> bits)
-              derror();
-            int indx = (row + j) * width + col + i + k;
-            if(indx>=0 && indx < pixels)
-            {
-                ip = image[indx];
-                FORC3 ip[c] = curve[LIM(y[j][k] + rgb[c], 0, 0xfff)];
-            }
+            ushort *ip = image[indx];
+            const int *c3 = rgb[x >> 1];
+            ip[0] = curve[LIM(y[j][x] + c3[0], 0, 0xfff)];
+            ip[1] = curve[LIM(y[j][x] + c3[1], 0, 0xfff)];
+            ip[2] = curve[LIM(y[j][x] + c3[2], 0, 0xfff)];
           }
+        }
+        xend = (len + 1) & ~1;
       }
     }
   }
+  INT64 errpos = kodak_65000_errpos(b, offsets, errblock);
+  if (errpos >= 0)
+  {
+    fseek(ifp, errpos, SEEK_SET);
+    derror(); // data callback called once
+    data_error += kodak_errcount(errcount) - 1;
+  }
+  fseek(ifp, b.start + used, SEEK_SET);
 }
 
 void LibRaw::kodak_rgb_load_raw()
 {
   if (!image)
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
-  short buf[768], *bp;
-  int row, col, len, c, i, rgb[3], ret;
-  ushort *ip = image[0];
-
-  for (row = 0; row < height; row++)
+  kodak_membuf_t b;
+  std::vector<INT64> offsets;
+  const int nb = (width + 255) / 256;
+  const ushort byte_order = order;
+  std::vector<int> errblock(height, -1), errcount(height, 0);
+
+  checkCancel();
+  INT64 used = kodak_65000_index(ifp, height, width, 256, 3, b, offsets);
+  checkCancel();
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int row = 0; row < height; row++)
   {
-    checkCancel();
-    for (col = 0; col < width; col += 256)
+    short buf[768], *bp;
+    int rgb[3], c;
+    for (int col = 0, k = row * nb; col < width; col += 256, k++)
     {
-      len = MIN(256, width - col);
-      ret = kodak_65000_decode(buf, len * 3);
+      int len = MIN(256, width - col), errs = 0;
+      int ret = kodak_65000_decode_buf(b, offsets[k], buf, len * 3,
+                                       byte_order, errs);
+      ushort *ip = image[size_t(row) * width + col];
       memset(rgb, 0, sizeof rgb);
-      for (bp = buf, i = 0; i < len; i++, ip += 4)
+      for (bp = buf; bp < buf + len * 3; ip += 4)
         if (load_flags == 12)
           FORC3 ip[c] = ret ? (*bp++) : (rgb[c] += *bp++);
         else
-          FORC3 if ((ip[c] = ret ? (*bp++) : (rgb[c] += *bp++)) >> 12) derror();
+          FORC3 if ((ip[c] = ret ? (*bp++) : (rgb[c] += *bp++)) >> 12) errs++;
+      if (errs && errblock[row] < 0)
+        errblock[row] = k;
+      errcount[row] += errs;
     }
   }
+  INT64 errpos = kodak_65000_errpos(b, offsets, errblock);
+  if (errpos >= 0)
+  {
+    fseek(ifp, errpos, SEEK_SET);
+    derror(); // data callback called once
+    data_error += kodak_errcount(errcount) - 1;
+  }
+  fseek(ifp, b.start + used, SEEK_SET);
 }
 
 void LibRaw::kodak_thumb_load_raw()
@@ -706,6 +706,7 @@ void LibRaw::phase_one_load_raw_c()
       else
         for (col = 0; col < raw_width; col++)
           RAW(row, col) = pixel[col] << 2;
+      publish_raw_rows(row + 1);
     }
   }
   catch (...)
@@ -717,6 +718,202 @@ void LibRaw::phase_one_load_raw_c()
   maximum = 0xfffc - ph1.t_black;
 }
 
+namespace
+{
+/* ph1_bithuff() over in-memory data (little-endian 32-bit words); bytes
+   past EOF are 0xff as get4() returns. Reading past the loaded part when
+   file has more data sets overrun. */
+struct hb_bits_t
+{
+  const uchar *data;
+  INT64 size, pos;
+  UINT64 bitbuf;
+  int vbits;
+  bool ateof, overrun;
+
+  unsigned get(int nbits, const ushort *huff)
+  {
+    if (nbits == 0)
+      return 0;
+    if (vbits < nbits)
+    {
+      uchar s[4] = {0xff, 0xff, 0xff, 0xff};
+      if (pos + 4 <= size)
+        memcpy(s, data + pos, 4);
+      else
+      {
+        if (pos < size)
+          memcpy(s, data + pos, size_t(size - pos));
+        if (!ateof)
+          overrun = true;
+      }
+      pos += 4;
+      bitbuf = bitbuf << 32 | unsigned(s[0] | s[1] << 8 | s[2] << 16 | s[3] << 24);
+      vbits += 32;
+    }
+    unsigned c = unsigned((bitbuf << (64 - vbits) >> (64 - nbits)) & 0xffffffff);
+    if (huff)
+    {
+      vbits -= huff[c] >> 8;
+      return (uchar)huff[c];
+    }
+    vbits -= nbits;
+    return c;
+  }
+};
+
+/* Differences of one row, same order as diff[] of sequential decoder:
+   2 * samples values per column pair. Without decode bits are skipped. */
+template <bool decode>
+void hb_row_diffs(hb_bits_t &br, const ushort *huff, int rwidth, int samples,
+                  int *out)
+{
+  int len[2];
+  for (int col = 0; col < rwidth; col += 2)
+    for (int s = 0; s < samples * 2; s += 2)
+    {
+      len[0] = br.get(huff[0], huff + 1);
+      len[1] = br.get(huff[0], huff + 1);
+      for (int c = 0; c < 2; c++)
+      {
+        int diff = br.get(len[c], 0);
+        if (!decode)
+          continue;
+        if (len[c] > 0 && (diff & (1 << (len[c] - 1))) == 0)
+          diff -= (1 << len[c]) - 1;
+        if (diff == 65535)
+          diff = -32768;
+        *out++ = diff;
+      }
+    }
+}
+} // namespace
+
+/*
+   Compressed data is read into memory. If OpenMP is enabled, a scan pass
+   records bit reader state at each row start, then differences of row
+   windows are decoded in parallel. Rows are rebuilt in parallel, except
+   predictor 11 (uses rows above) which is rebuilt in order.
+   Returns 0 if data can't be handled this way, sequential decoder is used
+   then.
+ */
+int LibRaw::hasselblad_decode_rows(struct jhead *jh, int shot, int sh)
+{
+  const int samples = tiff_samples;
+  if ((raw_width & 1) || samples < 1 || samples > 6 || !raw_height)
+    return 0;
+  const INT64 start = ftell(ifp);
+  const INT64 avail = libraw_internal_data.internal_data.input->size() - start;
+  /* 16-bit code and 16-bit value per pixel and sample at most */
+  const INT64 bound = INT64(raw_width) * raw_height * samples * 4 + 64;
+  if (avail <= 0)
+    return 0;
+  std::vector<uchar> data(size_t(MIN(avail, bound)));
+  const INT64 got = fread(data.data(), 1, data.size(), ifp);
+  hb_bits_t br = {data.data(), got, 0, 0, 0, got < INT64(data.size()) || bound >= avail,
+                  false};
+
+  const ushort *huff = jh->huff[0];
+  const size_t rowlen = size_t(raw_width) * samples;
+  const int wrows =
+      int(MAX(size_t(1), MIN(size_t(raw_height), (size_t(4) << 20) / rowlen)));
+  bool scan = false;
+#ifdef LIBRAW_USE_OPENMP
+  scan = omp_get_max_threads() > 1;
+#endif
+  std::vector<hb_bits_t> state;
+  if (scan)
+  {
+    state.resize(raw_height);
+    for (int row = 0; row < raw_height; row++)
+    {
+      if (!(row & 255))
+        checkCancel();
+      state[row] = br;
+      hb_row_diffs<false>(br, huff, raw_width, samples, 0);
+    }
+    if (br.overrun)
+      return 0;
+  }
+
+  std::vector<int> diffs(rowlen * wrows);
+  std::vector<int> back(size_t(raw_width) * 3);
+  const int psv = jh->psv;
+  for (int r0 = 0; r0 < raw_height; r0 += wrows)
+  {
+    checkCancel();
+    const int nrows = MIN(wrows, raw_height - r0);
+    if (scan)
+    {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+      for (int r = 0; r < nrows; r++)
+      {
+        hb_bits_t rbr = state[r0 + r];
+        hb_row_diffs<true>(rbr, huff, raw_width, samples, &diffs[rowlen * r]);
+      }
+    }
+    else
+    {
+      for (int r = 0; r < nrows; r++)
+        hb_row_diffs<true>(br, huff, raw_width, samples, &diffs[rowlen * r]);
+      if (br.overrun)
+        return 0;
+    }
+
+    /* predictor 11 uses row - 2 values: kept in 3-row ring */
+    const int band = psv == 11 ? nrows : 1;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel if (psv != 11)
+#endif
+    {
+      std::vector<int> own(psv == 11 ? 0 : raw_width);
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(static)
+#endif
+      for (int rb = 0; rb < nrows; rb += band)
+        for (int r = rb; r < rb + band; r++)
+        {
+          const int row = r0 + r;
+          int *back2 = psv == 11 ? &back[size_t(row % 3) * raw_width] : own.data();
+          const int *back0 = &back[size_t((row + 1) % 3) * raw_width];
+          const int *d = &diffs[rowlen * r];
+          for (int col = 0; col < raw_width; col += 2, d += samples * 2)
+            for (int s = col; s < col + 2; s++)
+            {
+              int pred = 0x8000 + load_flags;
+              if (col)
+                pred = back2[s - 2];
+              if (col && row > 1 && psv == 11)
+                pred += back0[s] / 2 - back0[s - 2] / 2;
+              const int f = (row & 1) * 3 ^ ((col + s) & 1);
+              for (int c = 0; c < samples; c++)
+              {
+                pred += d[(s & 1) * samples + c];
+                const unsigned upix = pred >> sh & 0xffff;
+                if (raw_image && c == shot)
+                  RAW(row, s) = upix;
+                if (image)
+                {
+                  const unsigned urow = row - top_margin + (c & 1);
+                  const unsigned ucol = col - left_margin - ((c >> 1) & 1);
+                  if (urow < height && ucol < width)
+                  {
+                    ushort *ip = &image[urow * width + ucol][f];
+                    *ip = c < 4 ? upix : (*ip + upix) >> 1;
+                  }
+                }
+              }
+              back2[s] = pred;
+            }
+        }
+    }
+  }
+  fseek(ifp, start + MIN(br.pos, got), SEEK_SET);
+  return 1;
+}
+
 void LibRaw::hasselblad_load_raw()
 {
   struct jhead jh;
@@ -736,7 +933,11 @@ void LibRaw::hasselblad_load_raw()
     FORC3 back[c] = back[4] + c * raw_width;
     cblack[6] >>= sh = tiff_samples > 1;
     shot = LIM(shot_select, 1, tiff_samples) - 1;
-    for (row = 0; row < raw_height; row++)
+    INT64 save = ftell(ifp);
+    int done = hasselblad_decode_rows(&jh, shot, sh);
+    if (!done)
+      fseek(ifp, save, SEEK_SET);
+    for (row = 0; !done && row < raw_height; row++)
     {
       checkCancel();
       FORC4 back[(c + 3) & 3] = back[c];
@@ -804,18 +1005,21 @@ void LibRaw::hasselblad_load_raw()
 void LibRaw::leaf_hdr_load_raw()
 {
   ushort *pixel = 0;
-  unsigned tile = 0, r, c, row, col;
+  unsigned tile = 0, r, c, row, col, rows;
+  /* rows of a tile are read by blocks */
+  const unsigned blockrows =
+      MAX(1u, (8u << 20) / MAX(1u, unsigned(raw_width) * 2u));
 
   if (!filters || !raw_image)
   {
     if (!image)
       throw LIBRAW_EXCEPTION_IO_CORRUPT;
-    pixel = (ushort *)calloc(raw_width, sizeof *pixel);
+    pixel = (ushort *)calloc(size_t(raw_width) * blockrows, sizeof *pixel);
   }
   try
   {
     FORC(tiff_samples)
-    for (r = 0; r < raw_height; r++)
+    for (r = 0; r < raw_height; r += rows)
     {
       checkCancel();
       if (r % tile_length == 0)
@@ -823,14 +1027,23 @@ void LibRaw::leaf_hdr_load_raw()
         fseek(ifp, data_offset + 4 * tile++, SEEK_SET);
         fseek(ifp, get4(), SEEK_SET);
       }
+      rows = MIN(blockrows, tile_length - r % tile_length);
+      rows = MIN(rows, raw_height - r);
       if (filters && c != shot_select)
         continue;
-      if (filters && raw_image)
-        pixel = raw_image + r * raw_width;
-      read_shorts(pixel, raw_width);
-      if (!filters && image && (row = r - top_margin) < height)
-        for (col = 0; col < width && col + left_margin < raw_width; col++)
-          image[row * width + col][c] = pixel[col + left_margin];
+      ushort *dst = filters && raw_image ? raw_image + r * raw_width : pixel;
+      read_shorts_rows(dst, rows, raw_width);
+      if (!filters && image)
+      {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static) private(row, col)
+#endif
+        for (int k = 0; k < int(rows); k++)
+          if ((row = r + k - top_margin) < height)
+            for (col = 0; col < width && col + left_margin < raw_width; col++)
+              image[row * width + col][c] =
+                  dst[size_t(k) * raw_width + col + left_margin];
+      }
     }
   }
   catch (...)
@@ -880,7 +1093,7 @@ for Fuji DBP for GX680, aka DX-2000
 void LibRaw::sinar_4shot_load_raw()
 {
   ushort *pixel;
-  unsigned shot, row, col, r, c;
+  unsigned shot, r, c;
 
   if (raw_image)
   {
@@ -892,27 +1105,36 @@ void LibRaw::sinar_4shot_load_raw()
   }
   if (!image)
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
-  pixel = (ushort *)calloc(raw_width, sizeof *pixel);
+  size_t plane_sz = size_t(raw_width) * size_t(raw_height);
+  /* all 4 shots are kept until merge */
+  if (INT64(plane_sz) * 4 * INT64(sizeof *pixel) >
+      INT64(imgdata.rawparams.max_raw_memory_mb) * INT64(1024 * 1024))
+    throw LIBRAW_EXCEPTION_TOOBIG;
+  pixel = (ushort *)calloc(plane_sz * 4, sizeof *pixel);
   try
   {
+    libraw_multishot_t ms;
+    memset(&ms, 0, sizeof(ms));
+    ms.src_width = raw_width;
+    ms.src_height = raw_height;
+    ms.dest = image;
+    ms.dest_width = width;
+    ms.dest_height = height;
     for (shot = 0; shot < 4; shot++)
     {
       checkCancel();
       fseek(ifp, data_offset + shot * 4, SEEK_SET);
       fseek(ifp, get4(), SEEK_SET);
-      for (row = 0; row < raw_height; row++)
-      {
-        read_shorts(pixel, raw_width);
-        if ((r = row - top_margin - (shot >> 1 & 1)) >= height)
-          continue;
-        for (col = 0; col < raw_width; col++)
-        {
-          if ((c = col - left_margin - (shot & 1)) >= width)
-            continue;
-          image[r * width + c][(row & 1) * 3 ^ (~col & 1)] = pixel[col];
-        }
-      }
+      ms.planes[shot] = pixel + plane_sz * shot;
+      read_shorts(ms.planes[shot], unsigned(plane_sz));
+      ms.shift_row[shot] = -int(top_margin + (shot >> 1 & 1));
+      ms.shift_col[shot] = -int(left_margin + (shot & 1));
+      for (r = 0; r < 2; r++)
+        for (c = 0; c < 2; c++)
+          ms.channel[shot][r][c] = r * 3 ^ (~c & 1);
     }
+    ms.shots = 4;
+    multishot_merge(&ms);
   }
   catch (...)
   {
@@ -927,23 +1149,31 @@ void LibRaw::imacon_full_load_raw()
 {
   if (!image)
     throw LIBRAW_EXCEPTION_IO_CORRUPT;
-  int row, col;
+  int row, rows;
+  /* read by blocks of rows, expanded to image[] in parallel */
+  const int blockrows =
+      MAX(1, int((8u << 20) / (unsigned(width) * 6u + 1u)));
+  std::vector<ushort> buf(size_t(blockrows) * width * 3);
 
-  unsigned short *buf =
-      (unsigned short *)malloc(width * 3 * sizeof(unsigned short));
-
-  for (row = 0; row < height; row++)
+  for (row = 0; row < height; row += rows)
   {
     checkCancel();
-    read_shorts(buf, width * 3);
-    unsigned short(*rowp)[4] = &image[row * width];
-    for (col = 0; col < width; col++)
+    rows = MIN(blockrows, height - row);
+    read_shorts_rows(buf.data(), rows, width * 3);
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int k = 0; k < rows; k++)
     {
-      rowp[col][0] = buf[col * 3];
-      rowp[col][1] = buf[col * 3 + 1];
-      rowp[col][2] = buf[col * 3 + 2];
-      rowp[col][3] = 0;
+      const ushort *bp = &buf[size_t(k) * width * 3];
+      unsigned short(*rowp)[4] = &image[size_t(row + k) * width];
+      for (int col = 0; col < width; col++)
+      {
+        rowp[col][0] = bp[col * 3];
+        rowp[col][1] = bp[col * 3 + 1];
+        rowp[col][2] = bp[col * 3 + 2];
+        rowp[col][3] = 0;
+      }
     }
   }
-  free(buf);
 }
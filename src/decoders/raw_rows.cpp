@@ -0,0 +1,339 @@
+/* -*- C++ -*-
+ * Copyright 2019-2024 LibRaw LLC (info@libraw.org)
+ *
+ * Lazy raw access: formats with row-addressable layout are decoded by
+ * blocks of rows on request, without full unpack().
+ * Progressive unpack: watermark of rows decoded so far by unpack().
+
+ LibRaw is free software; you can redistribute it and/or modify
+ it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+
+#include "../../internal/libraw_cxx_defs.h"
+
+void LibRaw::free_raw_rows_cache()
+{
+  raw_rows_cache_t &rc = libraw_internal_data.raw_rows_cache;
+  for (int i = 0; i < LIBRAW_RAWROWS_CACHE; i++)
+    if (rc.data[i])
+      free(rc.data[i]);
+  memset(&rc, 0, sizeof(rc));
+}
+
+/* Rows per block if current decoder may be started at any block boundary,
+   0 otherwise. DNG opcodes are applied to the whole frame by unpack(), so
+   blocks are not decoded separately if opcodes are to be applied */
+unsigned LibRaw::raw_rows_block_size()
+{
+  unpacker_data_t &ud = libraw_internal_data.unpacker_data;
+  if (!load_raw || !(P1.filters || P1.colors == 1) || !S.raw_width ||
+      !S.raw_height || dng_opcodes_pending())
+    return 0;
+
+  if (load_raw == &LibRaw::unpacked_load_raw ||
+      load_raw == &LibRaw::eight_bit_load_raw)
+    return LIBRAW_RAWROWS_BLOCK;
+
+  if (load_raw == &LibRaw::packed_load_raw)
+  {
+    /* interlaced rows or padding byte every 10 pixels: sequential only */
+    if (ud.load_flags & 3)
+      return 0;
+    int bwide = S.raw_width * ud.tiff_bps / 8;
+    bwide += bwide & ud.load_flags >> 7;
+    int bite = 8 + (ud.load_flags & 24);
+    /* each row should start at bit buffer refill boundary */
+    if ((bwide * 8) % bite)
+      return 0;
+    return LIBRAW_RAWROWS_BLOCK;
+  }
+
+  if (load_raw == &LibRaw::packed_dng_load_raw)
+  {
+    if (ud.tile_length < INT_MAX)
+      return (ud.tile_width && ud.tile_length && ud.tile_length < 65536)
+                 ? ud.tile_length
+                 : 0;
+    return LIBRAW_RAWROWS_BLOCK;
+  }
+
+  if (load_raw == &LibRaw::phase_one_load_raw_c &&
+      C.phase_one_data.format != 6)
+    return LIBRAW_RAWROWS_BLOCK;
+
+  return 0;
+}
+
+/*
+   Runs the decoder over rows [block*block_rows, +block_rows) only: raw_height
+   is temporary set to the block size and data is read from the block start
+   (row offset for plain layouts, tile row offsets for tiled DNG, per-row
+   offsets table position for IIQ).
+ */
+void LibRaw::raw_rows_decode(unsigned block, unsigned block_rows, ushort *dst)
+{
+  unpacker_data_t &ud = libraw_internal_data.unpacker_data;
+  unsigned first = block * block_rows;
+  unsigned rows = MIN(block_rows, unsigned(S.raw_height) - first);
+  INT64 offset = ud.data_offset;
+  INT64 save_strip_offset = ud.strip_offset;
+
+  if (load_raw == &LibRaw::unpacked_load_raw)
+    offset += INT64(first) * S.raw_width * 2;
+  else if (load_raw == &LibRaw::eight_bit_load_raw)
+    offset += INT64(first) * S.raw_width;
+  else if (load_raw == &LibRaw::packed_load_raw)
+  {
+    int bwide = S.raw_width * ud.tiff_bps / 8;
+    bwide += bwide & ud.load_flags >> 7;
+    offset += INT64(first) * bwide;
+  }
+  else if (load_raw == &LibRaw::packed_dng_load_raw)
+  {
+    if (ud.tile_length < INT_MAX)
+    {
+      unsigned tiles = (S.raw_width + ud.tile_width - 1) / ud.tile_width;
+      offset += INT64(block) * tiles * 4;
+    }
+    else if (ud.tiff_bps == 16)
+      offset += INT64(first) * S.raw_width * ud.tiff_samples * 2;
+    else
+      offset += INT64(first) *
+                ((INT64(S.raw_width) * ud.tiff_samples * ud.tiff_bps + 7) / 8);
+  }
+  else if (load_raw == &LibRaw::phase_one_load_raw_c)
+    ud.strip_offset += INT64(first) * 4;
+
+  ushort save_raw_height = S.raw_height;
+  ushort save_top_margin = S.top_margin, save_height = S.height;
+  unsigned save_raw_pitch = S.raw_pitch;
+  unsigned save_data_error = ud.data_error;
+  unsigned save_maximum = C.maximum;
+  ushort *save_raw_image = imgdata.rawdata.raw_image;
+  short(*save_ph1_cblack)[2] = imgdata.rawdata.ph1_cblack;
+  short(*save_ph1_rblack)[2] = imgdata.rawdata.ph1_rblack;
+
+  memset(dst, 0, size_t(block_rows) * S.raw_width * sizeof(ushort));
+  S.raw_height = rows;
+  /* range checks of decoders use visible area rows: make it block-relative */
+  unsigned vis_first = MAX(unsigned(S.top_margin), first);
+  unsigned vis_last = MIN(unsigned(S.top_margin) + S.height, first + rows);
+  S.top_margin = vis_last > vis_first ? vis_first - first : 0;
+  S.height = vis_last > vis_first ? vis_last - vis_first : 0;
+  S.raw_pitch = S.raw_width * 2;
+  imgdata.rawdata.raw_image = dst;
+  int save_publish = libraw_internal_data.internal_data.raw_rows_publish;
+  libraw_internal_data.internal_data.raw_rows_publish = 0;
+  /* same as unpack() */
+  if (load_raw == &LibRaw::unpacked_load_raw &&
+      (!strcasecmp(imgdata.idata.make, "Nikon") ||
+       !strcasecmp(imgdata.idata.make, "Hasselblad")))
+    C.maximum = 65535;
+
+  int failed = 0;
+  LibRaw_exceptions err = LIBRAW_EXCEPTION_IO_CORRUPT;
+  try
+  {
+    ID.input->seek(offset, SEEK_SET);
+    (this->*load_raw)();
+  }
+  catch (const LibRaw_exceptions &e)
+  {
+    err = e;
+    failed = 1;
+  }
+  catch (const std::bad_alloc &)
+  {
+    err = LIBRAW_EXCEPTION_ALLOC;
+    failed = 1;
+  }
+  catch (...)
+  {
+    failed = 1;
+  }
+
+  S.raw_height = save_raw_height;
+  S.top_margin = save_top_margin;
+  S.height = save_height;
+  S.raw_pitch = save_raw_pitch;
+  /* block decoding is repeatable: do not accumulate data errors */
+  ud.data_error = save_data_error;
+  C.maximum = save_maximum;
+  imgdata.rawdata.raw_image = save_raw_image;
+  ud.strip_offset = save_strip_offset;
+  libraw_internal_data.internal_data.raw_rows_publish = save_publish;
+  /* IIQ decoder stores black columns/rows for the full frame, drop the
+     partial copies */
+  if (imgdata.rawdata.ph1_cblack != save_ph1_cblack)
+  {
+    free(imgdata.rawdata.ph1_cblack);
+    imgdata.rawdata.ph1_cblack = save_ph1_cblack;
+  }
+  if (imgdata.rawdata.ph1_rblack != save_ph1_rblack)
+  {
+    free(imgdata.rawdata.ph1_rblack);
+    imgdata.rawdata.ph1_rblack = save_ph1_rblack;
+  }
+  if (failed)
+    throw err;
+}
+
+ushort *LibRaw::raw_rows_block(unsigned block)
+{
+  raw_rows_cache_t &rc = libraw_internal_data.raw_rows_cache;
+  int slot = -1;
+  for (int i = 0; i < LIBRAW_RAWROWS_CACHE; i++)
+    if (rc.data[i] && rc.block[i] == block)
+    {
+      rc.used[i] = ++rc.clock;
+      return rc.data[i];
+    }
+
+  /* empty slot or least recently used one */
+  for (int i = 0; i < LIBRAW_RAWROWS_CACHE; i++)
+    if (!rc.data[i])
+    {
+      slot = i;
+      break;
+    }
+    else if (slot < 0 || rc.used[i] < rc.used[slot])
+      slot = i;
+
+  if (!rc.data[slot])
+    rc.data[slot] = (ushort *)malloc(size_t(rc.block_rows) * S.raw_width *
+                                     sizeof(ushort));
+  try
+  {
+    raw_rows_decode(block, rc.block_rows, rc.data[slot]);
+  }
+  catch (...)
+  {
+    free(rc.data[slot]);
+    rc.data[slot] = 0;
+    throw;
+  }
+  rc.block[slot] = block;
+  rc.used[slot] = ++rc.clock;
+  return rc.data[slot];
+}
+
+int LibRaw::get_raw_rows(unsigned first, unsigned count, ushort *dst)
+{
+  CHECK_ORDER_LOW(LIBRAW_PROGRESS_IDENTIFY);
+  if (!dst)
+    return LIBRAW_UNSPECIFIED_ERROR;
+  if (!count || first >= S.raw_height || count > unsigned(S.raw_height) - first)
+    return LIBRAW_REQUEST_FOR_NONEXISTENT_IMAGE;
+
+  try
+  {
+    if (!imgdata.rawdata.raw_image)
+    {
+      if (imgdata.rawdata.raw_alloc || imgdata.rawdata.float_image)
+        return LIBRAW_NOT_IMPLEMENTED; /* unpacked, but not single channel */
+      if (!libraw_internal_data.internal_data.input)
+        return LIBRAW_INPUT_CLOSED;
+
+      unsigned block_rows = raw_rows_block_size();
+      if (block_rows)
+      {
+        raw_rows_cache_t &rc = libraw_internal_data.raw_rows_cache;
+        if (rc.block_rows != block_rows)
+        {
+          free_raw_rows_cache();
+          rc.block_rows = block_rows;
+        }
+        for (unsigned row = first; row < first + count;)
+        {
+          unsigned block = row / block_rows;
+          unsigned r0 = row - block * block_rows;
+          unsigned rows = MIN(block_rows - r0, first + count - row);
+          ushort *bp = raw_rows_block(block);
+          memmove(dst + size_t(row - first) * S.raw_width,
+                  bp + size_t(r0) * S.raw_width,
+                  size_t(rows) * S.raw_width * sizeof(ushort));
+          row += rows;
+        }
+        return LIBRAW_SUCCESS;
+      }
+
+      /* no random access to rows: full decode */
+      int ret = unpack();
+      if (ret != LIBRAW_SUCCESS)
+        return ret;
+      if (!imgdata.rawdata.raw_image)
+        return LIBRAW_NOT_IMPLEMENTED;
+    }
+
+    for (unsigned row = 0; row < count; row++)
+      memmove(dst + size_t(row) * S.raw_width,
+              imgdata.rawdata.raw_image +
+                  size_t(first + row) * (S.raw_pitch / 2),
+              S.raw_width * sizeof(ushort));
+    return LIBRAW_SUCCESS;
+  }
+  catch (const std::bad_alloc&)
+  {
+    EXCEPTION_HANDLER(LIBRAW_EXCEPTION_ALLOC);
+  }
+  catch (const LibRaw_exceptions& err)
+  {
+    EXCEPTION_HANDLER(err);
+  }
+  catch (const std::exception& )
+  {
+    EXCEPTION_HANDLER(LIBRAW_EXCEPTION_IO_CORRUPT);
+  }
+}
+
+/*
+   Progressive unpack: decoders that fill raw_image in row order call this
+   with number of rows completed so far. Watermark is only moved forward;
+   rows_cb is called once per LIBRAW_RAWROWS_BLOCK rows and on last row.
+ */
+void LibRaw::publish_raw_rows(int row_end)
+{
+  internal_data_t &id = libraw_internal_data.internal_data;
+  const unsigned prev = unsigned(id.raw_rows_ready); /* written by this thread only */
+  if (!id.raw_rows_publish || row_end <= int(prev))
+    return;
+  const unsigned ready = MIN(unsigned(row_end), unsigned(S.raw_height));
+  set_raw_rows_ready(ready);
+  if (callbacks.rows_cb &&
+      (ready / LIBRAW_RAWROWS_BLOCK != prev / LIBRAW_RAWROWS_BLOCK ||
+       ready == S.raw_height))
+    (*callbacks.rows_cb)(callbacks.rowscb_data, ready, S.raw_height);
+}
+
+/*
+   Watermark may be polled from other threads while unpack() runs: store and
+   load are full barriers, so raw_image rows below the watermark are visible
+   to the reader (same primitives as cancel flag).
+ */
+void LibRaw::set_raw_rows_ready(unsigned rows)
+{
+  long *p = &libraw_internal_data.internal_data.raw_rows_ready;
+#ifdef _MSC_VER
+  InterlockedExchange(p, long(rows));
+#else
+  __sync_synchronize(); /* pixel stores before watermark */
+  __sync_lock_test_and_set(p, long(rows));
+#endif
+}
+
+unsigned LibRaw::raw_rows_ready()
+{
+  long *p = &libraw_internal_data.internal_data.raw_rows_ready;
+#ifdef _MSC_VER
+  return unsigned(InterlockedCompareExchange(p, 0, 0));
+#else
+  return unsigned(__sync_fetch_and_add(p, 0));
+#endif
+}
@@ -47,6 +47,9 @@ int LibRaw::unpack(void)
       free(imgdata.rawdata.raw_alloc);
       imgdata.rawdata.raw_alloc = 0;
     }
+    set_raw_rows_ready(0);
+    libraw_internal_data.internal_data.raw_decode_scale = 1;
+    free_render_cache();
     if (libraw_internal_data.unpacker_data.meta_length)
     {
       if (libraw_internal_data.unpacker_data.meta_length >
@@ -388,6 +391,23 @@ int LibRaw::unpack(void)
 			+ INT64(libraw_internal_data.unpacker_data.meta_length) >
             INT64(imgdata.rawparams.max_raw_memory_mb) * INT64(1024 * 1024))
           throw LIBRAW_EXCEPTION_TOOBIG;
+        if (libraw_internal_data.internal_data.user_raw_buffer &&
+            libraw_internal_data.internal_data.user_raw_buffer_size >=
+                size_t(rwidth) * (size_t(rheight) + 8) *
+                    sizeof(imgdata.rawdata.raw_image[0]))
+        {
+          // caller-owned storage, see unpack_frame()
+          imgdata.rawdata.raw_alloc = 0;
+          imgdata.rawdata.raw_image =
+              (ushort *)libraw_internal_data.internal_data.user_raw_buffer;
+#ifdef LIBRAW_CALLOC_RAWSTORE
+          memset(imgdata.rawdata.raw_image, 0,
+                 size_t(rwidth) * (size_t(rheight) + 8) *
+                     sizeof(imgdata.rawdata.raw_image[0]));
+#endif
+        }
+        else
+        {
 #ifdef LIBRAW_CALLOC_RAWSTORE
         imgdata.rawdata.raw_alloc =
             calloc(size_t(rwidth) * (size_t(rheight) + 8),sizeof(imgdata.rawdata.raw_image[0]));
@@ -396,6 +416,7 @@ int LibRaw::unpack(void)
             size_t(rwidth) * (size_t(rheight) + 8) * sizeof(imgdata.rawdata.raw_image[0]));
 #endif
         imgdata.rawdata.raw_image = (ushort *)imgdata.rawdata.raw_alloc;
+        }
         if (!S.raw_pitch)
           S.raw_pitch = S.raw_width * 2; // Bayer case, not set before
       }
@@ -444,7 +465,12 @@ int LibRaw::unpack(void)
           (!strcasecmp(imgdata.idata.make, "Nikon") || !strcasecmp(imgdata.idata.make, "Hasselblad"))
           )
         C.maximum = 65535;
+      /* row-ordered decoders report decoded rows via publish_raw_rows();
+         rows are not final if DNG opcodes are applied after load_raw() */
+      libraw_internal_data.internal_data.raw_rows_publish =
+          imgdata.rawdata.raw_image && !zero_rawimage && !dng_opcodes_pending();
       (this->*load_raw)();
+      libraw_internal_data.internal_data.raw_rows_publish = 0;
       if (zero_rawimage)
         imgdata.rawdata.raw_image = 0;
       if (load_raw == &LibRaw::unpacked_load_raw &&
@@ -501,6 +527,12 @@ int LibRaw::unpack(void)
       C.cblack[c] -= i;
     C.black += i;
 
+    apply_dng_opcodes();
+
+    libraw_internal_data.internal_data.raw_rows_publish = 1;
+    publish_raw_rows(S.raw_height);
+    libraw_internal_data.internal_data.raw_rows_publish = 0;
+
     // Save color,sizes and internal data into raw_image fields
     memmove(&imgdata.rawdata.color, &imgdata.color, sizeof(imgdata.color));
     memmove(&imgdata.rawdata.sizes, &imgdata.sizes, sizeof(imgdata.sizes));
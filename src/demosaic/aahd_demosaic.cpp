@@ -44,7 +44,6 @@ struct AAHD
   ushort channel_maximum[3], channels_max;
   ushort channel_minimum[3];
   static const float yuv_coeff[3][3];
-  static float gammaLUT[0x10000];
   float yuv_cam[3][3];
   LibRaw &libraw;
   enum
@@ -124,7 +123,6 @@ const float AAHD::yuv_coeff[3][3] = {
 
 };
 
-float AAHD::gammaLUT[0x10000] = {-1.f};
 
 AAHD::AAHD(LibRaw &_libraw) : libraw(_libraw)
 {
@@ -153,16 +151,6 @@ AAHD::AAHD(LibRaw &_libraw) : libraw(_libraw)
       for (int k = 0; k < 3; ++k)
         yuv_cam[i][j] += yuv_coeff[i][k] * libraw.imgdata.color.rgb_cam[k][j];
     }
-  if (gammaLUT[0] < -0.1f)
-  {
-    float r;
-    for (int i = 0; i < 0x10000; i++)
-    {
-      r = (float)i / 0x10000;
-      gammaLUT[i] =
-          0x10000 * (r < 0.0181 ? 4.5f * r : 1.0993f * pow(r, 0.45f) - .0993f);
-    }
-  }
   for (int i = 0; i < libraw.imgdata.sizes.iheight; ++i)
   {
     int col_cache[48];
@@ -296,6 +284,7 @@ void AAHD::hide_hots()
 void AAHD::evaluate_ahd()
 {
   int hvdir[4] = {Pw, Pe, Pn, Ps};
+  const float *gammaLUT = LibRaw_tables::aahd_gamma();
   /*
    * YUV
    *
@@ -23,28 +23,20 @@
    the work of Keigo Hirakawa, Thomas Parks, and Paul Lee.
  */
 
-void LibRaw::cielab(ushort rgb[3], short lab[3])
+/* cbrt: LibRaw_tables::cielab_cbrt(), callers converting many pixels
+   fetch it once */
+void LibRaw::cielab(ushort rgb[3], short lab[3], const float *cbrt)
 {
   int c, i, j, k;
-  float r, xyz[3];
+  float xyz[3];
 #ifdef LIBRAW_NOTHREADS
-  static float cbrt[0x10000], xyz_cam[3][4];
+  static float xyz_cam[3][4];
 #else
-#define cbrt tls->ahd_data.cbrt
 #define xyz_cam tls->ahd_data.xyz_cam
 #endif
 
   if (!rgb)
   {
-#ifndef LIBRAW_NOTHREADS
-    if (cbrt[0] < -1.0f)
-#endif
-      for (i = 0; i < 0x10000; i++)
-      {
-        r = i / 65535.0f;
-        cbrt[i] =
-            r > 0.008856f ? pow(r, 1.f / 3.0f) : 7.787f * r + 16.f / 116.0f;
-      }
     for (i = 0; i < 3; i++)
       for (j = 0; j < colors; j++)
         for (xyz_cam[i][j] = float( k = 0); k < 3; k++)
@@ -52,6 +44,8 @@ void LibRaw::cielab(ushort rgb[3], short lab[3])
                            LibRaw_constants::d65_white[i]);
     return;
   }
+  if (!cbrt)
+    cbrt = LibRaw_tables::cielab_cbrt();
   xyz[0] = xyz[1] = xyz[2] = 0.5;
   FORCC
   {
@@ -66,7 +60,6 @@ void LibRaw::cielab(ushort rgb[3], short lab[3])
   lab[1] = short(64 * 500 * (xyz[0] - xyz[1]));
   lab[2] = short(64 * 200 * (xyz[1] - xyz[2]));
 #ifndef LIBRAW_NOTHREADS
-#undef cbrt
 #undef xyz_cam
 #endif
 }
@@ -74,27 +67,26 @@ void LibRaw::cielab(ushort rgb[3], short lab[3])
 void LibRaw::ahd_interpolate_green_h_and_v(
     int top, int left, ushort (*out_rgb)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE][3])
 {
-  int row, col;
-  int c, val;
-  ushort(*pix)[4];
   const int rowlimit = MIN(top + LIBRAW_AHD_TILE, height - 2);
   const int collimit = MIN(left + LIBRAW_AHD_TILE, width - 2);
+  const int w = width;
 
-  for (row = top; row < rowlimit; row++)
+  for (int row = top; row < rowlimit; row++)
   {
-    col = left + (FC(row, left) & 1);
-    for (c = FC(row, col); col < collimit; col += 2)
+    const int col0 = left + (FC(row, left) & 1);
+    const int c = FC(row, col0);
+    ushort(*rgbh)[3] = out_rgb[0][row - top] - left;
+    ushort(*rgbv)[3] = out_rgb[1][row - top] - left;
+    const ushort(*pix)[4] = image + row * w;
+    for (int col = col0; col < collimit; col += 2)
     {
-      pix = image + row * width + col;
-      val =
-          ((pix[-1][1] + pix[0][c] + pix[1][1]) * 2 - pix[-2][c] - pix[2][c]) >>
-          2;
-      out_rgb[0][row - top][col - left][1] = ULIM(val, pix[-1][1], pix[1][1]);
-      val = ((pix[-width][1] + pix[0][c] + pix[width][1]) * 2 -
-             pix[-2 * width][c] - pix[2 * width][c]) >>
-            2;
-      out_rgb[1][row - top][col - left][1] =
-          ULIM(val, pix[-width][1], pix[width][1]);
+      const int gl = pix[col - 1][1], gr = pix[col + 1][1];
+      const int ga = pix[col - w][1], gb = pix[col + w][1];
+      const int own = pix[col][c];
+      int val = ((gl + own + gr) * 2 - pix[col - 2][c] - pix[col + 2][c]) >> 2;
+      rgbh[col][1] = ULIM(val, gl, gr);
+      val = ((ga + own + gb) * 2 - pix[col - 2 * w][c] - pix[col + 2 * w][c]) >> 2;
+      rgbv[col][1] = ULIM(val, ga, gb);
     }
   }
 }
@@ -113,12 +105,12 @@ void LibRaw::ahd_interpolate_r_and_b_in_rgb_and_convert_to_cielab(
   ushort *pix_above;
   ushort *pix_below;
   int t1, t2;
+  const float *cbrt = LibRaw_tables::cielab_cbrt();
 
   for (row = top + 1; row < rowlimit; row++)
   {
     pix = image + row * width + left;
     rix = &inout_rgb[row - top][0];
-    lix = &out_lab[row - top][0];
 
     for (col = left + 1; col < collimit; col++)
     {
@@ -126,7 +118,6 @@ void LibRaw::ahd_interpolate_r_and_b_in_rgb_and_convert_to_cielab(
       pix_above = &pix[0][0] - num_pix_per_row;
       pix_below = &pix[0][0] + num_pix_per_row;
       rix++;
-      lix++;
 
       c = 2 - FC(row, col);
 
@@ -156,8 +147,14 @@ void LibRaw::ahd_interpolate_r_and_b_in_rgb_and_convert_to_cielab(
       rix[0][c] = CLIP(val);
       c = FC(row, col);
       rix[0][c] = pix[0][c];
-      cielab(rix[0], lix[0]);
     }
+
+    /* separate pass: the conversion loop has no branches and no
+       dependency on interpolation order */
+    rix = &inout_rgb[row - top][1];
+    lix = &out_lab[row - top][1];
+    for (col = left + 1; col < collimit; col++, rix++, lix++)
+      cielab(rix[0], lix[0], cbrt);
   }
 }
 void LibRaw::ahd_interpolate_r_and_b_and_convert_to_cielab(
@@ -176,61 +173,48 @@ void LibRaw::ahd_interpolate_build_homogeneity_map(
     int top, int left, short (*lab)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE][3],
     char (*out_homogeneity_map)[LIBRAW_AHD_TILE][2])
 {
-  int row, col;
-  int tr;
-  int direction;
-  int i;
-  short(*lix)[3];
-  short(*lixs[2])[3];
-  short *adjacent_lix;
-  unsigned ldiff[2][4], abdiff[2][4], leps, abeps;
-  static const int dir[4] = {-1, 1, -LIBRAW_AHD_TILE, LIBRAW_AHD_TILE};
   const int rowlimit = MIN(top + LIBRAW_AHD_TILE - 2, height - 4);
   const int collimit = MIN(left + LIBRAW_AHD_TILE - 2, width - 4);
-  int homogeneity;
-  char(*homogeneity_map_p)[2];
 
   memset(out_homogeneity_map, 0, 2 * LIBRAW_AHD_TILE * LIBRAW_AHD_TILE);
 
-  for (row = top + 2; row < rowlimit; row++)
+  for (int row = top + 2; row < rowlimit; row++)
   {
-    tr = row - top;
-    homogeneity_map_p = &out_homogeneity_map[tr][1];
-    for (direction = 0; direction < 2; direction++)
-    {
-      lixs[direction] = &lab[direction][tr][1];
-    }
-
-    for (col = left + 2; col < collimit; col++)
+    const int tr = row - top;
+    const short(*lh)[3] = lab[0][tr];
+    const short(*lv)[3] = lab[1][tr];
+    const short(*lva)[3] = lab[1][tr - 1];
+    const short(*lvb)[3] = lab[1][tr + 1];
+    char(*hm)[2] = out_homogeneity_map[tr];
+
+    for (int tc = 2; tc < collimit - left; tc++)
     {
-      homogeneity_map_p++;
-
-      for (direction = 0; direction < 2; direction++)
-      {
-        lix = ++lixs[direction];
-        for (i = 0; i < 4; i++)
+      /* horizontal interpolation: left/right neighbours,
+         vertical: above/below; the other pair is used for homogeneity
+         count only */
+      unsigned ldiff[2][4], abdiff[2][4];
+      const short(*lha)[3] = lab[0][tr - 1];
+      const short(*lhb)[3] = lab[0][tr + 1];
+      const short *n[2][4] = {
+          {lh[tc - 1], lh[tc + 1], lha[tc], lhb[tc]},
+          {lv[tc - 1], lv[tc + 1], lva[tc], lvb[tc]}};
+      const short *ctr[2] = {lh[tc], lv[tc]};
+      for (int d = 0; d < 2; d++)
+        for (int i = 0; i < 4; i++)
         {
-          adjacent_lix = lix[dir[i]];
-          ldiff[direction][i] = ABS(lix[0][0] - adjacent_lix[0]);
-          abdiff[direction][i] = SQR(lix[0][1] - adjacent_lix[1]) +
-                                 SQR(lix[0][2] - adjacent_lix[2]);
+          ldiff[d][i] = ABS(ctr[d][0] - n[d][i][0]);
+          abdiff[d][i] = SQR(ctr[d][1] - n[d][i][1]) +
+                         SQR(ctr[d][2] - n[d][i][2]);
         }
-      }
-      leps = MIN(MAX(ldiff[0][0], ldiff[0][1]), MAX(ldiff[1][2], ldiff[1][3]));
-      abeps =
+      const unsigned leps =
+          MIN(MAX(ldiff[0][0], ldiff[0][1]), MAX(ldiff[1][2], ldiff[1][3]));
+      const unsigned abeps =
           MIN(MAX(abdiff[0][0], abdiff[0][1]), MAX(abdiff[1][2], abdiff[1][3]));
-      for (direction = 0; direction < 2; direction++)
-      {
-        homogeneity = 0;
-        for (i = 0; i < 4; i++)
-        {
-          if (ldiff[direction][i] <= leps && abdiff[direction][i] <= abeps)
-          {
-            homogeneity++;
-          }
-        }
-        homogeneity_map_p[0][direction] = homogeneity;
-      }
+      for (int d = 0; d < 2; d++)
+        hm[tc][d] = char((ldiff[d][0] <= leps && abdiff[d][0] <= abeps) +
+                         (ldiff[d][1] <= leps && abdiff[d][1] <= abeps) +
+                         (ldiff[d][2] <= leps && abdiff[d][2] <= abeps) +
+                         (ldiff[d][3] <= leps && abdiff[d][3] <= abeps));
     }
   }
 }
@@ -238,54 +222,40 @@ void LibRaw::ahd_interpolate_combine_homogeneous_pixels(
     int top, int left, ushort (*rgb)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE][3],
     char (*homogeneity_map)[LIBRAW_AHD_TILE][2])
 {
-  int row, col;
-  int tr, tc;
-  int i, j;
-  int direction;
-  int hm[2];
-  int c;
   const int rowlimit = MIN(top + LIBRAW_AHD_TILE - 3, height - 5);
   const int collimit = MIN(left + LIBRAW_AHD_TILE - 3, width - 5);
+  /* 3x3 box sum is done as vertical 3-row sum, then horizontal 3-sum */
+  int vsum[LIBRAW_AHD_TILE][2];
 
-  ushort(*pix)[4];
-  ushort(*rix[2])[3];
-
-  for (row = top + 3; row < rowlimit; row++)
+  for (int row = top + 3; row < rowlimit; row++)
   {
-    tr = row - top;
-    pix = &image[row * width + left + 2];
-    for (direction = 0; direction < 2; direction++)
-    {
-      rix[direction] = &rgb[direction][tr][2];
-    }
-
-    for (col = left + 3; col < collimit; col++)
+    const int tr = row - top;
+    const int tcend = collimit - left;
+    for (int j = 1; j <= tcend; j++)
+      for (int d = 0; d < 2; d++)
+        vsum[j][d] = homogeneity_map[tr - 1][j][d] +
+                     homogeneity_map[tr][j][d] +
+                     homogeneity_map[tr + 1][j][d];
+
+    ushort(*pix)[4] = &image[row * width + left];
+    const ushort(*rixh)[3] = rgb[0][tr];
+    const ushort(*rixv)[3] = rgb[1][tr];
+    for (int tc = 3; tc < tcend; tc++)
     {
-      tc = col - left;
-      pix++;
-      for (direction = 0; direction < 2; direction++)
-      {
-        rix[direction]++;
-      }
-
-      for (direction = 0; direction < 2; direction++)
-      {
-        hm[direction] = 0;
-        for (i = tr - 1; i <= tr + 1; i++)
-        {
-          for (j = tc - 1; j <= tc + 1; j++)
-          {
-            hm[direction] += homogeneity_map[i][j][direction];
-          }
-        }
-      }
-      if (hm[0] != hm[1])
+      const int hm0 = vsum[tc - 1][0] + vsum[tc][0] + vsum[tc + 1][0];
+      const int hm1 = vsum[tc - 1][1] + vsum[tc][1] + vsum[tc + 1][1];
+      if (hm0 != hm1)
       {
-        memcpy(pix[0], rix[hm[1] > hm[0]][0], 3 * sizeof(ushort));
+        const ushort *src = hm1 > hm0 ? rixv[tc] : rixh[tc];
+        pix[tc][0] = src[0];
+        pix[tc][1] = src[1];
+        pix[tc][2] = src[2];
       }
       else
       {
-        FORC3 { pix[0][c] = (rix[0][0][c] + rix[1][0][c]) >> 1; }
+        pix[tc][0] = (rixh[tc][0] + rixv[tc][0]) >> 1;
+        pix[tc][1] = (rixh[tc][1] + rixv[tc][1]) >> 1;
+        pix[tc][2] = (rixh[tc][2] + rixv[tc][2]) >> 1;
       }
     }
   }
@@ -302,25 +272,48 @@ void LibRaw::ahd_interpolate()
     int buffer_count = 1;
 #endif
 
-    size_t buffer_size = 26 * LIBRAW_AHD_TILE * LIBRAW_AHD_TILE; /* 1664 kB */
+    /* rgb: 12, lab: 12, homogeneity map: 2 bytes per tile pixel */
+    size_t buffer_size = 26 * LIBRAW_AHD_TILE * LIBRAW_AHD_TILE;
     char** buffers = malloc_omp_buffers(buffer_count, buffer_size);
 
+    /* Tiles overlap by 6 pixels, each output pixel is written by one tile
+       only, so tile order does not change the result */
+    const int step = LIBRAW_AHD_TILE - 6;
+    const int tiles_v = height > 7 ? (height - 7 + step - 1) / step : 0;
+    const int tiles_h = width > 7 ? (width - 7 + step - 1) / step : 0;
+    const int tiles_total = tiles_v * tiles_h;
+    /* progress: completed tiles, reported (by thread 0) once per row of tiles */
+    int tiles_done = 0, tilerows_reported = -1;
+
 #ifdef LIBRAW_USE_OPENMP
-#pragma omp parallel for schedule(dynamic) default(none) shared(terminate_flag) firstprivate(buffers)
+#pragma omp parallel for schedule(dynamic) default(none) shared(terminate_flag, tiles_done, tilerows_reported) firstprivate(buffers, tiles_h, tiles_total, step)
 #endif
-    for (int top = 2; top < height - 5; top += LIBRAW_AHD_TILE - 6)
+    for (int tile = 0; tile < tiles_total; tile++)
     {
+        const int top = 2 + (tile / tiles_h) * step;
+        const int left = 2 + (tile % tiles_h) * step;
 #ifdef LIBRAW_USE_OPENMP
         if (0 == omp_get_thread_num())
 #endif
             if (callbacks.progress_cb)
             {
-                int rr = (*callbacks.progress_cb)(callbacks.progresscb_data,
-                    LIBRAW_PROGRESS_INTERPOLATE,
-                    top - 2, height - 7);
-                if (rr)
-                    terminate_flag = 1;
+                int done;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic read
+#endif
+                done = tiles_done;
+                if (done / tiles_h != tilerows_reported)
+                {
+                    tilerows_reported = done / tiles_h;
+                    int rr = (*callbacks.progress_cb)(
+                        callbacks.progresscb_data, LIBRAW_PROGRESS_INTERPOLATE,
+                        MIN(tilerows_reported * step, height - 7), height - 7);
+                    if (rr)
+                        terminate_flag = 1;
+                }
             }
+        if (terminate_flag)
+            continue;
 
 #if defined(LIBRAW_USE_OPENMP)
         char* buffer = buffers[omp_get_thread_num()];
@@ -338,14 +331,14 @@ void LibRaw::ahd_interpolate()
         homo = (char(*)[LIBRAW_AHD_TILE][2])(buffer + 24 * LIBRAW_AHD_TILE *
             LIBRAW_AHD_TILE);
 
-        for (int left = 2; !terminate_flag && (left < width - 5);
-            left += LIBRAW_AHD_TILE - 6)
-        {
-            ahd_interpolate_green_h_and_v(top, left, rgb);
-            ahd_interpolate_r_and_b_and_convert_to_cielab(top, left, rgb, lab);
-            ahd_interpolate_build_homogeneity_map(top, left, lab, homo);
-            ahd_interpolate_combine_homogeneous_pixels(top, left, rgb, homo);
-        }
+        ahd_interpolate_green_h_and_v(top, left, rgb);
+        ahd_interpolate_r_and_b_and_convert_to_cielab(top, left, rgb, lab);
+        ahd_interpolate_build_homogeneity_map(top, left, lab, homo);
+        ahd_interpolate_combine_homogeneous_pixels(top, left, rgb, homo);
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic
+#endif
+        tiles_done++;
     }
 
     free_omp_buffers(buffers, buffer_count);
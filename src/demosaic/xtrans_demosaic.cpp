@@ -19,6 +19,13 @@
 #include "../../internal/dcraw_defs.h"
 
 #define fcol(row, col) xtrans[(row + 6) % 6][(col + 6) % 6]
+
+/* Vectorized inner loops (OpenMP 4.0 simd; MSVC OpenMP 2.0 has none) */
+#if defined(LIBRAW_USE_OPENMP) && _OPENMP >= 201307
+#define XTRANS_SIMD _Pragma("omp simd")
+#else
+#define XTRANS_SIMD
+#endif
 /*
    Frank Markesteijn's algorithm for Fuji X-Trans sensors
  */
@@ -31,12 +38,12 @@ void LibRaw::xtrans_interpolate(int passes)
                                      0, 0, 0},
                                     {0, 1, 0, -2, 1, 0, -2, 0, 1, 1, -2, -2, 1,
                                      -1, -1, 1}},
-                     dir[4] = {1, LIBRAW_AHD_TILE, LIBRAW_AHD_TILE + 1,
-                               LIBRAW_AHD_TILE - 1};
+                     dir[4] = {1, LIBRAW_XTRANS_TILE, LIBRAW_XTRANS_TILE + 1,
+                               LIBRAW_XTRANS_TILE - 1};
   short allhex[3][3][2][8];
   ushort sgrow = 0, sgcol = 0;
 
-  if (width < LIBRAW_AHD_TILE || height < LIBRAW_AHD_TILE || filters != 9)
+  if (width < LIBRAW_XTRANS_TILE || height < LIBRAW_XTRANS_TILE || filters != 9)
     throw LIBRAW_EXCEPTION_IO_CORRUPT; // too small image
                                        /* Check against right pattern */
   for (int row = 0; row < 6; row++)
@@ -85,7 +92,7 @@ void LibRaw::xtrans_interpolate(int passes)
                 minh = MIN(v, minh);
                 maxh = MAX(v, maxh);
                 allhex[row][col][0][c ^ (g * 2 & d)] = h + v * width;
-                allhex[row][col][1][c ^ (g * 2 & d)] = h + v * LIBRAW_AHD_TILE;
+                allhex[row][col][1][c ^ (g * 2 & d)] = h + v * LIBRAW_XTRANS_TILE;
             }
         }
       }
@@ -171,13 +178,13 @@ void LibRaw::xtrans_interpolate(int passes)
   int buffer_count = 1;
 #endif
 
-  size_t buffer_size = LIBRAW_AHD_TILE * LIBRAW_AHD_TILE * (ndir * 11 + 6);
+  size_t buffer_size = LIBRAW_XTRANS_TILE * LIBRAW_XTRANS_TILE * (ndir * 11 + 6);
   char** buffers = malloc_omp_buffers(buffer_count, buffer_size);
 
 #if defined(LIBRAW_USE_OPENMP)
 # pragma omp parallel for schedule(dynamic) default(none) firstprivate(buffers, allhex, passes, sgrow, sgcol, ndir) shared(dir) 
 #endif
-    for (int top = 3; top < height - 19; top += LIBRAW_AHD_TILE - 16)
+    for (int top = 3; top < height - 19; top += LIBRAW_XTRANS_TILE - 16)
     {
 #if defined(LIBRAW_USE_OPENMP)
         char* buffer = buffers[omp_get_thread_num()];
@@ -185,23 +192,23 @@ void LibRaw::xtrans_interpolate(int passes)
         char* buffer = buffers[0];
 #endif
 
-        ushort(*rgb)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE][3], (*rix)[3];
-        short(*lab)[LIBRAW_AHD_TILE][3], (*lix)[3];
-        float(*drv)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE];
-        char(*homo)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE];
+        ushort(*rgb)[LIBRAW_XTRANS_TILE][LIBRAW_XTRANS_TILE][3], (*rix)[3];
+        short(*lab)[LIBRAW_XTRANS_TILE][LIBRAW_XTRANS_TILE]; /* L, a, b planes */
+        float(*drv)[LIBRAW_XTRANS_TILE][LIBRAW_XTRANS_TILE];
+        char(*homo)[LIBRAW_XTRANS_TILE][LIBRAW_XTRANS_TILE];
 
-        rgb = (ushort(*)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE][3])buffer;
-        lab = (short(*)[LIBRAW_AHD_TILE][3])(
-            buffer + LIBRAW_AHD_TILE * LIBRAW_AHD_TILE * (ndir * 6));
-        drv = (float(*)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE])(
-            buffer + LIBRAW_AHD_TILE * LIBRAW_AHD_TILE * (ndir * 6 + 6));
-        homo = (char(*)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE])(
-            buffer + LIBRAW_AHD_TILE * LIBRAW_AHD_TILE * (ndir * 10 + 6));
+        rgb = (ushort(*)[LIBRAW_XTRANS_TILE][LIBRAW_XTRANS_TILE][3])buffer;
+        lab = (short(*)[LIBRAW_XTRANS_TILE][LIBRAW_XTRANS_TILE])(
+            buffer + LIBRAW_XTRANS_TILE * LIBRAW_XTRANS_TILE * (ndir * 6));
+        drv = (float(*)[LIBRAW_XTRANS_TILE][LIBRAW_XTRANS_TILE])(
+            buffer + LIBRAW_XTRANS_TILE * LIBRAW_XTRANS_TILE * (ndir * 6 + 6));
+        homo = (char(*)[LIBRAW_XTRANS_TILE][LIBRAW_XTRANS_TILE])(
+            buffer + LIBRAW_XTRANS_TILE * LIBRAW_XTRANS_TILE * (ndir * 10 + 6));
 
-        for (int left = 3; left < width - 19; left += LIBRAW_AHD_TILE - 16)
+        for (int left = 3; left < width - 19; left += LIBRAW_XTRANS_TILE - 16)
         {
-            int mrow = MIN(top + LIBRAW_AHD_TILE, height - 3);
-            int mcol = MIN(left + LIBRAW_AHD_TILE, width - 3);
+            int mrow = MIN(top + LIBRAW_XTRANS_TILE, height - 3);
+            int mcol = MIN(left + LIBRAW_XTRANS_TILE, width - 3);
             for (int row = top; row < mrow; row++)
                 for (int col = left; col < mcol; col++)
                     memcpy(rgb[0][row - top][col - left], image[row * width + col], 6);
@@ -209,16 +216,25 @@ void LibRaw::xtrans_interpolate(int passes)
             FORC3 memcpy(rgb[c + 1], rgb[0], sizeof * rgb);
 
             /* Interpolate green horizontally, vertically, and along both diagonals:
+               CFA color, hexagon and direction order are row invariants,
+               column phases (mod 6, mod 3) are stepped instead of fcol() calls
              */
             int color[3][8];
             for (int row = top; row < mrow; row++)
-                for (int col = left; col < mcol; col++)
+            {
+                const char* frow = xtrans[row % 6];
+                short(*hexrow)[2][8] = allhex[row % 3];
+                const int swap = !((row - sgrow) % 3);
+                ushort(*g4[4])[3];
+                FORC4 g4[c] = rgb[c ^ swap][row - top];
+                ushort(*pix)[4] = image + row * width + left;
+                for (int col = left, c6 = left % 6, c3 = left % 3; col < mcol;
+                    col++, pix++, c6 = c6 == 5 ? 0 : c6 + 1, c3 = c3 == 2 ? 0 : c3 + 1)
                 {
-                    int f;
-                    if ((f = fcol(row, col)) == 1)
+                    int f = frow[c6];
+                    if (f == 1)
                         continue;
-                    ushort (*pix)[4] = image + row * width + col;
-                    short* hex = allhex[row % 3][col % 3][0];
+                    short* hex = hexrow[c3][0];
                     color[1][0] = 174 * (pix[hex[1]][1] + pix[hex[0]][1]) -
                         46 * (pix[2 * hex[1]][1] + pix[2 * hex[0]][1]);
                     color[1][1] = 223 * pix[hex[3]][1] + pix[hex[2]][1] * 33 +
@@ -228,9 +244,10 @@ void LibRaw::xtrans_interpolate(int passes)
                         92 * pix[-2 * hex[4 + c]][1] +
                         33 * (2 * pix[0][f] - pix[3 * hex[4 + c]][f] -
                             pix[-3 * hex[4 + c]][f]);
-                    FORC4 rgb[c ^ !((row - sgrow) % 3)][row - top][col - left][1] =
+                    FORC4 g4[c][col - left][1] =
                         LIM(color[1][c] >> 8, pix[0][1], pix[0][3]);
                 }
+            }
 
             for (int pass = 0; pass < passes; pass++)
             {
@@ -241,22 +258,31 @@ void LibRaw::xtrans_interpolate(int passes)
                 if (pass)
                 {
                     for (int row = top + 2; row < mrow - 2; row++)
-                        for (int col = left + 2; col < mcol - 2; col++)
+                    {
+                        const char* frow = xtrans[row % 6];
+                        short(*hexrow)[2][8] = allhex[row % 3];
+                        const int swap = !((row - sgrow) % 3);
+                        ushort(*g3[3])[3];
+                        for (int d = 3; d < 6; d++)
+                            g3[d - 3] = rgb[(d - 2) ^ swap][row - top];
+                        ushort(*pix)[4] = image + row * width + left + 2;
+                        for (int col = left + 2, c6 = (left + 2) % 6, c3 = (left + 2) % 3;
+                            col < mcol - 2;
+                            col++, pix++, c6 = c6 == 5 ? 0 : c6 + 1, c3 = c3 == 2 ? 0 : c3 + 1)
                         {
-                            int f;
-                            if ((f = fcol(row, col)) == 1)
+                            int f = frow[c6];
+                            if (f == 1)
                                 continue;
-                            ushort(*pix)[4] = image + row * width + col;
-                            short* hex = allhex[row % 3][col % 3][1];
+                            short* hex = hexrow[c3][1];
                             for (int d = 3; d < 6; d++)
                             {
-                                rix =
-                                    &rgb[(d - 2) ^ !((row - sgrow) % 3)][row - top][col - left];
+                                rix = &g3[d - 3][col - left];
                                 int val = rix[-2 * hex[d]][1] + 2 * rix[hex[d]][1] -
                                     rix[-2 * hex[d]][f] - 2 * rix[hex[d]][f] + 3 * rix[0][f];
                                 rix[0][1] = LIM(val / 3, pix[0][1], pix[0][3]);
                             }
                         }
+                    }
                 }
 
                 /* Interpolate red and blue values for solitary green pixels:	*/
@@ -271,7 +297,7 @@ void LibRaw::xtrans_interpolate(int passes)
 
                     float diff[6];
                     memset(diff, 0, sizeof diff);
-                    for (int i = 1, d = 0; d < 6; d++, i ^= LIBRAW_AHD_TILE ^ 1, h ^= 2)
+                    for (int i = 1, d = 0; d < 6; d++, i ^= LIBRAW_XTRANS_TILE ^ 1, h ^= 2)
                     {
                         for (c = 0; c < 2; c++, h ^= 2)
                         {
@@ -287,7 +313,7 @@ void LibRaw::xtrans_interpolate(int passes)
                         if (d < 2 || (d & 1))
                         {
                             FORC(2) rix[0][c * 2] = CLIP(color[c * 2][d] / 2);
-                            rix += LIBRAW_AHD_TILE * LIBRAW_AHD_TILE;
+                            rix += LIBRAW_XTRANS_TILE * LIBRAW_XTRANS_TILE;
                         }
                     }
                 }
@@ -300,9 +326,9 @@ void LibRaw::xtrans_interpolate(int passes)
                         if ((f = 2 - fcol(row, col)) == 1)
                             continue;
                         rix = &rgb[0][row - top][col - left];
-                        c = (row - sgrow) % 3 ? LIBRAW_AHD_TILE : 1;
-                        int h = 3 * (c ^ LIBRAW_AHD_TILE ^ 1);
-                        for (int d = 0; d < 4; d++, rix += LIBRAW_AHD_TILE * LIBRAW_AHD_TILE)
+                        c = (row - sgrow) % 3 ? LIBRAW_XTRANS_TILE : 1;
+                        int h = 3 * (c ^ LIBRAW_XTRANS_TILE ^ 1);
+                        for (int d = 0; d < 4; d++, rix += LIBRAW_XTRANS_TILE * LIBRAW_XTRANS_TILE)
                         {
                             int i = d > 1 || ((d ^ c) & 1) ||
                                 ((ABS(rix[0][1] - rix[c][1]) +
@@ -326,7 +352,7 @@ void LibRaw::xtrans_interpolate(int passes)
                                 rix = &rgb[0][row - top][col - left];
                                 short* hex = allhex[row % 3][col % 3][1];
                                 for (int d = 0; d < 8;
-                                    d += 2, rix += LIBRAW_AHD_TILE * LIBRAW_AHD_TILE)
+                                    d += 2, rix += LIBRAW_XTRANS_TILE * LIBRAW_XTRANS_TILE)
                                     if (hex[d] + hex[d + 1])
                                     {
                                         int g = 3 * rix[0][1] - 2 * rix[hex[d]][1] - rix[hex[d + 1]][1];
@@ -343,63 +369,101 @@ void LibRaw::xtrans_interpolate(int passes)
                                     }
                             }
             }
-            rgb = (ushort(*)[LIBRAW_AHD_TILE][LIBRAW_AHD_TILE][3])buffer;
+            rgb = (ushort(*)[LIBRAW_XTRANS_TILE][LIBRAW_XTRANS_TILE][3])buffer;
             mrow -= top;
             mcol -= left;
 
             /* Convert to CIELab and differentiate in all directions:	*/
-            // no effect
+            const float *cbrt = LibRaw_tables::cielab_cbrt();
             for (int d = 0; d < ndir; d++)
             {
                 for (int row = 2; row < mrow - 2; row++)
+                {
+                    ushort(*rrow)[3] = rgb[d][row];
                     for (int col = 2; col < mcol - 2; col++)
-                        cielab(rgb[d][row][col], lab[row][col]);
-                for (int f = dir[d & 3], row = 3; row < mrow - 3; row++)
+                    {
+                        short l[3];
+                        cielab(rrow[col], l, cbrt);
+                        FORC3 lab[c][row][col] = l[c];
+                    }
+                }
+                const int f = dir[d & 3];
+                for (int row = 3; row < mrow - 3; row++)
+                {
+                    const short *lL = lab[0][row], *la = lab[1][row],
+                                *lb = lab[2][row];
+                    float *drow = drv[d][row];
+                    XTRANS_SIMD
                     for (int col = 3; col < mcol - 3; col++)
                     {
-                        lix = &lab[row][col];
-                        int g = 2 * lix[0][0] - lix[f][0] - lix[-f][0];
-                        drv[d][row][col] =
-							float(
+                        int g = 2 * lL[col] - lL[col + f] - lL[col - f];
+                        drow[col] = float(
                             SQR(g) +
-                            SQR((2 * lix[0][1] - lix[f][1] - lix[-f][1] + g * 500 / 232)) +
-                            SQR((2 * lix[0][2] - lix[f][2] - lix[-f][2] - g * 500 / 580))
-								);
+                            SQR((2 * la[col] - la[col + f] - la[col - f] + g * 500 / 232)) +
+                            SQR((2 * lb[col] - lb[col + f] - lb[col - f] - g * 500 / 580)));
                     }
+                }
             }
 
             /* Build homogeneity maps from the derivatives:			*/
-            memset(homo, 0, ndir * LIBRAW_AHD_TILE * LIBRAW_AHD_TILE);
+            memset(homo, 0, ndir * LIBRAW_XTRANS_TILE * LIBRAW_XTRANS_TILE);
             for (int row = 4; row < mrow - 4; row++)
+            {
+                /* per-pixel threshold first, then branch-free counts over
+                   contiguous rows of each direction */
+                float trow[LIBRAW_XTRANS_TILE];
                 for (int col = 4; col < mcol - 4; col++)
+                    trow[col] = FLT_MAX;
+                for (int d = 0; d < ndir; d++)
                 {
-                    int d;
-                    float tr;
-                    for (tr = FLT_MAX, d = 0; d < ndir; d++)
-                        if (tr > drv[d][row][col])
-                            tr = drv[d][row][col];
-                    tr *= 8;
-                    for (int dd = 0; dd < ndir; dd++)
-                        for (int v = -1; v <= 1; v++)
-                            for (int h = -1; h <= 1; h++)
-                                if (drv[dd][row + v][col + h] <= tr)
-                                    homo[dd][row][col]++;
+                    const float *dc = drv[d][row];
+                    XTRANS_SIMD
+                    for (int col = 4; col < mcol - 4; col++)
+                        if (trow[col] > dc[col])
+                            trow[col] = dc[col];
                 }
+                XTRANS_SIMD
+                for (int col = 4; col < mcol - 4; col++)
+                    trow[col] *= 8;
+                for (int dd = 0; dd < ndir; dd++)
+                {
+                    const float *da = drv[dd][row - 1], *dc = drv[dd][row],
+                                *db = drv[dd][row + 1];
+                    char *hrow = homo[dd][row];
+                    XTRANS_SIMD
+                    for (int col = 4; col < mcol - 4; col++)
+                    {
+                        const float tr = trow[col];
+                        hrow[col] = char(
+                            (da[col - 1] <= tr) + (da[col] <= tr) + (da[col + 1] <= tr) +
+                            (dc[col - 1] <= tr) + (dc[col] <= tr) + (dc[col + 1] <= tr) +
+                            (db[col - 1] <= tr) + (db[col] <= tr) + (db[col + 1] <= tr));
+                    }
+                }
+            }
 
             /* Average the most homogeneous pixels for the final result:	*/
-            if (height - top < LIBRAW_AHD_TILE + 4)
+            if (height - top < LIBRAW_XTRANS_TILE + 4)
                 mrow = height - top + 2;
-            if (width - left < LIBRAW_AHD_TILE + 4)
+            if (width - left < LIBRAW_XTRANS_TILE + 4)
                 mcol = width - left + 2;
             for (int row = MIN(top, 8); row < mrow - 8; row++)
-                for (int col = MIN(left, 8); col < mcol - 8; col++)
+            {
+                /* 5x5 box sums: vertical 5-row sums, then horizontal 5-sums */
+                int vsum[8][LIBRAW_XTRANS_TILE];
+                const int col0 = MIN(left, 8);
+                for (int d = 0; d < ndir; d++)
+                    XTRANS_SIMD
+                    for (int col = col0 - 2; col < mcol - 6; col++)
+                        vsum[d][col] = homo[d][row - 2][col] + homo[d][row - 1][col] +
+                                       homo[d][row][col] + homo[d][row + 1][col] +
+                                       homo[d][row + 2][col];
+                for (int col = col0; col < mcol - 8; col++)
                 {
-                    int v;
                     int hm[8];
                     for (int d = 0; d < ndir; d++)
-                        for (v = -2, hm[d] = 0; v <= 2; v++)
-                            for (int h = -2; h <= 2; h++)
-                                hm[d] += homo[d][row + v][col + h];
+                        hm[d] = vsum[d][col - 2] + vsum[d][col - 1] + vsum[d][col] +
+                                vsum[d][col + 1] + vsum[d][col + 2];
                     for (int d = 0; d < ndir - 4; d++)
                         if (hm[d] < hm[d + 4])
                             hm[d] = 0;
@@ -422,6 +486,7 @@ void LibRaw::xtrans_interpolate(int passes)
                         }
                     FORC3 image[(row + top) * width + col + left][c] = avg[c] / avg[3];
                 }
+            }
         }
     }
   
@@ -131,6 +131,26 @@ extern "C"
     LibRaw *ip = (LibRaw *)lr->parent_class;
     return ip->open_buffer(buffer, size);
   }
+  int libraw_save_snapshot(libraw_data_t *lr, void **snapshot,
+                           size_t *snapshot_size)
+  {
+    if (!lr)
+      return EINVAL;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->save_snapshot(snapshot, snapshot_size);
+  }
+  void libraw_free_snapshot(void *snapshot)
+  {
+    LibRaw::free_snapshot(snapshot);
+  }
+  int libraw_open_file_with_snapshot(libraw_data_t *lr, const char *fname,
+                                     const void *snapshot, size_t snapshot_size)
+  {
+    if (!lr)
+      return EINVAL;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->open_file_with_snapshot(fname, snapshot, snapshot_size);
+  }
   int libraw_open_bayer(libraw_data_t *lr, unsigned char *data,
                         unsigned datalen, ushort _raw_width, ushort _raw_height,
                         ushort _left_margin, ushort _top_margin,
@@ -153,6 +173,70 @@ extern "C"
     LibRaw *ip = (LibRaw *)lr->parent_class;
     return ip->unpack();
   }
+  int libraw_frame_count(libraw_data_t *lr)
+  {
+    if (!lr)
+      return EINVAL;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->frame_count();
+  }
+  size_t libraw_frame_buffer_size(libraw_data_t *lr)
+  {
+    if (!lr)
+      return 0;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->frame_buffer_size();
+  }
+  int libraw_select_frame(libraw_data_t *lr, unsigned frame)
+  {
+    if (!lr)
+      return EINVAL;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->select_frame(frame);
+  }
+  int libraw_unpack_frame(libraw_data_t *lr, unsigned frame, void *buffer,
+                          size_t buffer_size)
+  {
+    if (!lr)
+      return EINVAL;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->unpack_frame(frame, buffer, buffer_size);
+  }
+  int libraw_get_raw_rows(libraw_data_t *lr, unsigned first, unsigned count,
+                          ushort *dst)
+  {
+    if (!lr)
+      return EINVAL;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->get_raw_rows(first, count, dst);
+  }
+  int libraw_get_raw_stats(libraw_data_t *lr, libraw_raw_stats_t *stats,
+                           unsigned step)
+  {
+    if (!lr)
+      return EINVAL;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->get_raw_stats(stats, step);
+  }
+  unsigned libraw_raw_rows_ready(libraw_data_t *lr)
+  {
+    if (!lr)
+      return 0;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->raw_rows_ready();
+  }
+  libraw_processed_image_t *libraw_make_mem_rows_preview(libraw_data_t *lr,
+                                                         int scale, int *errc)
+  {
+    if (!lr)
+    {
+      if (errc)
+        *errc = EINVAL;
+      return NULL;
+    }
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->make_mem_rows_preview(scale, errc);
+  }
   int libraw_unpack_thumb(libraw_data_t *lr)
   {
     if (!lr)
@@ -223,6 +307,14 @@ extern "C"
     LibRaw *ip = (LibRaw *)lr->parent_class;
     ip->set_progress_handler(cb, data);
   }
+  void libraw_set_rows_handler(libraw_data_t *lr, rows_callback cb,
+                               void *data)
+  {
+    if (!lr)
+      return;
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    ip->set_rows_handler(cb, data);
+  }
 
   int libraw_adjust_to_raw_inset_crop(libraw_data_t *lr, unsigned mask, float maxcrop)
   {
@@ -273,6 +365,18 @@ extern "C"
     LibRaw *ip = (LibRaw *)lr->parent_class;
     return ip->dcraw_make_mem_image(errc);
   }
+  libraw_processed_image_t *libraw_dcraw_make_mem_jpeg(libraw_data_t *lr,
+                                                       int quality, int *errc)
+  {
+    if (!lr)
+    {
+      if (errc)
+        *errc = EINVAL;
+      return NULL;
+    }
+    LibRaw *ip = (LibRaw *)lr->parent_class;
+    return ip->dcraw_make_mem_jpeg(quality, errc);
+  }
   libraw_processed_image_t *libraw_dcraw_make_mem_thumb(libraw_data_t *lr,
                                                         int *errc)
   {
@@ -291,6 +395,37 @@ extern "C"
     LibRaw::dcraw_clear_mem(p);
   }
 
+  int libraw_load_dark_frame(libraw_dark_frame_t *df, const char *fname)
+  {
+    return LibRaw::load_dark_frame(df, fname);
+  }
+
+  int libraw_dark_frame_from_buffer(libraw_dark_frame_t *df, void *buffer,
+                                    size_t size)
+  {
+    return LibRaw::dark_frame_from_buffer(df, buffer, size);
+  }
+
+  int libraw_save_dark_frame(const libraw_dark_frame_t *df, const char *fname)
+  {
+    return LibRaw::save_dark_frame(df, fname);
+  }
+
+  void libraw_free_dark_frame(libraw_dark_frame_t *df)
+  {
+    LibRaw::free_dark_frame(df);
+  }
+
+  int libraw_load_bad_pixels(libraw_bad_pixels_t *bp, const char *fname)
+  {
+    return LibRaw::load_bad_pixels(bp, fname);
+  }
+
+  void libraw_free_bad_pixels(libraw_bad_pixels_t *bp)
+  {
+    LibRaw::free_bad_pixels(bp);
+  }
+
   int libraw_raw2image(libraw_data_t *lr)
   {
     if (!lr)
@@ -27,38 +27,45 @@ static libraw_area_t sget_CanonArea(uchar *s) {
 
 int LibRaw::selectCRXFrame(short trackNum, unsigned frameIndex)
 {
-  uint32_t sample_size;
-  uint32_t stsc_index = 0;
-  uint32_t current_sample = 0;
   crx_data_header_t *hdr = &libraw_internal_data.unpacker_data.crx_header[trackNum];
 
   if (frameIndex >= hdr->sample_count)
     return -1;
+  if (!hdr->stsc_count || !hdr->stsc_data || !hdr->chunk_offsets ||
+      (!hdr->sample_size && !hdr->sample_sizes))
+    return -1;
 
-  for (unsigned i = 0; i < hdr->chunk_count; i++)
+  // Walk chunk and stsc tables only once per track, so selecting frames of
+  // a long roll burst one after another is not quadratic
+  if (!hdr->sample_offsets)
   {
-    int64_t current_offset = hdr->chunk_offsets[i];
-
-    while((stsc_index < hdr->stsc_count) && (i+1 == hdr->stsc_data[stsc_index+1].first))
-      stsc_index++;
+    uint32_t stsc_index = 0;
+    uint32_t current_sample = 0;
+    hdr->sample_offsets = (INT64 *)calloc(hdr->sample_count, sizeof(INT64));
+    for (unsigned i = 0; i < hdr->sample_count; i++)
+      hdr->sample_offsets[i] = -1LL;
 
-    for (unsigned j = 0; j < hdr->stsc_data[stsc_index].count; j++)
+    for (unsigned i = 0; i < hdr->chunk_count && current_sample < hdr->sample_count; i++)
     {
-      if (current_sample > hdr->sample_count)
-        return -1;
+      INT64 current_offset = hdr->chunk_offsets[i];
 
-      sample_size = hdr->sample_size > 0 ? hdr->sample_size : hdr->sample_sizes[current_sample];
-      if(current_sample == frameIndex)
+      while ((stsc_index + 1 < hdr->stsc_count) && (i + 1 == hdr->stsc_data[stsc_index + 1].first))
+        stsc_index++;
+
+      for (unsigned j = 0; j < hdr->stsc_data[stsc_index].count && current_sample < hdr->sample_count; j++)
       {
-        hdr->MediaOffset = current_offset;
-        hdr->MediaSize = sample_size;
-        return 0;
+        hdr->sample_offsets[current_sample] = current_offset;
+        current_offset += hdr->sample_size > 0 ? hdr->sample_size : hdr->sample_sizes[current_sample];
+        current_sample++;
       }
-      current_offset += sample_size;
-      current_sample++;
     }
   }
-  return -1;
+
+  if (hdr->sample_offsets[frameIndex] < 0)
+    return -1;
+  hdr->MediaOffset = hdr->sample_offsets[frameIndex];
+  hdr->MediaSize = hdr->sample_size > 0 ? hdr->sample_size : hdr->sample_sizes[frameIndex];
+  return 0;
 }
 
 void LibRaw::selectCRXTrack()
@@ -920,6 +927,12 @@ void LibRaw::parseCR3_Free()
       free(d->sample_sizes);
       d->sample_sizes = NULL;
     }
+
+    if (d->sample_offsets)
+    {
+      free(d->sample_offsets);
+      d->sample_offsets = NULL;
+    }
     d->stsc_count   = 0;
     d->sample_count = 0;
     d->sample_size  = 0;
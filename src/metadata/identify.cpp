@@ -498,6 +498,10 @@ void LibRaw::identify()
   load_raw = 0;
   thumb_format = LIBRAW_INTERNAL_THUMBNAIL_JPEG; // default to JPEG
   data_offset = meta_offset = meta_length = tiff_bps = tiff_compress = 0;
+  memset(libraw_internal_data.unpacker_data.dng_opcodes_offset, 0,
+         sizeof(libraw_internal_data.unpacker_data.dng_opcodes_offset));
+  memset(libraw_internal_data.unpacker_data.dng_opcodes_len, 0,
+         sizeof(libraw_internal_data.unpacker_data.dng_opcodes_len));
   kodak_cbpp = zero_after_ff = dng_version = load_flags = 0;
   timestamp = shot_order = tiff_samples = black = is_foveon = 0;
   mix_green = profile_length = data_error = zero_is_bad = 0;
@@ -1538,10 +1542,15 @@ void LibRaw::identify_process_dng_fields()
 					tiff_ifd[sidx].dng_levels.dng_fblack;
 				imgdata.color.dng_levels.dng_black =
 					tiff_ifd[sidx].dng_levels.dng_black;
-				COPYARR(imgdata.color.dng_levels.dng_cblack,
-					tiff_ifd[sidx].dng_levels.dng_cblack);
-				COPYARR(imgdata.color.dng_levels.dng_fcblack,
-					tiff_ifd[sidx].dng_levels.dng_fcblack);
+				if (tiff_ifd[sidx].dng_levels.dng_cblack)
+				{
+					memmove(imgdata.color.dng_levels.dng_cblack,
+						tiff_ifd[sidx].dng_levels.dng_cblack,
+						sizeof(imgdata.color.dng_levels.dng_cblack));
+					memmove(imgdata.color.dng_levels.dng_fcblack,
+						tiff_ifd[sidx].dng_levels.dng_fcblack,
+						sizeof(imgdata.color.dng_levels.dng_fcblack));
+				}
 			}
 
 
@@ -1556,6 +1565,22 @@ void LibRaw::identify_process_dng_fields()
 			if (sidx >= 0)
 				meta_offset = tiff_ifd[sidx].opcode2_offset;
 
+			{
+				const unsigned opbits[3] = {LIBRAW_DNGFM_OPCODE1, LIBRAW_DNGFM_OPCODE2,
+					LIBRAW_DNGFM_OPCODE3};
+				for (int q = 0; q < 3; q++)
+				{
+					sidx = IFDLEVELINDEX(iifd, opbits[q]);
+					if (sidx >= 0)
+					{
+						libraw_internal_data.unpacker_data.dng_opcodes_offset[q] =
+							tiff_ifd[sidx].opcode_offset[q];
+						libraw_internal_data.unpacker_data.dng_opcodes_len[q] =
+							tiff_ifd[sidx].opcode_len[q];
+					}
+				}
+			}
+
 			sidx = IFDLEVELINDEX(iifd, LIBRAW_DNGFM_LINTABLE);
 			INT64 linoff = -1;
 			int linlen = 0;
@@ -105,13 +105,8 @@ void LibRaw::sony_decrypt(unsigned *data, int len, int start, int key)
 #endif
   if (start)
   {
-    for (p = 0; p < 4; p++)
-      pad[p] = key = key * 48828125ULL + 1;
-    pad[3] = pad[3] << 1 | (pad[0] ^ pad[2]) >> 31;
-    for (p = 4; p < 127; p++)
-      pad[p] = (pad[p - 4] ^ pad[p - 2]) << 1 | (pad[p - 3] ^ pad[p - 1]) >> 31;
-    for (p = 0; p < 127; p++)
-      pad[p] = htonl(pad[p]);
+    sony_decrypt_init(pad, key);
+    p = 127;
   }
   while (len--)
   {
@@ -123,6 +118,124 @@ void LibRaw::sony_decrypt(unsigned *data, int len, int start, int key)
 #undef p
 #endif
 }
+/* Initial 127 words of sony_decrypt() pad (in memory byte order) */
+void LibRaw::sony_decrypt_init(unsigned *pad, unsigned key)
+{
+  unsigned p;
+  for (p = 0; p < 4; p++)
+    pad[p] = key = unsigned(key * 48828125ULL + 1);
+  pad[3] = pad[3] << 1 | (pad[0] ^ pad[2]) >> 31;
+  for (p = 4; p < 127; p++)
+    pad[p] = (pad[p - 4] ^ pad[p - 2]) << 1 | (pad[p - 3] ^ pad[p - 1]) >> 31;
+  for (p = 0; p < 127; p++)
+    pad[p] = htonl(pad[p]);
+}
+
+/*
+   sony_decrypt() keystream is x[127+k], k = 0,1,..., where
+   x[n] = x[n-127] ^ x[n-63] and x[0..126] is the initial pad. The
+   recurrence is linear over GF(2) with characteristic polynomial
+   t^127 + t^64 + 1, so x[m] = XOR of x[i] for all t^i present in
+   t^m mod (t^127 + t^64 + 1): any position is reachable without
+   generating all previous words. Polynomials of degree < 127 are kept
+   in two 64-bit words.
+ */
+namespace
+{
+struct sony_poly_t
+{
+  UINT64 lo, hi;
+};
+
+inline void sony_poly_mul_t(sony_poly_t &a)
+{
+  a.hi = a.hi << 1 | a.lo >> 63;
+  a.lo <<= 1;
+  if (a.hi >> 63) /* t^127 = t^64 + 1 */
+  {
+    a.hi ^= (1ULL << 63) | 1ULL;
+    a.lo ^= 1ULL;
+  }
+}
+
+sony_poly_t sony_poly_mulmod(const sony_poly_t &a, const sony_poly_t &b)
+{
+  sony_poly_t r = {0, 0};
+  for (int i = 126; i >= 0; i--)
+  {
+    sony_poly_mul_t(r);
+    if ((i < 64 ? b.lo >> i : b.hi >> (i - 64)) & 1)
+    {
+      r.lo ^= a.lo;
+      r.hi ^= a.hi;
+    }
+  }
+  return r;
+}
+
+/* t^n mod (t^127 + t^64 + 1) */
+sony_poly_t sony_poly_pow(UINT64 n)
+{
+  sony_poly_t r = {1, 0};
+  for (int bit = 63; bit >= 0; bit--)
+  {
+    r = sony_poly_mulmod(r, r);
+    if ((n >> bit) & 1)
+      sony_poly_mul_t(r);
+  }
+  return r;
+}
+
+inline unsigned sony_poly_eval(const sony_poly_t &a, const unsigned *pad)
+{
+  unsigned v = 0;
+  for (int i = 0; i < 64; i++)
+    if ((a.lo >> i) & 1)
+      v ^= pad[i];
+  for (int i = 64; i < 127; i++)
+    if ((a.hi >> (i - 64)) & 1)
+      v ^= pad[i];
+  return v;
+}
+} // namespace
+
+/*
+   Decrypts len words with keystream starting at word pos (pos=0 is the
+   first word after sony_decrypt(..., start=1, ...)). Keystream is generated
+   by 63-word runs: x[n] for n in [m, m+63) depends on older words only,
+   so each run is a plain loop without carried dependency.
+ */
+void LibRaw::sony_decrypt_at(const unsigned *pad, INT64 pos, unsigned *data,
+                             int len)
+{
+  const int run = 63 * 16;
+  unsigned buf[127 + run];
+  if (pos <= 0)
+    memcpy(buf, pad, 127 * sizeof(unsigned));
+  else
+  {
+    sony_poly_t a = sony_poly_pow(UINT64(pos));
+    for (int j = 0; j < 127; j++, sony_poly_mul_t(a))
+      buf[j] = sony_poly_eval(a, pad);
+  }
+  while (len > 0)
+  {
+    const int n = MIN(len, run);
+    for (int k = 0; k < n; k += 63)
+    {
+      unsigned *x = buf + 127 + k;
+      const int m = MIN(63, n - k);
+      for (int i = 0; i < m; i++)
+        x[i] = x[i - 127] ^ x[i - 63];
+    }
+    for (int i = 0; i < n; i++)
+      data[i] ^= buf[127 + i];
+    data += n;
+    len -= n;
+    memmove(buf, buf + n, 127 * sizeof(unsigned));
+  }
+}
+
 void LibRaw::setSonyBodyFeatures(unsigned long long id) {
 
 #define sbfDSLR_DX LIBRAW_FORMAT_APSC,LIBRAW_MOUNT_Minolta_A,LIBRAW_SONY_DSLR,LIBRAW_MOUNT_Unknown
@@ -19,6 +19,17 @@
 #include "../../internal/dcraw_defs.h"
 #include "../../internal/libraw_cameraids.h"
 
+void LibRaw::tiff_ifd_alloc_black(int ifd)
+{
+  if (!tiff_ifd[ifd].dng_levels.dng_cblack)
+  {
+    tiff_ifd[ifd].dng_levels.dng_cblack =
+        (unsigned *)calloc(LIBRAW_CBLACK_SIZE, sizeof(unsigned));
+    tiff_ifd[ifd].dng_levels.dng_fcblack =
+        (float *)calloc(LIBRAW_CBLACK_SIZE, sizeof(float));
+  }
+}
+
 int LibRaw::parse_tiff_ifd(INT64 base)
 {
   unsigned entries, tag, type, len, plen = 16, utmp;
@@ -683,7 +694,8 @@ int LibRaw::parse_tiff_ifd(INT64 base)
       }
       break;
     case 0x0145: // 325
-      tiff_ifd[ifd].bytes = len > 1 ? ftell(ifp) : get4(); // FIXME: get8 for BigTIFF
+      tiff_ifd[ifd].tile_bytes_type = type;
+      tiff_ifd[ifd].bytes = len > 1 ? ftell(ifp) : getint(type); // FIXME: get8 for BigTIFF
       break;
     case 0x014a: /* 330, SubIFDs */
       if (!strcmp(model, "DSLR-A100") && tiff_ifd[ifd].t_width == 3872)
@@ -1101,6 +1113,7 @@ int LibRaw::parse_tiff_ifd(INT64 base)
       linear_table(len);
       break;
     case 0xc619: /* 50713, BlackLevelRepeatDim */
+      tiff_ifd_alloc_black(ifd);
       tiff_ifd[ifd].dng_levels.parsedfields |= LIBRAW_DNGFM_BLACK;
       
 	  tiff_ifd[ifd].dng_levels.dng_cblack[4] = cblack[4] = get2();
@@ -1255,6 +1268,7 @@ int LibRaw::parse_tiff_ifd(INT64 base)
     case 0xf00a: // 61450
       cblack[4] = cblack[5] = int(MIN(sqrtf((float)len), 64.f));
     case 0xc61a: /* 50714, BlackLevel */
+      tiff_ifd_alloc_black(ifd);
       if (tiff_ifd[ifd].samples > 1 &&
           tiff_ifd[ifd].samples == (int)len) // LinearDNG, per-channel black
       {
@@ -1680,13 +1694,19 @@ int LibRaw::parse_tiff_ifd(INT64 base)
       break;
     case 0xc740: /* 51008, OpcodeList1 */
       tiff_ifd[ifd].dng_levels.parsedfields |= LIBRAW_DNGFM_OPCODE1;
+      tiff_ifd[ifd].opcode_offset[0] = ftell(ifp);
+      tiff_ifd[ifd].opcode_len[0] = len;
       break;
     case 0xc741: /* 51009, OpcodeList2 */
       tiff_ifd[ifd].dng_levels.parsedfields |= LIBRAW_DNGFM_OPCODE2;
       tiff_ifd[ifd].opcode2_offset = meta_offset = ftell(ifp);
+      tiff_ifd[ifd].opcode_offset[1] = tiff_ifd[ifd].opcode2_offset;
+      tiff_ifd[ifd].opcode_len[1] = len;
       break;
     case 0xc74e: /* 51022, OpcodeList3 */
       tiff_ifd[ifd].dng_levels.parsedfields |= LIBRAW_DNGFM_OPCODE3;
+      tiff_ifd[ifd].opcode_offset[2] = ftell(ifp);
+      tiff_ifd[ifd].opcode_len[2] = len;
       break;
     case 0xfd04: /* 64772, Kodak P-series */
       if (len < 13)
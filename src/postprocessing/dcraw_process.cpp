@@ -25,6 +25,12 @@ int LibRaw::dcraw_process(void)
   CHECK_ORDER_LOW(LIBRAW_PROGRESS_LOAD_RAW);
   //    CHECK_ORDER_HIGH(LIBRAW_PROGRESS_PRE_INTERPOLATE);
 
+  /* output size is half of image or less (and caller allows it): process
+     at half size */
+  int save_half = O.half_size;
+  if (output_auto_half())
+    O.half_size = 1;
+
   try
   {
 
@@ -37,186 +43,218 @@ int LibRaw::dcraw_process(void)
 		if (O.aber[c]< 0.001 || O.aber[c] > 1000.f)
 			O.aber[c] = 1.0;
 
-    libraw_decoder_info_t di;
-    get_decoder_info(&di);
-
-    bool is_bayer = (imgdata.idata.filters || P1.colors == 1);
-    int subtract_inline =
-        !O.bad_pixels && !O.dark_frame && is_bayer && !IO.zero_is_bad;
-
-    int rc = raw2image_ex(subtract_inline); // allocate imgdata.image and copy data!
-	if (rc != LIBRAW_SUCCESS)
-		return rc;
-
-    // Adjust sizes
-
     int save_4color = O.four_color_rgb;
+    fused_output_reset();
 
-    if (IO.zero_is_bad)
-    {
-      remove_zeroes();
-      SET_PROC_FLAG(LIBRAW_PROGRESS_REMOVE_ZEROES);
-    }
+    /* restart from cached stage if its parameters are not changed */
+    int stage = render_cache_restore();
 
-    if (O.bad_pixels && no_crop)
+    if (stage < LIBRAW_RENDERCACHE_POSTBLACK)
     {
-      bad_pixels(O.bad_pixels);
-      SET_PROC_FLAG(LIBRAW_PROGRESS_BAD_PIXELS);
-    }
+      libraw_decoder_info_t di;
+      get_decoder_info(&di);
 
-    if (O.dark_frame && no_crop)
-    {
-      subtract(O.dark_frame);
-      SET_PROC_FLAG(LIBRAW_PROGRESS_DARK_FRAME);
-    }
-    /* pre subtract black callback: check for it above to disable subtract
-     * inline */
+      bool is_bayer = (imgdata.idata.filters || P1.colors == 1);
+      int subtract_inline = !O.bad_pixels && !O.dark_frame &&
+                            !O.bad_pixels_data && !O.dark_frame_data &&
+                            is_bayer && !IO.zero_is_bad;
 
-    if (callbacks.pre_subtractblack_cb)
-      (callbacks.pre_subtractblack_cb)(this);
+      int rc = raw2image_ex(subtract_inline); // allocate imgdata.image and copy data!
+      if (rc != LIBRAW_SUCCESS)
+      {
+        O.half_size = save_half;
+        return rc;
+      }
 
-    quality = 2 + !IO.fuji_width;
+      if (IO.zero_is_bad)
+      {
+        remove_zeroes();
+        SET_PROC_FLAG(LIBRAW_PROGRESS_REMOVE_ZEROES);
+      }
 
-    if (O.user_qual >= 0)
-      quality = O.user_qual;
+      if (O.bad_pixels_data && no_crop)
+      {
+        bad_pixels(O.bad_pixels_data);
+        SET_PROC_FLAG(LIBRAW_PROGRESS_BAD_PIXELS);
+      }
+      else if (O.bad_pixels && no_crop)
+      {
+        bad_pixels(O.bad_pixels);
+        SET_PROC_FLAG(LIBRAW_PROGRESS_BAD_PIXELS);
+      }
 
-    if (!subtract_inline || !C.data_maximum)
-    {
-      adjust_bl();
-      subtract_black_internal();
-    }
+      int dark_subtracted = 0;
+      if (O.dark_frame_data && no_crop)
+      {
+        dark_subtracted = subtract(O.dark_frame_data);
+        SET_PROC_FLAG(LIBRAW_PROGRESS_DARK_FRAME);
+      }
+      else if (O.dark_frame && no_crop)
+      {
+        dark_subtracted = subtract(O.dark_frame);
+        SET_PROC_FLAG(LIBRAW_PROGRESS_DARK_FRAME);
+      }
+      /* pre subtract black callback: check for it above to disable subtract
+       * inline */
+
+      if (callbacks.pre_subtractblack_cb)
+        (callbacks.pre_subtractblack_cb)(this);
 
-    if (!(di.decoder_flags & LIBRAW_DECODER_FIXEDMAXC))
-      adjust_maximum();
+      if (!subtract_inline || !C.data_maximum)
+      {
+        adjust_bl();
+        /* dark frame pass has already computed data_maximum */
+        if (!dark_subtracted || C.cblack[0] || C.cblack[1] || C.cblack[2] ||
+            C.cblack[3] || (C.cblack[4] && C.cblack[5]))
+          subtract_black_internal();
+      }
 
-    if (O.user_sat > 0)
-      C.maximum = O.user_sat;
+      if (!(di.decoder_flags & LIBRAW_DECODER_FIXEDMAXC))
+        adjust_maximum();
 
-    if (P1.is_foveon)
-    {
-      if (load_raw == &LibRaw::x3f_load_raw)
+      if (O.user_sat > 0)
+        C.maximum = O.user_sat;
+
+      if (P1.is_foveon)
       {
-        // Filter out zeroes
-        for (int q = 0; q < S.height * S.width; q++)
+        if (load_raw == &LibRaw::x3f_load_raw)
         {
-          for (int c = 0; c < 4; c++)
-            if ((short)imgdata.image[q][c] < 0)
-              imgdata.image[q][c] = 0;
+          // Filter out zeroes
+          for (int q = 0; q < S.height * S.width; q++)
+          {
+            for (int c = 0; c < 4; c++)
+              if ((short)imgdata.image[q][c] < 0)
+                imgdata.image[q][c] = 0;
+          }
         }
+        SET_PROC_FLAG(LIBRAW_PROGRESS_FOVEON_INTERPOLATE);
       }
-      SET_PROC_FLAG(LIBRAW_PROGRESS_FOVEON_INTERPOLATE);
+      render_cache_store(LIBRAW_RENDERCACHE_POSTBLACK);
     }
 
-    if (O.green_matching && !O.half_size)
+    if (stage < LIBRAW_RENDERCACHE_POSTDEMOSAIC)
     {
-      green_matching();
-    }
+      quality = 2 + !IO.fuji_width;
 
-    if (callbacks.pre_scalecolors_cb)
-      (callbacks.pre_scalecolors_cb)(this);
+      if (O.user_qual >= 0)
+        quality = O.user_qual;
 
-    if (!O.no_auto_scale)
-    {
-      scale_colors();
-      SET_PROC_FLAG(LIBRAW_PROGRESS_SCALE_COLORS);
-    }
+      if (O.green_matching && !O.half_size)
+      {
+        green_matching();
+      }
 
-    if (callbacks.pre_preinterpolate_cb)
-      (callbacks.pre_preinterpolate_cb)(this);
+      if (callbacks.pre_scalecolors_cb)
+        (callbacks.pre_scalecolors_cb)(this);
 
-    pre_interpolate();
+      if (!O.no_auto_scale)
+      {
+        scale_colors();
+        SET_PROC_FLAG(LIBRAW_PROGRESS_SCALE_COLORS);
+      }
 
-    SET_PROC_FLAG(LIBRAW_PROGRESS_PRE_INTERPOLATE);
+      if (callbacks.pre_preinterpolate_cb)
+        (callbacks.pre_preinterpolate_cb)(this);
 
-    if (O.dcb_iterations >= 0)
-      iterations = O.dcb_iterations;
-    if (O.dcb_enhance_fl >= 0)
-      dcb_enhance = O.dcb_enhance_fl;
-    if (O.fbdd_noiserd >= 0)
-      noiserd = O.fbdd_noiserd;
+      pre_interpolate();
 
-    /* pre-exposure correction callback */
+      SET_PROC_FLAG(LIBRAW_PROGRESS_PRE_INTERPOLATE);
 
-    if (O.exp_correc > 0)
-    {
-      expos = O.exp_shift;
-      preser = O.exp_preser;
-      exp_bef(expos, preser);
-    }
+      if (O.dcb_iterations >= 0)
+        iterations = O.dcb_iterations;
+      if (O.dcb_enhance_fl >= 0)
+        dcb_enhance = O.dcb_enhance_fl;
+      if (O.fbdd_noiserd >= 0)
+        noiserd = O.fbdd_noiserd;
 
-    if (callbacks.pre_interpolate_cb)
-      (callbacks.pre_interpolate_cb)(this);
+      /* pre-exposure correction callback */
 
-    /* post-exposure correction fallback */
-    if (P1.filters && !O.no_interpolation)
-    {
-      if (noiserd > 0 && P1.colors == 3 && P1.filters > 1000)
-        fbdd(noiserd);
-
-      if (P1.filters > 1000 && callbacks.interpolate_bayer_cb)
-        (callbacks.interpolate_bayer_cb)(this);
-      else if (P1.filters == 9 && callbacks.interpolate_xtrans_cb)
-        (callbacks.interpolate_xtrans_cb)(this);
-      else if (quality == 0)
-        lin_interpolate();
-      else if (quality == 1 || P1.colors > 3 || (P1.filters != LIBRAW_XTRANS && P1.filters <= 1000))
-        vng_interpolate();
-      else if (quality == 2 && P1.filters > 1000)
-        ppg_interpolate();
-      else if (P1.filters == LIBRAW_XTRANS)
+      if (O.exp_correc > 0)
       {
-        // Fuji X-Trans
-        xtrans_interpolate(quality > 2 ? 3 : 1);
+        expos = O.exp_shift;
+        preser = O.exp_preser;
+        exp_bef(expos, preser);
       }
-      else if (quality == 3)
-        ahd_interpolate(); // really don't need it here due to fallback op
-      else if (quality == 4)
-        dcb(iterations, dcb_enhance);
-
-      else if (quality == 11)
-        dht_interpolate();
-      else if (quality == 12)
-        aahd_interpolate();
-      // fallback to AHD
-      else
+
+      if (callbacks.pre_interpolate_cb)
+        (callbacks.pre_interpolate_cb)(this);
+
+      /* post-exposure correction fallback */
+      if (P1.filters && !O.no_interpolation)
       {
-        ahd_interpolate();
-        imgdata.process_warnings |= LIBRAW_WARN_FALLBACK_TO_AHD;
-      }
+        if (noiserd > 0 && P1.colors == 3 && P1.filters > 1000)
+          fbdd(noiserd);
+
+        if (P1.filters > 1000 && callbacks.interpolate_bayer_cb)
+          (callbacks.interpolate_bayer_cb)(this);
+        else if (P1.filters == 9 && callbacks.interpolate_xtrans_cb)
+          (callbacks.interpolate_xtrans_cb)(this);
+        else if (quality == 0)
+          lin_interpolate();
+        else if (quality == 1 || P1.colors > 3 || (P1.filters != LIBRAW_XTRANS && P1.filters <= 1000))
+          vng_interpolate();
+        else if (quality == 2 && P1.filters > 1000)
+          ppg_interpolate();
+        else if (P1.filters == LIBRAW_XTRANS)
+        {
+          // Fuji X-Trans
+          xtrans_interpolate(quality > 2 ? 3 : 1);
+        }
+        else if (quality == 3)
+          ahd_interpolate(); // really don't need it here due to fallback op
+        else if (quality == 4)
+          dcb(iterations, dcb_enhance);
+
+        else if (quality == 11)
+          dht_interpolate();
+        else if (quality == 12)
+          aahd_interpolate();
+        // fallback to AHD
+        else
+        {
+          ahd_interpolate();
+          imgdata.process_warnings |= LIBRAW_WARN_FALLBACK_TO_AHD;
+        }
 
-      SET_PROC_FLAG(LIBRAW_PROGRESS_INTERPOLATE);
-    }
-    if (IO.mix_green)
-    {
-      for (P1.colors = 3, i = 0; i < S.height * S.width; i++)
-        imgdata.image[i][1] = (imgdata.image[i][1] + imgdata.image[i][3]) >> 1;
-      SET_PROC_FLAG(LIBRAW_PROGRESS_MIX_GREEN);
+        SET_PROC_FLAG(LIBRAW_PROGRESS_INTERPOLATE);
+      }
+      if (IO.mix_green)
+      {
+        for (P1.colors = 3, i = 0; i < S.height * S.width; i++)
+          imgdata.image[i][1] = (imgdata.image[i][1] + imgdata.image[i][3]) >> 1;
+        SET_PROC_FLAG(LIBRAW_PROGRESS_MIX_GREEN);
+      }
+      render_cache_store(LIBRAW_RENDERCACHE_POSTDEMOSAIC);
     }
 
-    if (callbacks.post_interpolate_cb)
-      (callbacks.post_interpolate_cb)(this);
-    else if (!P1.is_foveon && P1.colors == 3 && O.med_passes > 0)
+    if (stage < LIBRAW_RENDERCACHE_POSTHIGHLIGHTS)
     {
-      median_filter();
-      SET_PROC_FLAG(LIBRAW_PROGRESS_MEDIAN_FILTER);
-    }
+      if (callbacks.post_interpolate_cb)
+        (callbacks.post_interpolate_cb)(this);
+      else if (!P1.is_foveon && P1.colors == 3 && O.med_passes > 0)
+      {
+        median_filter();
+        SET_PROC_FLAG(LIBRAW_PROGRESS_MEDIAN_FILTER);
+      }
 
-    if (O.highlight == 2)
-    {
-      blend_highlights();
-      SET_PROC_FLAG(LIBRAW_PROGRESS_HIGHLIGHTS);
-    }
+      if (O.highlight == 2)
+      {
+        blend_highlights();
+        SET_PROC_FLAG(LIBRAW_PROGRESS_HIGHLIGHTS);
+      }
 
-    if (O.highlight > 2)
-    {
-      recover_highlights();
-      SET_PROC_FLAG(LIBRAW_PROGRESS_HIGHLIGHTS);
-    }
+      if (O.highlight > 2)
+      {
+        recover_highlights();
+        SET_PROC_FLAG(LIBRAW_PROGRESS_HIGHLIGHTS);
+      }
 
-    if (O.use_fuji_rotate)
-    {
-      fuji_rotate();
-      SET_PROC_FLAG(LIBRAW_PROGRESS_FUJI_ROTATE);
+      if (O.use_fuji_rotate)
+      {
+        fuji_rotate();
+        SET_PROC_FLAG(LIBRAW_PROGRESS_FUJI_ROTATE);
+      }
+      render_cache_store(LIBRAW_RENDERCACHE_POSTHIGHLIGHTS);
     }
 
     if (!libraw_internal_data.output_data.histogram)
@@ -248,16 +286,19 @@ int LibRaw::dcraw_process(void)
       SET_PROC_FLAG(LIBRAW_PROGRESS_STRETCH);
     }
     O.four_color_rgb = save_4color; // also, restore
+    O.half_size = save_half;
 
     return 0;
   }
   catch (const std::bad_alloc&)
   {
+      O.half_size = save_half;
       recycle();
       return LIBRAW_UNSUFFICIENT_MEMORY;
   }
   catch (const LibRaw_exceptions& err)
   {
+    O.half_size = save_half;
     EXCEPTION_HANDLER(err);
   }
 }
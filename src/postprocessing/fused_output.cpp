@@ -0,0 +1,249 @@
+/* -*- C++ -*-
+ * Copyright 2019-2024 LibRaw LLC (info@libraw.org)
+ *
+ * Fused output stage (imgdata.params.fused_output): dcraw_process() leaves
+ * imgdata.image in camera colors, color conversion (matrix and/or ICC
+ * transform sampled on 3-D grid) is applied by output functions row by row,
+ * directly before gamma curve and packing into output buffer.
+
+ LibRaw is free software; you can redistribute it and/or modify
+ it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+
+#include "../../internal/libraw_cxx_defs.h"
+
+#define FUSED_N LIBRAW_FUSED_LUT_SIZE
+
+void LibRaw::fused_output_reset()
+{
+  fused_output_t &f = libraw_internal_data.output_data.fused;
+  if (f.lut)
+    free(f.lut);
+  memset(&f, 0, sizeof(f));
+}
+
+namespace
+{
+/* Grid is uniform in sqrt(value): linear camera data needs denser nodes
+   near black, where output encoding curves are steep */
+inline ushort fused_node(int i)
+{
+  double t = double(i) / (FUSED_N - 1);
+  return ushort(t * t * 65535. + 0.5);
+}
+} // namespace
+
+/* Grid nodes for ICC transform: node (r,g,b) is at (r*N+g)*N+b; transformed
+   in place by apply_profile() */
+ushort (*LibRaw::fused_output_grid())[4]
+{
+  fused_output_t &f = libraw_internal_data.output_data.fused;
+  if (!f.lut)
+    f.lut = (ushort(*)[4])malloc(sizeof(*f.lut) * FUSED_N * FUSED_N * FUSED_N);
+  ushort(*g)[4] = f.lut;
+  for (int r = 0; r < FUSED_N; r++)
+    for (int gr = 0; gr < FUSED_N; gr++)
+      for (int b = 0; b < FUSED_N; b++, g++)
+      {
+        (*g)[0] = fused_node(r);
+        (*g)[1] = fused_node(gr);
+        (*g)[2] = fused_node(b);
+        (*g)[3] = 0;
+      }
+  return f.lut;
+}
+
+/* Called by convert_to_rgb() instead of convert_to_rgb_loop() */
+void LibRaw::fused_output_init(float out_cam[3][4])
+{
+  fused_output_t &f = libraw_internal_data.output_data.fused;
+  f.active = 1;
+  f.colors = P1.colors;
+  f.raw_color = libraw_internal_data.internal_output_params.raw_color;
+  memmove(f.out_cam, out_cam, sizeof(f.out_cam));
+  f.histogram_ready = 0;
+  memset(libraw_internal_data.output_data.histogram, 0,
+         sizeof(int) * LIBRAW_HISTOGRAM_SIZE * 4);
+  /* histogram is built before stretch(), as convert_to_rgb_loop() does */
+  if (!((O.highlight & ~2) || O.no_auto_bright))
+    fused_output_histogram();
+}
+
+/* Histogram of converted pixels, same channels as convert_to_rgb_loop() */
+void LibRaw::fused_output_histogram()
+{
+  fused_output_t &f = libraw_internal_data.output_data.fused;
+  if (!f.active || f.histogram_ready)
+    return;
+  int(*histogram)[LIBRAW_HISTOGRAM_SIZE] =
+      libraw_internal_data.output_data.histogram;
+  memset(histogram, 0, sizeof(int) * LIBRAW_HISTOGRAM_SIZE * 4);
+  const int nc =
+      (f.raw_color || f.colors == 3 || f.colors == 4) ? f.colors : 0;
+  int failed = 0;
+  if (nc)
+  {
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp parallel
+#endif
+    {
+      int(*hist)[LIBRAW_HISTOGRAM_SIZE] = (int(*)[LIBRAW_HISTOGRAM_SIZE])::calloc(
+          4 * LIBRAW_HISTOGRAM_SIZE, sizeof(int));
+      ushort(*buf)[4] = (ushort(*)[4])::malloc(S.width * sizeof(*buf));
+      if (hist && buf)
+      {
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp for schedule(static)
+#endif
+        for (int row = 0; row < S.height; row++)
+        {
+          fused_output_row(row * S.width, 1, S.width, buf);
+          for (int col = 0; col < S.width; col++)
+            for (int c = 0; c < nc; c++)
+              hist[c][buf[col][c] >> 3]++;
+        }
+      }
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp critical(dataupdate)
+#endif
+      {
+        if (!hist || !buf)
+          failed = 1;
+        else
+          for (int c = 0; c < nc; c++)
+            for (int i = 0; i < LIBRAW_HISTOGRAM_SIZE; i++)
+              histogram[c][i] += hist[c][i];
+      }
+      ::free(buf);
+      ::free(hist);
+    }
+  }
+  if (failed)
+    throw LIBRAW_EXCEPTION_ALLOC;
+  f.histogram_ready = 1;
+}
+
+namespace
+{
+/* Tetrahedral interpolation in FUSED_N^3 grid, channels 0..2 */
+inline void fused_lut_pixel(const ushort (*lut)[4], const ushort *in,
+                            ushort *out)
+{
+  int i[3];
+  float fr[3];
+  for (int c = 0; c < 3; c++)
+  {
+    float p = sqrtf(in[c] * (1.f / 65535.f)) * (FUSED_N - 1);
+    i[c] = int(p);
+    if (i[c] >= FUSED_N - 1)
+      i[c] = FUSED_N - 2;
+    fr[c] = p - i[c];
+  }
+  const int sr = FUSED_N * FUSED_N, sg = FUSED_N, sb = 1;
+  const ushort *c000 = lut[(i[0] * FUSED_N + i[1]) * FUSED_N + i[2]];
+  const ushort *c111 = c000 + 4 * (sr + sg + sb);
+  const ushort *a, *b;
+  float w0, w1, w2;
+  /* path from c000 to c111 through two more vertices, larger fraction first */
+  if (fr[0] >= fr[1])
+  {
+    if (fr[1] >= fr[2])
+    {
+      a = c000 + 4 * sr, b = c000 + 4 * (sr + sg);
+      w0 = fr[0], w1 = fr[1], w2 = fr[2];
+    }
+    else if (fr[0] >= fr[2])
+    {
+      a = c000 + 4 * sr, b = c000 + 4 * (sr + sb);
+      w0 = fr[0], w1 = fr[2], w2 = fr[1];
+    }
+    else
+    {
+      a = c000 + 4 * sb, b = c000 + 4 * (sr + sb);
+      w0 = fr[2], w1 = fr[0], w2 = fr[1];
+    }
+  }
+  else
+  {
+    if (fr[0] >= fr[2])
+    {
+      a = c000 + 4 * sg, b = c000 + 4 * (sr + sg);
+      w0 = fr[1], w1 = fr[0], w2 = fr[2];
+    }
+    else if (fr[1] >= fr[2])
+    {
+      a = c000 + 4 * sg, b = c000 + 4 * (sg + sb);
+      w0 = fr[1], w1 = fr[2], w2 = fr[0];
+    }
+    else
+    {
+      a = c000 + 4 * sb, b = c000 + 4 * (sg + sb);
+      w0 = fr[2], w1 = fr[1], w2 = fr[0];
+    }
+  }
+  for (int c = 0; c < 3; c++)
+  {
+    float v = c000[c] + w0 * (a[c] - c000[c]) + w1 * (b[c] - a[c]) +
+              w2 * (c111[c] - b[c]);
+    out[c] = ushort(v <= 0.f ? 0 : v >= 65535.f ? 65535 : int(v + 0.5f));
+  }
+  out[3] = in[3];
+}
+} // namespace
+
+/* Converts count pixels starting at image[soff] with step cstep into out */
+void LibRaw::fused_output_row(int soff, int cstep, int count,
+                              ushort (*out)[4])
+{
+  const fused_output_t &f = libraw_internal_data.output_data.fused;
+  const float(*m)[4] = f.out_cam;
+  const ushort(*img)[4] = imgdata.image + soff;
+  if (f.lut)
+  {
+    for (int col = 0; col < count; col++, img += cstep)
+      fused_lut_pixel(f.lut, *img, out[col]);
+  }
+  else if (f.raw_color || (f.colors != 3 && f.colors != 4))
+  {
+    for (int col = 0; col < count; col++, img += cstep)
+      memmove(out[col], *img, sizeof(*out));
+  }
+  else if (f.colors == 3)
+  {
+    /* same expressions as convert_to_rgb_loop() */
+    float o[3];
+    for (int col = 0; col < count; col++, img += cstep)
+    {
+      const ushort *p = *img;
+      o[0] = m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2];
+      o[1] = m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2];
+      o[2] = m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2];
+      out[col][0] = CLIP((int)o[0]);
+      out[col][1] = CLIP((int)o[1]);
+      out[col][2] = CLIP((int)o[2]);
+      out[col][3] = p[3];
+    }
+  }
+  else
+  {
+    float o[3];
+    for (int col = 0; col < count; col++, img += cstep)
+    {
+      const ushort *p = *img;
+      o[0] = m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3] * p[3];
+      o[1] = m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3] * p[3];
+      o[2] = m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3] * p[3];
+      out[col][0] = CLIP((int)o[0]);
+      out[col][1] = CLIP((int)o[1]);
+      out[col][2] = CLIP((int)o[2]);
+      out[col][3] = p[3];
+    }
+  }
+}
@@ -179,19 +179,65 @@ void LibRaw::get_mem_image_format(int *width, int *height, int *colors,
   {
     std::swap(*width, *height);
   }
+  output_target_size(*width, *height, width, height);
   *colors = P1.colors;
   *bps = O.output_bps;
 }
 
-int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
+/* Flip path of output image: first pixel offset, column and row steps;
+   output width and height */
+void LibRaw::mem_image_geometry(int *soff, int *cstep, int *rstep, int *width,
+                                int *height)
+{
+  int s_iheight = S.iheight;
+  int s_iwidth = S.iwidth;
+  int s_width = S.width;
+  int s_height = S.height;
+  S.iheight = S.height;
+  S.iwidth = S.width;
+  if (S.flip & 4)
+    SWAP(S.height, S.width);
+  *soff = flip_index(0, 0);
+  *cstep = flip_index(0, 1) - *soff;
+  *rstep = flip_index(1, 0) - flip_index(0, S.width);
+  *width = S.width;
+  *height = S.height;
+  S.iheight = s_iheight;
+  S.iwidth = s_iwidth;
+  S.width = s_width;
+  S.height = s_height;
+}
 
+namespace
 {
-  // the image memory pointed to by scan0 is assumed to be in the format
-  // returned by get_mem_image_format
-  if ((imgdata.progress_flags & LIBRAW_PROGRESS_THUMB_MASK) <
-      LIBRAW_PROGRESS_PRE_INTERPOLATE)
-    return LIBRAW_OUT_OF_ORDER_CALL;
+struct mem_image_sink_t
+{
+  uchar *scan0;
+  int stride, width, bgr, colors, bps;
+  const ushort *curve;
+};
 
+/* output_resampled_rows() sink: gamma curve and packing */
+void mem_image_sink(void *ctx, int row, const ushort (*data)[4])
+{
+  const mem_image_sink_t &m = *(const mem_image_sink_t *)ctx;
+  uchar *ppm = m.scan0 + size_t(row) * m.stride;
+  ushort *ppm2 = (ushort *)ppm;
+  for (int col = 0; col < m.width; col++)
+    for (int k = 0; k < m.colors; k++)
+    {
+      int c = m.bgr ? m.colors - 1 - k : k;
+      if (m.bps == 8)
+        *ppm++ = m.curve[data[col][c]] >> 8;
+      else
+        *ppm2++ = m.curve[data[col][c]];
+    }
+}
+} // namespace
+
+/* Output curve with auto-brightness from histogram (as write_ppm_tiff) */
+void LibRaw::mem_image_gamma_curve()
+{
   if (libraw_internal_data.output_data.histogram)
   {
     int perc, val, total, t_white = 0x2000, c;
@@ -199,6 +245,8 @@ int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
     if (IO.fuji_width)
       perc /= 2;
     if (!((O.highlight & ~2) || O.no_auto_bright))
+    {
+      fused_output_histogram();
       for (t_white = c = 0; c < P1.colors; c++)
       {
         for (val = 0x2000, total = 0; --val > 32;)
@@ -208,42 +256,112 @@ int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
         if (t_white < val)
           t_white = val;
       }
+    }
     gamma_curve(O.gamm[0], O.gamm[1], 2, int((t_white << 3) / O.bright));
   }
+}
 
-  int s_iheight = S.iheight;
-  int s_iwidth = S.iwidth;
-  int s_width = S.width;
-  int s_hwight = S.height;
+int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
 
-  S.iheight = S.height;
-  S.iwidth = S.width;
+{
+  // the image memory pointed to by scan0 is assumed to be in the format
+  // returned by get_mem_image_format
+  if ((imgdata.progress_flags & LIBRAW_PROGRESS_THUMB_MASK) <
+      LIBRAW_PROGRESS_PRE_INTERPOLATE)
+    return LIBRAW_OUT_OF_ORDER_CALL;
+
+  mem_image_gamma_curve();
 
-  if (S.flip & 4)
-    SWAP(S.height, S.width);
   uchar *ppm;
   ushort *ppm2;
-  int c, row, col, soff, rstep, cstep;
+  int c, row, col, soff, rstep, cstep, w, h;
+  mem_image_geometry(&soff, &cstep, &rstep, &w, &h);
 
-  soff = flip_index(0, 0);
-  cstep = flip_index(0, 1) - soff;
-  rstep = flip_index(1, 0) - flip_index(0, S.width);
+  int twidth, theight;
+  output_target_size(w, h, &twidth, &theight);
+  if (twidth != w || theight != h)
+  {
+    /* resampled output: bands of rows are processed in parallel */
+    mem_image_sink_t ctx = {(uchar *)scan0, stride, twidth, bgr,
+                            P1.colors, O.output_bps, imgdata.color.curve};
+    const int band = 64;
+    int failed = 0;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int y0 = 0; y0 < theight; y0 += band)
+      if (output_resampled_rows(soff, cstep, rstep, w, h, twidth, theight, y0,
+                                MIN(y0 + band, theight), mem_image_sink,
+                                &ctx))
+      {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic
+#endif
+        failed++;
+      }
+    return failed ? LIBRAW_UNSUFFICIENT_MEMORY : 0;
+  }
+
+  if (libraw_internal_data.output_data.fused.active)
+  {
+    /* convert each output row into row buffer, then apply curve */
+    const int nc = P1.colors;
+    const int bps = O.output_bps;
+    const ushort *curve = imgdata.color.curve;
+    int failed = 0;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel
+#endif
+    {
+      ushort(*buf)[4] = (ushort(*)[4])::malloc(w * sizeof(*buf));
+      if (buf)
+      {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int r = 0; r < h; r++)
+        {
+          fused_output_row(soff + r * (rstep + w * cstep), cstep, w, buf);
+          uchar *bufp = ((uchar *)scan0) + size_t(r) * stride;
+          ushort *bufp2 = (ushort *)bufp;
+          for (int cc = 0; cc < w; cc++)
+            for (int k = 0; k < nc; k++)
+            {
+              int ch = bgr ? nc - 1 - k : k;
+              if (bps == 8)
+                *bufp++ = curve[buf[cc][ch]] >> 8;
+              else
+                *bufp2++ = curve[buf[cc][ch]];
+            }
+        }
+      }
+      else
+      {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic
+#endif
+        failed++;
+      }
+      ::free(buf);
+    }
+    return failed ? LIBRAW_UNSUFFICIENT_MEMORY : 0;
+  }
 
-  for (row = 0; row < S.height; row++, soff += rstep)
+  for (row = 0; row < h; row++, soff += rstep)
   {
-    uchar *bufp = ((uchar *)scan0) + row * stride;
+    uchar *bufp = ((uchar *)scan0) + size_t(row) * stride;
     ppm2 = (ushort *)(ppm = bufp);
     // keep trivial decisions in the outer loop for speed
     if (bgr)
     {
       if (O.output_bps == 8)
       {
-        for (col = 0; col < S.width; col++, soff += cstep)
+        for (col = 0; col < w; col++, soff += cstep)
           FORBGR *ppm++ = imgdata.color.curve[imgdata.image[soff][c]] >> 8;
       }
       else
       {
-        for (col = 0; col < S.width; col++, soff += cstep)
+        for (col = 0; col < w; col++, soff += cstep)
           FORBGR *ppm2++ = imgdata.color.curve[imgdata.image[soff][c]];
       }
     }
@@ -251,12 +369,12 @@ int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
     {
       if (O.output_bps == 8)
       {
-        for (col = 0; col < S.width; col++, soff += cstep)
+        for (col = 0; col < w; col++, soff += cstep)
           FORRGB *ppm++ = imgdata.color.curve[imgdata.image[soff][c]] >> 8;
       }
       else
       {
-        for (col = 0; col < S.width; col++, soff += cstep)
+        for (col = 0; col < w; col++, soff += cstep)
           FORRGB *ppm2++ = imgdata.color.curve[imgdata.image[soff][c]];
       }
     }
@@ -264,11 +382,6 @@ int LibRaw::copy_mem_image(void *scan0, int stride, int bgr)
     //            bufp += stride;           // go to the next line
   }
 
-  S.iheight = s_iheight;
-  S.iwidth = s_iwidth;
-  S.width = s_width;
-  S.height = s_hwight;
-
   return 0;
 }
 #undef FORBGR
@@ -280,9 +393,16 @@ libraw_processed_image_t *LibRaw::dcraw_make_mem_image(int *errcode)
   int width, height, colors, bps;
   get_mem_image_format(&width, &height, &colors, &bps);
   int stride = width * (bps / 8) * colors;
-  unsigned ds = height * stride;
+  INT64 ds = INT64(height) * stride;
+  if (width > 65535 || height > 65535 ||
+      ds > INT64(0xffffffffU) - INT64(sizeof(libraw_processed_image_t)))
+  {
+    if (errcode)
+      *errcode = LIBRAW_TOO_BIG;
+    return NULL;
+  }
   libraw_processed_image_t *ret = (libraw_processed_image_t *)::malloc(
-      sizeof(libraw_processed_image_t) + ds);
+      sizeof(libraw_processed_image_t) + size_t(ds));
   if (!ret)
   {
     if (errcode)
@@ -297,10 +417,470 @@ libraw_processed_image_t *LibRaw::dcraw_make_mem_image(int *errcode)
   ret->width = width;
   ret->colors = colors;
   ret->bits = bps;
+  ret->data_size = unsigned(ds);
+  int rc = copy_mem_image(ret->data, stride, 0);
+  if (rc != LIBRAW_SUCCESS)
+  {
+    ::free(ret);
+    if (errcode)
+      *errcode = rc;
+    return NULL;
+  }
+
+  return ret;
+}
+
+/*
+   Quick 8-bit RGB preview of raw_image rows decoded so far (may be called
+   from rows_cb during unpack()): each scale x scale block of visible area
+   is averaged per CFA channel, black subtracted, white balanced (camera
+   RGB, no color matrix) and gamma corrected. Output rows not covered by
+   raw_rows_ready() are left black.
+ */
+libraw_processed_image_t *LibRaw::make_mem_rows_preview(int scale,
+                                                        int *errcode)
+{
+  const ushort *raw = imgdata.rawdata.raw_image;
+  if (!raw || !(P1.filters || P1.colors == 1))
+  {
+    if (errcode)
+      *errcode = (imgdata.rawdata.raw_alloc || imgdata.rawdata.float_image)
+                     ? LIBRAW_NOT_IMPLEMENTED
+                     : LIBRAW_OUT_OF_ORDER_CALL;
+    return NULL;
+  }
+  /* after unpack() imgdata.sizes/color may be changed by processing */
+  const bool unpacked = (imgdata.progress_flags & LIBRAW_PROGRESS_LOAD_RAW) != 0;
+  const libraw_image_sizes_t &rs = unpacked ? imgdata.rawdata.sizes : S;
+  const libraw_colordata_t &rc = unpacked ? imgdata.rawdata.color : C;
+  const unsigned filters = unpacked ? imgdata.rawdata.iparams.filters : P1.filters;
+  const int colors = unpacked ? imgdata.rawdata.iparams.colors : P1.colors;
+
+  /* block should contain whole CFA period: 2 for bayer, 3 for X-Trans */
+  if (scale < 1)
+    scale = 1;
+  if (filters == 9)
+    scale = (scale + 2) / 3 * 3;
+  else if (filters)
+    scale = (scale + 1) & ~1;
+
+  const int top = rs.top_margin, left = rs.left_margin;
+  const int vh = MIN(int(rs.height), int(rs.raw_height) - top);
+  const int vw = MIN(int(rs.width), int(rs.raw_width) - left);
+  const int oh = vh > 0 ? vh / scale : 0;
+  const int ow = vw > 0 ? vw / scale : 0;
+  if (oh < 1 || ow < 1)
+  {
+    if (errcode)
+      *errcode = EINVAL;
+    return NULL;
+  }
+  const unsigned ready = raw_rows_ready();
+  const int done = int(ready) > top ? MIN(oh, (int(ready) - top) / scale) : 0;
+
+  unsigned ds = unsigned(oh) * unsigned(ow) * 3;
+  libraw_processed_image_t *ret = (libraw_processed_image_t *)::malloc(
+      sizeof(libraw_processed_image_t) + ds);
+  if (!ret)
+  {
+    if (errcode)
+      *errcode = ENOMEM;
+    return NULL;
+  }
+  memset(ret, 0, sizeof(libraw_processed_image_t) + ds);
+  ret->type = LIBRAW_IMAGE_BITMAP;
+  ret->height = oh;
+  ret->width = ow;
+  ret->colors = 3;
+  ret->bits = 8;
   ret->data_size = ds;
-  copy_mem_image(ret->data, stride, 0);
 
+  /* CFA channel of visible (row,col), period divides 48 */
+  uchar cfa[48][48];
+  for (int r = 0; r < 48; r++)
+    for (int c = 0; c < 48; c++)
+      cfa[r][c] = filters == 9 ? imgdata.idata.xtrans[r % 6][c % 6] & 3
+                  : filters >= 1000
+                      ? filters >> ((((r << 1) & 14) | (c & 1)) << 1) & 3
+                  : filters ? fcol(r, c) & 3
+                            : 0;
+
+  /* per channel black and scale to 0..65535 with white balance */
+  const float *cm = (rc.cam_mul[0] > 0.f && rc.cam_mul[1] > 0.f &&
+                     rc.cam_mul[2] > 0.f)
+                        ? rc.cam_mul
+                        : rc.pre_mul;
+  float mul[4], black[4];
+  for (int c = 0; c < 4; c++)
+  {
+    float m = (c == 3 && cm[3] > 0.f) ? cm[3] : cm[c == 3 ? 1 : c];
+    float wb =
+        (colors == 1 || !(m > 0.f) || !(cm[1] > 0.f)) ? 1.f : m / cm[1];
+    black[c] = float(rc.black + rc.cblack[c]);
+    mul[c] = wb * 65535.f / MAX(float(rc.maximum) - black[c], 1.f);
+  }
+  const float *gamma = LibRaw_tables::aahd_gamma();
+  const size_t pitch = rs.raw_pitch / 2;
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int oy = 0; oy < done; oy++)
+  {
+    uchar *out = ret->data + size_t(oy) * ow * 3;
+    for (int ox = 0; ox < ow; ox++, out += 3)
+    {
+      float sum[4] = {0.f, 0.f, 0.f, 0.f};
+      int cnt[4] = {0, 0, 0, 0};
+      for (int y = oy * scale; y < (oy + 1) * scale; y++)
+      {
+        const ushort *src = raw + size_t(y + top) * pitch + left;
+        const uchar *cr = cfa[y % 48];
+        for (int x = ox * scale; x < (ox + 1) * scale; x++)
+        {
+          int c = cr[x % 48];
+          float v = float(src[x]) - black[c];
+          sum[c] += (v > 0.f ? v : 0.f) * mul[c];
+          cnt[c]++;
+        }
+      }
+      float rgb[3];
+      float g =
+          cnt[1] + cnt[3] ? (sum[1] + sum[3]) / float(cnt[1] + cnt[3]) : 0.f;
+      if (colors == 1 || !filters)
+        rgb[0] = rgb[1] = rgb[2] = cnt[0] ? sum[0] / cnt[0] : 0.f;
+      else
+      {
+        rgb[1] = g;
+        rgb[0] = cnt[0] ? sum[0] / cnt[0] : g;
+        rgb[2] = cnt[2] ? sum[2] / cnt[2] : g;
+      }
+      for (int c = 0; c < 3; c++)
+      {
+        int v = int(MIN(rgb[c], 65535.f));
+        out[c] = uchar(MIN(int(gamma[v]) >> 8, 255));
+      }
+    }
+  }
+  return ret;
+}
+
+#ifndef NO_JPEG
+static void jpegErrorExit_m(j_common_ptr /*cinfo*/)
+{
+  throw LIBRAW_EXCEPTION_ALLOC;
+}
+
+struct mem_jpeg_sink_t
+{
+  j_compress_ptr cinfo;
+  JSAMPLE *row;
+  int width, colors;
+  const ushort *curve;
+};
+
+/*
+   Growing memory destination. Unlike jpeg_mem_dest(), current buffer is
+   always stored here, so it may be freed after jpeg_abort_compress().
+ */
+struct mem_jpeg_dest_t
+{
+  struct jpeg_destination_mgr pub;
+  unsigned char *buf;
+  size_t size; /* allocated */
+  size_t used; /* set by term_destination() */
+};
+
+static boolean mem_jpeg_empty_output_buffer(j_compress_ptr cinfo)
+{
+  mem_jpeg_dest_t *d = (mem_jpeg_dest_t *)cinfo->dest;
+  const size_t nsize = d->size ? d->size * 2 : 65536;
+  unsigned char *nbuf = (unsigned char *)::realloc(d->buf, nsize);
+  if (!nbuf)
+    throw LIBRAW_EXCEPTION_ALLOC; /* d->buf is still valid */
+  d->pub.next_output_byte = nbuf + d->size;
+  d->pub.free_in_buffer = nsize - d->size;
+  d->buf = nbuf;
+  d->size = nsize;
+  return TRUE;
+}
+
+/* libjpeg writes a byte before checking free space: buffer is allocated
+   before the first write */
+static void mem_jpeg_init_destination(j_compress_ptr cinfo)
+{
+  mem_jpeg_dest_t *d = (mem_jpeg_dest_t *)cinfo->dest;
+  d->used = 0;
+  if (!d->buf)
+    mem_jpeg_empty_output_buffer(cinfo);
+  else
+  {
+    d->pub.next_output_byte = d->buf;
+    d->pub.free_in_buffer = d->size;
+  }
+}
+
+static void mem_jpeg_term_destination(j_compress_ptr cinfo)
+{
+  mem_jpeg_dest_t *d = (mem_jpeg_dest_t *)cinfo->dest;
+  d->used = d->size - d->pub.free_in_buffer;
+}
+
+static void mem_jpeg_dest(j_compress_ptr cinfo, mem_jpeg_dest_t *d)
+{
+  d->pub.init_destination = mem_jpeg_init_destination;
+  d->pub.empty_output_buffer = mem_jpeg_empty_output_buffer;
+  d->pub.term_destination = mem_jpeg_term_destination;
+  cinfo->dest = &d->pub;
+}
+
+static void mem_jpeg_sink(void *ctx, int /*row*/, const ushort (*data)[4])
+{
+  const mem_jpeg_sink_t &j = *(const mem_jpeg_sink_t *)ctx;
+  JSAMPLE *p = j.row;
+  for (int col = 0; col < j.width; col++)
+    for (int c = 0; c < j.colors; c++)
+      *p++ = j.curve[data[col][c]] >> 8;
+  JSAMPROW rp[1] = {j.row};
+  jpeg_write_scanlines(j.cinfo, rp, 1);
+}
+
+/* Offset of entropy-coded data (after SOS segment), 0 if not found */
+static size_t jpeg_scan_data(const uchar *d, size_t len, size_t *sof)
+{
+  if (len < 4 || d[0] != 0xFF || d[1] != 0xD8)
+    return 0;
+  size_t pos = 2;
+  while (pos + 4 <= len)
+  {
+    if (d[pos] != 0xFF)
+      return 0;
+    uchar m = d[pos + 1];
+    if (m == 0xFF)
+    {
+      pos++;
+      continue;
+    }
+    size_t l = (size_t(d[pos + 2]) << 8) | d[pos + 3];
+    if (m == 0xC0 && sof)
+      *sof = pos;
+    if (m == 0xDA)
+      return pos + 2 + l <= len ? pos + 2 + l : 0;
+    pos += 2 + l;
+  }
+  return 0;
+}
+#endif
+
+/*
+   Processed image as baseline JPEG. Output rows are split into strips of
+   LIBRAW_MEMJPEG_STRIP_MCUROWS MCU rows, each strip is one restart interval
+   and is encoded by separate compressor (in parallel with OpenMP).
+   Strips use the same tables, so their entropy-coded data is joined with
+   RSTn markers into a single JPEG stream.
+ */
+libraw_processed_image_t *LibRaw::dcraw_make_mem_jpeg(int quality,
+                                                      int *errcode)
+{
+#ifdef NO_JPEG
+  if (errcode)
+    *errcode = LIBRAW_NOT_IMPLEMENTED;
+  return NULL;
+#else
+  if ((imgdata.progress_flags & LIBRAW_PROGRESS_THUMB_MASK) <
+      LIBRAW_PROGRESS_PRE_INTERPOLATE)
+  {
+    if (errcode)
+      *errcode = LIBRAW_OUT_OF_ORDER_CALL;
+    return NULL;
+  }
+  const int nc = P1.colors;
+  if ((nc != 1 && nc != 3) || !imgdata.image)
+  {
+    if (errcode)
+      *errcode = LIBRAW_NOT_IMPLEMENTED;
+    return NULL;
+  }
+
+  mem_image_gamma_curve();
+
+  int soff0, cstep, rstep, sw, sh, w, h;
+  mem_image_geometry(&soff0, &cstep, &rstep, &sw, &sh);
+  output_target_size(sw, sh, &w, &h);
+  const bool resample = w != sw || h != sh;
+  if (w > 65500 || h > 65500)
+  {
+    if (errcode)
+      *errcode = LIBRAW_NOT_IMPLEMENTED;
+    return NULL;
+  }
+
+  /* default sampling: 2x2 for YCbCr, single 8x8 block for grayscale */
+  const int mcu = nc == 3 ? 16 : 8;
+  const int mcus_per_row = (w + mcu - 1) / mcu;
+  const int strip_mcurows =
+      MAX(1, MIN(LIBRAW_MEMJPEG_STRIP_MCUROWS, 65535 / mcus_per_row));
+  const int strip_rows = strip_mcurows * mcu;
+  const int strips = (h + strip_rows - 1) / strip_rows;
+  const bool fused = libraw_internal_data.output_data.fused.active != 0;
+  const ushort *curve = imgdata.color.curve;
+
+  /* encoded strips, buffers are owned here */
+  std::vector<mem_jpeg_dest_t> dest(strips);
+  memset(dest.data(), 0, dest.size() * sizeof(dest[0]));
+  int errors = 0;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel shared(errors)
+#endif
+  {
+    /* one compressor per thread */
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr pub;
+    cinfo.err = jpeg_std_error(&pub);
+    pub.error_exit = jpegErrorExit_m;
+    int created = 0;
+    try
+    {
+      jpeg_create_compress(&cinfo);
+      created = 1;
+    }
+    catch (...)
+    {
+    }
+    JSAMPLE *row = (JSAMPLE *)::malloc(size_t(w) * nc);
+    ushort(*fbuf)[4] =
+        fused ? (ushort(*)[4])::malloc(size_t(w) * sizeof(*fbuf)) : 0;
+    if (!created || !row || (fused && !fbuf))
+    {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic
+#endif
+      errors++;
+    }
+
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int s = 0; s < strips; s++)
+    {
+      int failed;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic read
+#endif
+      failed = errors;
+      if (failed)
+        continue;
+      try
+      {
+        const int r0 = s * strip_rows, rows = MIN(strip_rows, h - r0);
+        mem_jpeg_dest(&cinfo, &dest[s]);
+        cinfo.image_width = w;
+        cinfo.image_height = rows;
+        cinfo.input_components = nc;
+        cinfo.in_color_space = nc == 3 ? JCS_RGB : JCS_GRAYSCALE;
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, quality, TRUE);
+        cinfo.restart_interval = strip_mcurows * mcus_per_row;
+        jpeg_start_compress(&cinfo, TRUE);
+        JSAMPROW rp[1] = {row};
+        if (resample)
+        {
+          mem_jpeg_sink_t js = {&cinfo, row, w, nc, curve};
+          if (output_resampled_rows(soff0, cstep, rstep, sw, sh, w, h, r0,
+                                    r0 + rows, mem_jpeg_sink, &js))
+            throw LIBRAW_EXCEPTION_ALLOC;
+        }
+        else
+        {
+          for (int r = r0; r < r0 + rows; r++)
+          {
+            int soff = soff0 + r * (rstep + w * cstep);
+            JSAMPLE *p = row;
+            if (fused)
+            {
+              fused_output_row(soff, cstep, w, fbuf);
+              for (int col = 0; col < w; col++)
+                for (int c = 0; c < nc; c++)
+                  *p++ = curve[fbuf[col][c]] >> 8;
+            }
+            else
+              for (int col = 0; col < w; col++, soff += cstep)
+                for (int c = 0; c < nc; c++)
+                  *p++ = curve[imgdata.image[soff][c]] >> 8;
+            jpeg_write_scanlines(&cinfo, rp, 1);
+          }
+        }
+        jpeg_finish_compress(&cinfo);
+      }
+      catch (...)
+      {
+        jpeg_abort_compress(&cinfo);
+        ::free(dest[s].buf);
+        dest[s].buf = 0;
+        dest[s].size = dest[s].used = 0;
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp atomic
+#endif
+        errors++;
+      }
+    }
+    if (created)
+      jpeg_destroy_compress(&cinfo);
+    ::free(fbuf);
+    ::free(row);
+  }
+
+  /* header of first strip with full image height, then entropy-coded data
+     of all strips separated by RSTn markers */
+  size_t sof = 0, hdr = 0, total = 0;
+  std::vector<size_t> scan(strips, 0);
+  for (int s = 0; s < strips && !errors; s++)
+  {
+    scan[s] = jpeg_scan_data(dest[s].buf, dest[s].used, s ? 0 : &sof);
+    if (!scan[s] || dest[s].used < scan[s] + 2 || (!s && !sof))
+      errors++;
+    else
+      total += dest[s].used - 2 - scan[s] + (s ? 2 : scan[s]);
+  }
+  libraw_processed_image_t *ret = 0;
+  if (!errors)
+    ret = (libraw_processed_image_t *)::malloc(
+        sizeof(libraw_processed_image_t) + total + 2);
+  if (ret)
+  {
+    memset(ret, 0, sizeof(libraw_processed_image_t));
+    ret->type = LIBRAW_IMAGE_JPEG;
+    ret->height = h;
+    ret->width = w;
+    ret->colors = nc;
+    ret->bits = 8;
+    ret->data_size = unsigned(total + 2);
+    uchar *d = ret->data;
+    hdr = scan[0];
+    memmove(d, dest[0].buf, hdr);
+    d[sof + 5] = uchar(h >> 8);
+    d[sof + 6] = uchar(h & 0xff);
+    d += hdr;
+    for (int s = 0; s < strips; s++)
+    {
+      if (s)
+      {
+        *d++ = 0xFF;
+        *d++ = uchar(0xD0 + ((s - 1) & 7));
+      }
+      size_t len = dest[s].used - 2 - scan[s];
+      memmove(d, dest[s].buf + scan[s], len);
+      d += len;
+    }
+    *d++ = 0xFF;
+    *d++ = 0xD9;
+  }
+  for (int s = 0; s < strips; s++)
+    ::free(dest[s].buf);
+  if (!ret && errcode)
+    *errcode = errors ? LIBRAW_UNSPECIFIED_ERROR : ENOMEM;
   return ret;
+#endif
 }
 
 void LibRaw::dcraw_clear_mem(libraw_processed_image_t *p)
@@ -0,0 +1,217 @@
+/* -*- C++ -*-
+ * Copyright 2019-2024 LibRaw LLC (info@libraw.org)
+ *
+ * Output size (imgdata.params.output_width/output_height): separable
+ * Lanczos3/Mitchell resampler applied by memory output functions between
+ * flip/color conversion and gamma curve.
+
+ LibRaw is free software; you can redistribute it and/or modify
+ it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+
+#include "../../internal/libraw_cxx_defs.h"
+
+namespace
+{
+float lanczos3(float x)
+{
+  x = fabsf(x);
+  if (x < 1e-6f)
+    return 1.f;
+  if (x >= 3.f)
+    return 0.f;
+  float px = float(M_PI) * x;
+  return 3.f * sinf(px) * sinf(px / 3.f) / (px * px);
+}
+
+/* Mitchell-Netravali, B = C = 1/3 */
+float mitchell(float x)
+{
+  x = fabsf(x);
+  if (x < 1.f)
+    return (7.f * x * x * x - 12.f * x * x + 16.f / 3.f) / 6.f;
+  if (x < 2.f)
+    return (-7.f / 3.f * x * x * x + 12.f * x * x - 20.f * x + 32.f / 3.f) /
+           6.f;
+  return 0.f;
+}
+
+/* Filter taps for each output pixel: source pixels [start, start+count),
+   normalized weights at w[i*taps] */
+struct resample_axis_t
+{
+  int taps;
+  std::vector<int> start, count;
+  std::vector<float> w;
+
+  resample_axis_t(int src, int dst, int filter)
+  {
+    float (*kernel)(float) = filter == LIBRAW_RESAMPLE_MITCHELL ? mitchell
+                                                                : lanczos3;
+    float radius = filter == LIBRAW_RESAMPLE_MITCHELL ? 2.f : 3.f;
+    float scale = float(src) / float(dst);
+    float fs = MAX(scale, 1.f); /* kernel is widened when downscaling */
+    float support = radius * fs;
+    taps = int(ceilf(support)) * 2 + 1;
+    start.resize(dst);
+    count.resize(dst);
+    w.assign(size_t(dst) * taps, 0.f);
+    for (int i = 0; i < dst; i++)
+    {
+      float center = (i + 0.5f) * scale - 0.5f;
+      int lo = int(ceilf(center - support));
+      int hi = int(floorf(center + support));
+      if (hi - lo + 1 > taps)
+        hi = lo + taps - 1;
+      /* out of image taps are folded into edge pixels */
+      int s0 = LIM(lo, 0, src - 1), s1 = LIM(hi, 0, src - 1);
+      float *wi = &w[size_t(i) * taps];
+      float sum = 0.f;
+      for (int j = lo; j <= hi; j++)
+      {
+        float k = kernel((j - center) / fs);
+        wi[LIM(j, 0, src - 1) - s0] += k;
+        sum += k;
+      }
+      if (sum != 0.f)
+        for (int j = 0; j <= s1 - s0; j++)
+          wi[j] /= sum;
+      start[i] = s0;
+      count[i] = s1 - s0 + 1;
+    }
+  }
+};
+} // namespace
+
+/* Output size for full size width x height (after flip); limited to 65535
+   as libraw_processed_image_t dimensions */
+void LibRaw::output_target_size(int width, int height, int *twidth,
+                                int *theight) const
+{
+  INT64 tw = MIN(O.output_width, 65535), th = MIN(O.output_height, 65535);
+  if (tw <= 0 && th <= 0)
+  {
+    tw = width;
+    th = height;
+  }
+  else if (th <= 0)
+    th = MAX(1, (INT64(height) * tw * 2 / width + 1) / 2);
+  else if (tw <= 0)
+    tw = MAX(1, (INT64(width) * th * 2 / height + 1) / 2);
+  *twidth = int(MIN(tw, 65535));
+  *theight = int(MIN(th, 65535));
+}
+
+/* Non-zero if output size is at most half of image size and caller allows
+   it (LIBRAW_OUTPUT_FLAGS_AUTO_HALFSIZE): dcraw_process() uses half_size
+   mode then */
+int LibRaw::output_auto_half()
+{
+  if (!(O.output_flags & LIBRAW_OUTPUT_FLAGS_AUTO_HALFSIZE) ||
+      (O.output_width <= 0 && O.output_height <= 0))
+    return 0;
+  const libraw_image_sizes_t &rs = imgdata.rawdata.sizes;
+  if (!imgdata.rawdata.iparams.filters || !rs.width || !rs.height)
+    return 0;
+  int flip = O.user_flip >= 0 ? O.user_flip : rs.flip;
+  int w = rs.width, h = rs.height;
+  if (flip & 4)
+    SWAP(w, h);
+  int tw, th;
+  output_target_size(w, h, &tw, &th);
+  return tw * 2 <= w && th * 2 <= h;
+}
+
+/* Output color space pixels (before gamma curve) along flip path */
+void LibRaw::output_row_linear(int soff, int cstep, int count,
+                               ushort (*out)[4])
+{
+  if (libraw_internal_data.output_data.fused.active)
+    fused_output_row(soff, cstep, count, out);
+  else
+    for (int col = 0; col < count; col++, soff += cstep)
+      memmove(out[col], imgdata.image[soff], sizeof(*out));
+}
+
+/*
+   Resampled output rows [y0, y1) of twidth x theight image, passed to sink
+   in row order. Source is width x height output image (after flip, soff,
+   cstep and rstep as in copy_mem_image()). Source rows are filtered
+   horizontally once and kept in ring buffer for vertical pass, so rows
+   ranges may be processed by different threads.
+   Returns non-zero on allocation failure.
+ */
+int LibRaw::output_resampled_rows(
+    int soff, int cstep, int rstep, int width, int height, int twidth,
+    int theight, int y0, int y1,
+    void (*sink)(void *ctx, int row, const ushort (*data)[4]), void *ctx)
+{
+  try
+  {
+    const int filter = O.output_resample;
+    resample_axis_t ax(width, twidth, filter), ay(height, theight, filter);
+    const int nc = MIN(int(P1.colors), 4);
+    const int ring = ay.taps;
+    std::vector<ushort> src(size_t(width) * 4);
+    std::vector<float> hrows(size_t(ring) * twidth * 4);
+    std::vector<int> slot_row(ring, -1);
+    std::vector<ushort> out(size_t(twidth) * 4, 0);
+    ushort(*srow)[4] = (ushort(*)[4])src.data();
+    ushort(*orow)[4] = (ushort(*)[4])out.data();
+
+    for (int y = y0; y < y1; y++)
+    {
+      const int ys = ay.start[y], yc = ay.count[y];
+      for (int k = 0; k < yc; k++)
+      {
+        int r = ys + k;
+        float *hr = &hrows[size_t(r % ring) * twidth * 4];
+        if (slot_row[r % ring] == r)
+          continue;
+        output_row_linear(soff + r * (rstep + width * cstep), cstep, width,
+                          srow);
+        for (int x = 0; x < twidth; x++)
+        {
+          const float *wx = &ax.w[size_t(x) * ax.taps];
+          const ushort(*sp)[4] = srow + ax.start[x];
+          float acc[4] = {0.f, 0.f, 0.f, 0.f};
+          for (int j = 0; j < ax.count[x]; j++)
+            for (int c = 0; c < nc; c++)
+              acc[c] += wx[j] * sp[j][c];
+          for (int c = 0; c < 4; c++)
+            hr[x * 4 + c] = acc[c];
+        }
+        slot_row[r % ring] = r;
+      }
+
+      const float *wy = &ay.w[size_t(y) * ay.taps];
+      for (int x = 0; x < twidth; x++)
+      {
+        float acc[4] = {0.f, 0.f, 0.f, 0.f};
+        for (int k = 0; k < yc; k++)
+        {
+          const float *hr = &hrows[(size_t((ys + k) % ring) * twidth + x) * 4];
+          for (int c = 0; c < nc; c++)
+            acc[c] += wy[k] * hr[c];
+        }
+        for (int c = 0; c < nc; c++)
+          orow[x][c] = ushort(acc[c] <= 0.f       ? 0
+                              : acc[c] >= 65535.f ? 65535
+                                                  : int(acc[c] + 0.5f));
+      }
+      sink(ctx, y, orow);
+    }
+  }
+  catch (...)
+  {
+    return 1;
+  }
+  return 0;
+}
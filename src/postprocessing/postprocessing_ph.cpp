@@ -22,10 +22,18 @@ int LibRaw::dcraw_process(void)
 }
 
 void LibRaw::fuji_rotate() {}
+void LibRaw::free_render_cache() {}
+void LibRaw::fused_output_reset() {}
+void LibRaw::fused_output_histogram() {}
+void LibRaw::fused_output_row(int, int, int, ushort (*)[4]) {}
 void LibRaw::convert_to_rgb_loop(float /*out_cam*/ [3][4]) {}
 libraw_processed_image_t *LibRaw::dcraw_make_mem_image(int *) {
   return NULL;
 }
 libraw_processed_image_t *LibRaw::dcraw_make_mem_thumb(int *){ return NULL;}
+libraw_processed_image_t *LibRaw::dcraw_make_mem_jpeg(int, int *)
+{
+  return NULL;
+}
 void LibRaw::lin_interpolate_loop(int * /*code*/, int /*size*/) {}
 void LibRaw::scale_colors_loop(float /*scale_mul*/[4]) {}
@@ -100,7 +100,10 @@ void LibRaw::convert_to_rgb()
         for (out_cam[i][j] = 0.f, k = 0; k < 3; k++)
           out_cam[i][j] += float(out_rgb[output_color - 1][i][k] * rgb_cam[k][j]);
   }
-  convert_to_rgb_loop(out_cam);
+  if (imgdata.params.fused_output)
+    fused_output_init(out_cam); /* converted by output functions */
+  else
+    convert_to_rgb_loop(out_cam);
 
   if (colors == 4 && output_color)
     colors = 3;
@@ -0,0 +1,227 @@
+/* -*- C++ -*-
+ * Copyright 2019-2024 LibRaw LLC (info@libraw.org)
+ *
+ * dcraw_process() stage memoization: image and processing state are kept
+ * after black subtraction, demosaic and highlights processing; next call
+ * restarts from the deepest stage whose parameters are not changed.
+
+ LibRaw is free software; you can redistribute it and/or modify
+ it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+
+#include "../../internal/libraw_cxx_defs.h"
+
+/* Parameters and callbacks used by processing up to the stage (inclusive) */
+struct libraw_render_key_t
+{
+  libraw_output_params_t params;
+  unsigned names_hash; /* bad_pixels/dark_frame file names */
+  process_step_callback cb[7];
+};
+
+struct libraw_render_stage_t
+{
+  libraw_render_key_t key;
+  ushort (*image)[4];
+  size_t pixels;
+  libraw_iparams_t idata;
+  libraw_image_sizes_t sizes;
+  libraw_colordata_t color;
+  libraw_internal_output_params_t ioparams;
+  unsigned progress_flags, process_warnings;
+};
+
+namespace
+{
+int stage_index(int stage)
+{
+  return stage == LIBRAW_RENDERCACHE_POSTBLACK      ? 0
+         : stage == LIBRAW_RENDERCACHE_POSTDEMOSAIC ? 1
+                                                    : 2;
+}
+
+unsigned hash_name(unsigned h, const char *s)
+{
+  if (!s)
+    return h * 31;
+  for (; *s; s++)
+    h = (h ^ uchar(*s)) * 16777619U;
+  return (h ^ 0xff) * 16777619U;
+}
+
+void make_render_key(int stage, const libraw_output_params_t &params,
+                     const libraw_callbacks_t &callbacks,
+                     libraw_render_key_t &k)
+{
+  memset(&k, 0, sizeof(k));
+  memmove(&k.params, &params, sizeof(k.params));
+  libraw_output_params_t &p = k.params;
+
+  k.names_hash = hash_name(hash_name(2166136261U, p.bad_pixels), p.dark_frame);
+  p.bad_pixels = p.dark_frame = 0;
+  p.render_cache = 0;
+
+  /* output stage: convert_to_rgb() and image writers */
+  memset(p.gamm, 0, sizeof(p.gamm));
+  p.bright = 0;
+  p.output_color = 0;
+  p.output_profile = p.camera_profile = 0;
+  p.output_bps = p.output_tiff = p.output_flags = 0;
+  p.fused_output = 0;
+  p.output_width = p.output_height = p.output_resample = 0;
+  p.user_flip = 0;
+  p.auto_bright_thr = 0;
+  p.no_auto_bright = 0;
+  p.use_camera_matrix = 0; /* used by identify() only */
+
+  k.cb[0] = callbacks.pre_subtractblack_cb;
+  k.cb[1] = callbacks.pre_scalecolors_cb;
+  k.cb[2] = callbacks.pre_preinterpolate_cb;
+  k.cb[3] = callbacks.pre_interpolate_cb;
+  k.cb[4] = callbacks.interpolate_bayer_cb;
+  k.cb[5] = callbacks.interpolate_xtrans_cb;
+  k.cb[6] = callbacks.post_interpolate_cb;
+  if (stage == LIBRAW_RENDERCACHE_POSTHIGHLIGHTS)
+    return;
+
+  /* median filter, highlights, Fuji rotate; scale_colors() only checks
+     if highlights mode is set */
+  p.med_passes = 0;
+  p.use_fuji_rotate = 0;
+  p.highlight = p.highlight != 0;
+  k.cb[6] = 0;
+  if (stage == LIBRAW_RENDERCACHE_POSTDEMOSAIC)
+    return;
+
+  /* white balance, scaling, pre-interpolation and demosaic */
+  memset(p.greybox, 0, sizeof(p.greybox));
+  memset(p.user_mul, 0, sizeof(p.user_mul));
+  p.use_auto_wb = p.use_camera_wb = 0;
+  p.green_matching = 0;
+  p.no_auto_scale = 0;
+  p.highlight = 0;
+  p.user_qual = 0;
+  p.dcb_iterations = p.dcb_enhance_fl = p.fbdd_noiserd = 0;
+  p.exp_correc = 0;
+  p.exp_shift = p.exp_preser = 0;
+  p.no_interpolation = 0;
+  for (int i = 1; i < 6; i++)
+    k.cb[i] = 0;
+}
+} // namespace
+
+void LibRaw::free_render_cache()
+{
+  render_cache_t &rc = libraw_internal_data.render_cache;
+  for (int i = 0; i < LIBRAW_RENDERCACHE_STAGES; i++)
+    if (rc.stage[i])
+    {
+      libraw_render_stage_t *st = (libraw_render_stage_t *)rc.stage[i];
+      free(st->image);
+      free(st);
+    }
+  memset(&rc, 0, sizeof(rc));
+}
+
+/* Copies current image and state into stage slot, if this stage is enabled
+   by imgdata.params.render_cache */
+void LibRaw::render_cache_store(int stage)
+{
+  render_cache_t &rc = libraw_internal_data.render_cache;
+  int idx = stage_index(stage);
+  libraw_render_stage_t *st = (libraw_render_stage_t *)rc.stage[idx];
+  if (!(O.render_cache & stage) || !imgdata.image ||
+      /* Fuji cropped layout does not follow iwidth */
+      (stage == LIBRAW_RENDERCACHE_POSTBLACK && IO.fuji_width &&
+       ~O.cropbox[2] && ~O.cropbox[3]))
+  {
+    if (st)
+    {
+      free(st->image);
+      free(st);
+      rc.stage[idx] = 0;
+    }
+    return;
+  }
+
+  /* before pre_interpolate() image is iheight x iwidth */
+  size_t pixels = stage == LIBRAW_RENDERCACHE_POSTBLACK
+                      ? size_t(S.iheight) * S.iwidth
+                      : size_t(S.height) * S.width;
+  if (!st)
+  {
+    st = (libraw_render_stage_t *)calloc(1, sizeof(*st));
+    rc.stage[idx] = st;
+  }
+  if (!st->image || st->pixels != pixels)
+  {
+    if (st->image)
+      free(st->image);
+    st->image = 0;
+    st->image = (ushort(*)[4])malloc(pixels * sizeof(*st->image));
+    st->pixels = pixels;
+  }
+  memmove(st->image, imgdata.image, pixels * sizeof(*st->image));
+  make_render_key(stage, O, callbacks, st->key);
+  st->idata = imgdata.idata;
+  st->sizes = imgdata.sizes;
+  st->color = imgdata.color;
+  st->ioparams = libraw_internal_data.internal_output_params;
+  st->progress_flags = imgdata.progress_flags;
+  st->process_warnings = imgdata.process_warnings;
+}
+
+/* Restores deepest enabled stage with unchanged parameters; returns its
+   LIBRAW_RENDERCACHE_* value or 0 if processing should start from scratch */
+int LibRaw::render_cache_restore()
+{
+  render_cache_t &rc = libraw_internal_data.render_cache;
+  for (int stage = LIBRAW_RENDERCACHE_POSTHIGHLIGHTS; stage; stage >>= 1)
+  {
+    libraw_render_stage_t *st =
+        (libraw_render_stage_t *)rc.stage[stage_index(stage)];
+    if (!st)
+      continue;
+    if (!(O.render_cache & stage))
+    {
+      free(st->image);
+      free(st);
+      rc.stage[stage_index(stage)] = 0;
+      continue;
+    }
+    libraw_render_key_t k;
+    make_render_key(stage, O, callbacks, k);
+    if (memcmp(&k, &st->key, sizeof(k)))
+      continue;
+
+    /* same allocation as raw2image_ex(): demosaic may read past the end */
+    size_t alloc = st->pixels;
+    if (stage == LIBRAW_RENDERCACHE_POSTBLACK)
+    {
+      int extra = st->idata.filters ? (st->idata.filters == 9 ? 6 : 2) : 0;
+      alloc = MAX(alloc, size_t(st->sizes.iheight + extra) *
+                             (st->sizes.iwidth + extra));
+    }
+    if (imgdata.image)
+      free(imgdata.image);
+    imgdata.image = (ushort(*)[4])calloc(alloc, sizeof(*imgdata.image));
+    memmove(imgdata.image, st->image, st->pixels * sizeof(*imgdata.image));
+    imgdata.idata = st->idata;
+    imgdata.sizes = st->sizes;
+    imgdata.color = st->color;
+    libraw_internal_data.internal_output_params = st->ioparams;
+    imgdata.progress_flags = st->progress_flags;
+    imgdata.process_warnings = st->process_warnings;
+    S.flip = imgdata.rawdata.sizes.flip;
+    apply_user_flip();
+    return stage;
+  }
+  return 0;
+}
@@ -0,0 +1,342 @@
+/* -*- C++ -*-
+ * Copyright 2019-2024 LibRaw LLC (info@libraw.org)
+ *
+ LibRaw uses code from dcraw.c -- Dave Coffin's raw photo decoder,
+ dcraw.c is copyright 1997-2018 by Dave Coffin, dcoffin a cybercom o net.
+ LibRaw do not use RESTRICTED code from dcraw.c
+
+ LibRaw is free software; you can redistribute it and/or modify
+ it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+
+#include "../../internal/libraw_cxx_defs.h"
+
+void LibRaw::bad_pixels(const libraw_bad_pixels_t *bp)
+{
+  int row, col, r, c, rad, tot, n;
+  const int width = S.width, height = S.height, shrink = IO.shrink,
+            iwidth = S.iwidth;
+
+  if (!imgdata.idata.filters)
+    return;
+  RUN_CALLBACK(LIBRAW_PROGRESS_BAD_PIXELS, 0, 2);
+  /* Serial: a fixed pixel is used as a neighbour by the following ones */
+  for (unsigned i = 0; i < bp->count; i++)
+  {
+    col = bp->pixels[i].col;
+    row = bp->pixels[i].row;
+    if ((unsigned)col >= (unsigned)width || (unsigned)row >= (unsigned)height)
+      continue;
+    if (bp->pixels[i].time > imgdata.other.timestamp)
+      continue;
+    for (tot = n = 0, rad = 1; rad < 3 && n == 0; rad++)
+      for (r = row - rad; r <= row + rad; r++)
+        for (c = col - rad; c <= col + rad; c++)
+          if ((unsigned)r < (unsigned)height && (unsigned)c < (unsigned)width &&
+              (r != row || c != col) && fcol(r, c) == fcol(row, col))
+          {
+            tot += imgdata.image[(r >> shrink) * iwidth + (c >> shrink)]
+                                [fcol(r, c)];
+            n++;
+          }
+    if (n > 0)
+      imgdata.image[(row >> shrink) * iwidth + (col >> shrink)]
+                   [fcol(row, col)] = tot / n;
+  }
+  RUN_CALLBACK(LIBRAW_PROGRESS_BAD_PIXELS, 1, 2);
+}
+
+int LibRaw::load_bad_pixels(libraw_bad_pixels_t *bp, const char *fname)
+{
+  FILE *fp;
+  char *cp, line[128];
+  int time, row, col;
+  unsigned alloc = 0;
+
+  if (!bp || !fname)
+    return LIBRAW_UNSPECIFIED_ERROR;
+  bp->count = 0;
+  bp->pixels = NULL;
+  if (!(fp = fopen(fname, "r")))
+    return LIBRAW_IO_ERROR;
+  while (fgets(line, 128, fp))
+  {
+    cp = strchr(line, '#');
+    if (cp)
+      *cp = 0;
+    if (sscanf(line, "%d %d %d", &col, &row, &time) != 3)
+      continue;
+    if (bp->count >= alloc)
+    {
+      alloc = alloc ? alloc * 2 : 256;
+      libraw_bad_pixel_t *np = (libraw_bad_pixel_t *)::realloc(
+          bp->pixels, alloc * sizeof(libraw_bad_pixel_t));
+      if (!np)
+      {
+        fclose(fp);
+        free_bad_pixels(bp);
+        return LIBRAW_UNSUFFICIENT_MEMORY;
+      }
+      bp->pixels = np;
+    }
+    bp->pixels[bp->count].col = col;
+    bp->pixels[bp->count].row = row;
+    bp->pixels[bp->count].time = time;
+    bp->count++;
+  }
+  fclose(fp);
+  return LIBRAW_SUCCESS;
+}
+
+void LibRaw::free_bad_pixels(libraw_bad_pixels_t *bp)
+{
+  if (!bp)
+    return;
+  ::free(bp->pixels);
+  bp->pixels = NULL;
+  bp->count = 0;
+}
+
+/*
+   Dark frame binary format: 16 bytes header ("LRDF", format version,
+   width, height as native unsigned ints) followed by width*height native
+   ushorts. Version field also works as a byte order mark.
+   The file may be mmap()-ed and passed to dark_frame_from_buffer().
+ */
+#define LIBRAW_DARKFRAME_MAGIC "LRDF"
+#define LIBRAW_DARKFRAME_VERSION 1
+#define LIBRAW_DARKFRAME_HEADER 16
+
+/*
+   Subtracts dark frame from image; black level is included in dark frame,
+   so black/cblack are zeroed. data_maximum is calculated in the same pass,
+   so separate subtract_black_internal() pass is not needed.
+   Returns 1 if dark frame was applied.
+ */
+int LibRaw::subtract(const libraw_dark_frame_t *df)
+{
+  RUN_CALLBACK(LIBRAW_PROGRESS_DARK_FRAME, 0, 2);
+  if (!df || !df->data)
+  {
+    imgdata.process_warnings |= LIBRAW_WARN_BAD_DARKFRAME_FILE;
+    return 0;
+  }
+  if (df->width != S.width || df->height != S.height)
+  {
+    imgdata.process_warnings |= LIBRAW_WARN_BAD_DARKFRAME_DIM;
+    return 0;
+  }
+  const int width = S.width, height = S.height, shrink = IO.shrink,
+            iwidth = S.iwidth, iheight = S.iheight;
+  const unsigned filters = imgdata.idata.filters;
+  int dmax = 0;
+  /* image rows are independent: each one covers 1<<shrink raw rows */
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp parallel for schedule(static) shared(dmax)
+#endif
+  for (int irow = 0; irow < iheight; irow++)
+  {
+    ushort(*ip)[4] = imgdata.image + size_t(irow) * iwidth;
+    for (int row = irow << shrink; row < ((irow + 1) << shrink) && row < height;
+         row++)
+    {
+      const ushort *drow = df->data + size_t(row) * width;
+      if (!shrink && filters > 1000)
+      {
+        /* regular bayer: color depends on column parity only */
+        const int c0 = FC(row, 0), c1 = FC(row, 1);
+        int col;
+        for (col = 0; col < width - 1; col += 2)
+        {
+          ip[col][c0] = MAX(ip[col][c0] - drow[col], 0);
+          ip[col + 1][c1] = MAX(ip[col + 1][c1] - drow[col + 1], 0);
+        }
+        if (col < width)
+          ip[col][c0] = MAX(ip[col][c0] - drow[col], 0);
+      }
+      else
+        for (int col = 0; col < width; col++)
+        {
+          ushort &v = ip[col >> shrink][FC(row, col)];
+          v = MAX(v - drow[col], 0);
+        }
+    }
+    const ushort *p = ip[0];
+    ushort ldmax = 0;
+    for (int i = 0; i < iwidth * 4; i++)
+      ldmax = MAX(ldmax, p[i]);
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp critical(dataupdate)
+#endif
+    {
+      if (dmax < ldmax)
+        dmax = ldmax;
+    }
+  }
+  C.data_maximum = dmax;
+  ZERO(C.cblack);
+  C.black = 0;
+  RUN_CALLBACK(LIBRAW_PROGRESS_DARK_FRAME, 1, 2);
+  return 1;
+}
+
+int LibRaw::load_dark_frame(libraw_dark_frame_t *df, const char *fname)
+{
+  FILE *fp;
+  int dim[3] = {0, 0, 0}, comment = 0, number = 0, error = 0, nd = 0, c;
+
+  if (!df || !fname)
+    return LIBRAW_UNSPECIFIED_ERROR;
+  memset(df, 0, sizeof(*df));
+  if (!(fp = fopen(fname, "rb")))
+    return LIBRAW_IO_ERROR;
+
+  char magic[4];
+  if (fread(magic, 1, 2, fp) != 2)
+    error = 1;
+  else if (magic[0] == 'P' && magic[1] == '5')
+  {
+    /* 16-bit PGM */
+    while (nd < 3 && (c = fgetc(fp)) != EOF)
+    {
+      if (c == '#')
+        comment = 1;
+      if (c == '\n')
+        comment = 0;
+      if (comment)
+        continue;
+      if (isdigit(c))
+        number = 1;
+      if (number)
+      {
+        if (isdigit(c))
+          dim[nd] = dim[nd] * 10 + c - '0';
+        else if (isspace(c))
+        {
+          number = 0;
+          nd++;
+        }
+        else
+        {
+          error = 1;
+          break;
+        }
+      }
+    }
+    if (error || nd < 3)
+    {
+      fclose(fp);
+      return LIBRAW_FILE_UNSUPPORTED;
+    }
+    if (dim[2] != 65535 || !dim[0] || !dim[1] || dim[0] > 65535 ||
+        dim[1] > 65535)
+    {
+      fclose(fp);
+      return LIBRAW_DATA_ERROR;
+    }
+  }
+  else
+  {
+    /* LibRaw binary format */
+    unsigned hdr[3] = {0, 0, 0};
+    if (fread(magic + 2, 1, 2, fp) != 2 ||
+        memcmp(magic, LIBRAW_DARKFRAME_MAGIC, 4) ||
+        fread(hdr, sizeof(unsigned), 3, fp) != 3 ||
+        hdr[0] != LIBRAW_DARKFRAME_VERSION || !hdr[1] || !hdr[2] ||
+        hdr[1] > 65535 || hdr[2] > 65535)
+      error = 1;
+    dim[0] = hdr[1];
+    dim[1] = hdr[2];
+  }
+  if (error)
+  {
+    fclose(fp);
+    return LIBRAW_FILE_UNSUPPORTED;
+  }
+
+  size_t pixels = size_t(dim[0]) * size_t(dim[1]);
+  df->data = (ushort *)::malloc(pixels * sizeof(ushort));
+  if (!df->data)
+  {
+    fclose(fp);
+    return LIBRAW_UNSUFFICIENT_MEMORY;
+  }
+  df->width = dim[0];
+  df->height = dim[1];
+  df->owned = 1;
+  if (fread(df->data, sizeof(ushort), pixels, fp) != pixels)
+  {
+    fclose(fp);
+    free_dark_frame(df);
+    return LIBRAW_IO_ERROR;
+  }
+  fclose(fp);
+  if (nd) /* PGM data is big-endian */
+  {
+    ushort *d = df->data;
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+    for (INT64 i = 0; i < (INT64)pixels; i++)
+      d[i] = ntohs(d[i]);
+  }
+  return LIBRAW_SUCCESS;
+}
+
+int LibRaw::dark_frame_from_buffer(libraw_dark_frame_t *df, void *buffer,
+                                   size_t size)
+{
+  if (!df || !buffer)
+    return LIBRAW_UNSPECIFIED_ERROR;
+  memset(df, 0, sizeof(*df));
+  if (size < LIBRAW_DARKFRAME_HEADER ||
+      memcmp(buffer, LIBRAW_DARKFRAME_MAGIC, 4))
+    return LIBRAW_FILE_UNSUPPORTED;
+  unsigned hdr[3];
+  memmove(hdr, (char *)buffer + 4, sizeof(hdr));
+  if (hdr[0] != LIBRAW_DARKFRAME_VERSION || !hdr[1] || !hdr[2] ||
+      hdr[1] > 65535 || hdr[2] > 65535)
+    return LIBRAW_FILE_UNSUPPORTED;
+  if (size - LIBRAW_DARKFRAME_HEADER < size_t(hdr[1]) * hdr[2] * sizeof(ushort))
+    return LIBRAW_IO_ERROR;
+  df->width = hdr[1];
+  df->height = hdr[2];
+  df->data = (ushort *)((char *)buffer + LIBRAW_DARKFRAME_HEADER);
+  df->owned = 0;
+  return LIBRAW_SUCCESS;
+}
+
+int LibRaw::save_dark_frame(const libraw_dark_frame_t *df, const char *fname)
+{
+  if (!df || !df->data || !fname)
+    return LIBRAW_UNSPECIFIED_ERROR;
+  FILE *fp = fopen(fname, "wb");
+  if (!fp)
+    return LIBRAW_IO_ERROR;
+  unsigned hdr[3] = {LIBRAW_DARKFRAME_VERSION, df->width, df->height};
+  size_t pixels = size_t(df->width) * df->height;
+  int ok = fwrite(LIBRAW_DARKFRAME_MAGIC, 1, 4, fp) == 4 &&
+           fwrite(hdr, sizeof(unsigned), 3, fp) == 3 &&
+           fwrite(df->data, sizeof(ushort), pixels, fp) == pixels;
+  if (fclose(fp) || !ok)
+    return LIBRAW_IO_ERROR;
+  return LIBRAW_SUCCESS;
+}
+
+void LibRaw::free_dark_frame(libraw_dark_frame_t *df)
+{
+  if (!df)
+    return;
+  if (df->owned)
+    ::free(df->data);
+  df->data = NULL;
+  df->width = df->height = 0;
+  df->owned = 0;
+}
@@ -15,16 +15,8 @@
 
 #include "../../internal/libraw_cxx_defs.h"
 
-void LibRaw::raw2image_start()
+void LibRaw::apply_user_flip()
 {
-  // restore color,sizes and internal data into raw_image fields
-  memmove(&imgdata.color, &imgdata.rawdata.color, sizeof(imgdata.color));
-  memmove(&imgdata.sizes, &imgdata.rawdata.sizes, sizeof(imgdata.sizes));
-  memmove(&imgdata.idata, &imgdata.rawdata.iparams, sizeof(imgdata.idata));
-  memmove(&libraw_internal_data.internal_output_params,
-          &imgdata.rawdata.ioparams,
-          sizeof(libraw_internal_data.internal_output_params));
-
   if (O.user_flip >= 0)
     S.flip = O.user_flip;
 
@@ -40,6 +32,20 @@ void LibRaw::raw2image_start()
     S.flip = 6;
     break;
   }
+}
+
+void LibRaw::raw2image_start()
+{
+  // restore color,sizes and internal data into raw_image fields
+  memmove(&imgdata.color, &imgdata.rawdata.color, sizeof(imgdata.color));
+  memmove(&imgdata.sizes, &imgdata.rawdata.sizes, sizeof(imgdata.sizes));
+  memmove(&imgdata.idata, &imgdata.rawdata.iparams, sizeof(imgdata.idata));
+  memmove(&libraw_internal_data.internal_output_params,
+          &imgdata.rawdata.ioparams,
+          sizeof(libraw_internal_data.internal_output_params));
+  fused_output_reset();
+
+  apply_user_flip();
 
   for (int c = 0; c < 4; c++)
     if (O.aber[c] < 0.001 || O.aber[c] > 1000.f)
@@ -0,0 +1,63 @@
+/* -*- C++ -*-
+ * Copyright 2019-2024 LibRaw LLC (info@libraw.org)
+ *
+ LibRaw is free software; you can redistribute it and/or modify
+ it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+
+#include "../../internal/libraw_cxx_defs.h"
+
+/*
+   Tables are function-local statics: built on first call (initialization
+   is thread-safe with C++11 compilers, gcc/clang and MSVC 2015+), never
+   modified afterwards.
+ */
+
+namespace
+{
+struct cielab_cbrt_table
+{
+  float v[0x10000];
+  cielab_cbrt_table()
+  {
+    for (int i = 0; i < 0x10000; i++)
+    {
+      float r = i / 65535.0f;
+      v[i] = r > 0.008856f ? pow(r, 1.f / 3.0f) : 7.787f * r + 16.f / 116.0f;
+    }
+  }
+};
+
+struct aahd_gamma_table
+{
+  float v[0x10000];
+  aahd_gamma_table()
+  {
+    for (int i = 0; i < 0x10000; i++)
+    {
+      float r = (float)i / 0x10000;
+      v[i] =
+          0x10000 * (r < 0.0181 ? 4.5f * r : 1.0993f * pow(r, 0.45f) - .0993f);
+    }
+  }
+};
+} // namespace
+
+const float *LibRaw_tables::cielab_cbrt()
+{
+  static const cielab_cbrt_table t;
+  return t.v;
+}
+
+const float *LibRaw_tables::aahd_gamma()
+{
+  static const aahd_gamma_table t;
+  return t.v;
+}
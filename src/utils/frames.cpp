@@ -0,0 +1,354 @@
+/* -*- C++ -*-
+ * Copyright 2019-2024 LibRaw LLC (info@libraw.org)
+ *
+ * Multi-frame access: CR3 roll bursts, Phantom CINE, pixel shift
+ * (Pentax/Sinar 4-shot). File is identified once, any frame may be
+ * unpacked later without re-running identify().
+
+ LibRaw is free software; you can redistribute it and/or modify
+ it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+
+#include "../../internal/libraw_cxx_defs.h"
+
+/* Everything identify() and open_datastream() leave behind that unpack()
+   (or the decoders called from it) may change */
+struct libraw_frame_state_t
+{
+  libraw_iparams_t idata;
+  libraw_image_sizes_t sizes;
+  libraw_colordata_t color;
+  libraw_internal_output_params_t ioparams;
+  unpacker_data_t unpacker_data;
+  void (LibRaw::*load_raw)();
+  unsigned progress_flags;
+};
+
+void LibRaw::free_frame_index()
+{
+  frame_index_t &fi = libraw_internal_data.frame_index;
+  if (fi.frames)
+    free(fi.frames);
+  if (fi.saved_state)
+    free(fi.saved_state);
+  memset(&fi, 0, sizeof(fi));
+}
+
+void LibRaw::init_frame_index()
+{
+  frame_index_t &fi = libraw_internal_data.frame_index;
+  free_frame_index();
+  if (P1.raw_count < 2 || !load_raw)
+    return;
+
+  try
+  {
+    unsigned kind = LIBRAW_FRAMEINDEX_NONE;
+    unsigned count = 0;
+    int crxtrack = libraw_internal_data.unpacker_data.crx_track_selected;
+
+    if (load_raw == &LibRaw::crxLoadRaw && crxtrack >= 0 &&
+        crxtrack < LIBRAW_CRXTRACKS_MAXCOUNT &&
+        libraw_internal_data.unpacker_data.crx_header[crxtrack].sample_count ==
+            P1.raw_count)
+    {
+      kind = LIBRAW_FRAMEINDEX_CR3;
+      count = P1.raw_count;
+    }
+    else if (makeIs(LIBRAW_CAMERAMAKER_CINE) &&
+             INT64(P1.raw_count) * 8LL < ID.input->size())
+    {
+      kind = LIBRAW_FRAMEINDEX_CINE;
+      count = P1.raw_count;
+    }
+    else if (load_raw == &LibRaw::sinar_4shot_load_raw && P1.filters &&
+             imgdata.rawparams.shot_select > 0)
+    {
+      kind = LIBRAW_FRAMEINDEX_SINAR4SHOT;
+      count = 4;
+    }
+    else if (makeIs(LIBRAW_CAMERAMAKER_Pentax) && P1.raw_count == 4 &&
+             libraw_internal_data.unpacker_data.tiff_samples == 1)
+    {
+      kind = LIBRAW_FRAMEINDEX_TIFFIFD;
+      count = 4;
+    }
+
+    if (kind == LIBRAW_FRAMEINDEX_NONE)
+      return;
+
+    fi.frames = (frame_index_entry_t *)calloc(count, sizeof(frame_index_entry_t));
+    unsigned found = 0;
+
+    if (kind == LIBRAW_FRAMEINDEX_CR3)
+    {
+      crx_data_header_t *hdr =
+          &libraw_internal_data.unpacker_data.crx_header[crxtrack];
+      INT64 save_offset = hdr->MediaOffset;
+      uint32_t save_size = hdr->MediaSize;
+      for (; found < count; found++)
+      {
+        if (selectCRXFrame(crxtrack, found))
+          break;
+        fi.frames[found].offset = hdr->MediaOffset;
+        fi.frames[found].size = hdr->MediaSize;
+        fi.frames[found].shot_select = found;
+        fi.frames[found].ifd = -1;
+      }
+      hdr->MediaOffset = save_offset;
+      hdr->MediaSize = save_size;
+    }
+    else if (kind == LIBRAW_FRAMEINDEX_CINE)
+    {
+      /* image offsets table: 64-bit offsets, see parse_cine() */
+      short save_order = libraw_internal_data.unpacker_data.order;
+      libraw_internal_data.unpacker_data.order = 0x4949;
+      ID.input->seek(32, SEEK_SET);
+      ID.input->seek(get4(), SEEK_SET);
+      for (; found < count; found++)
+      {
+        INT64 off = (INT64)get4() + 8;
+        off += (INT64)get4() << 32;
+        if (off < 8 || off >= ID.input->size())
+          break;
+        fi.frames[found].offset = off;
+        fi.frames[found].shot_select = found;
+        fi.frames[found].ifd = -1;
+      }
+      libraw_internal_data.unpacker_data.order = save_order;
+    }
+    else if (kind == LIBRAW_FRAMEINDEX_SINAR4SHOT)
+    {
+      for (; found < count; found++)
+      {
+        fi.frames[found].offset = libraw_internal_data.unpacker_data.data_offset;
+        fi.frames[found].shot_select = found + 1;
+        fi.frames[found].ifd = -1;
+      }
+    }
+    else if (kind == LIBRAW_FRAMEINDEX_TIFFIFD)
+    {
+      /* Same selection order as parse_tiff()/apply_tiff() use for shot_select */
+      unsigned nifds = MIN(libraw_internal_data.identify_data.tiff_nifds,
+                           LIBRAW_IFD_MAXCOUNT);
+      for (unsigned q = 0; q < (P1.dng_version ? count : nifds) && found < count; q++)
+      {
+        int i = P1.dng_version
+                    ? (libraw_internal_data.unpacker_data.dng_frames[q] >> 8) & 0xff
+                    : int(q);
+        if (i < 0 || i >= int(nifds) || tiff_ifd[i].t_width != S.raw_width ||
+            tiff_ifd[i].t_height != S.raw_height ||
+            tiff_ifd[i].bps != int(libraw_internal_data.unpacker_data.tiff_bps) ||
+            tiff_ifd[i].samples != 1)
+          continue;
+        fi.frames[found].offset = tiff_ifd[i].offset;
+        fi.frames[found].size = tiff_ifd[i].bytes;
+        fi.frames[found].shot_select = P1.dng_version ? q : found;
+        fi.frames[found].ifd = i;
+        found++;
+      }
+    }
+
+    if (found != count)
+    {
+      free_frame_index();
+      return;
+    }
+
+    libraw_frame_state_t *st =
+        (libraw_frame_state_t *)malloc(sizeof(libraw_frame_state_t));
+    memmove(&st->idata, &imgdata.idata, sizeof(st->idata));
+    memmove(&st->sizes, &imgdata.sizes, sizeof(st->sizes));
+    memmove(&st->color, &imgdata.color, sizeof(st->color));
+    memmove(&st->ioparams, &libraw_internal_data.internal_output_params,
+            sizeof(st->ioparams));
+    memmove(&st->unpacker_data, &libraw_internal_data.unpacker_data,
+            sizeof(st->unpacker_data));
+    st->load_raw = load_raw;
+    st->progress_flags = imgdata.progress_flags;
+
+    fi.saved_state = st;
+    fi.kind = kind;
+    fi.count = count;
+    fi.selected = imgdata.rawparams.shot_select;
+    for (unsigned i = 0; i < count; i++)
+      if (fi.frames[i].shot_select == imgdata.rawparams.shot_select)
+        fi.selected = i;
+  }
+  catch (...)
+  {
+    /* frame index is optional: single frame access still works */
+    free_frame_index();
+  }
+}
+
+int LibRaw::frame_count()
+{
+  if (libraw_internal_data.frame_index.count)
+    return libraw_internal_data.frame_index.count;
+  return (imgdata.progress_flags & LIBRAW_PROGRESS_IDENTIFY) && P1.raw_count > 0
+             ? 1
+             : 0;
+}
+
+size_t LibRaw::frame_buffer_size()
+{
+  if (!(imgdata.progress_flags & LIBRAW_PROGRESS_IDENTIFY) || !load_raw)
+    return 0;
+  if (!(P1.filters || P1.colors == 1) || IO.fuji_width ||
+      is_phaseone_compressed() || is_floating_point())
+    return 0; /* decoders that replace or re-own raw_alloc */
+  libraw_decoder_info_t decoder_info;
+  get_decoder_info(&decoder_info);
+  if (decoder_info.decoder_flags &
+      (LIBRAW_DECODER_OWNALLOC | LIBRAW_DECODER_3CHANNEL))
+    return 0;
+  if ((decoder_info.decoder_flags & LIBRAW_DECODER_SINAR4SHOT) && !imgdata.rawparams.shot_select)
+    return 0;
+  /* same as unpack() allocation */
+  size_t rwidth = MAX(S.raw_width, S.width + S.left_margin);
+  size_t rheight = MAX(S.raw_height, S.height + S.top_margin);
+  return rwidth * (rheight + 8) * sizeof(ushort);
+}
+
+int LibRaw::select_frame(unsigned frame)
+{
+  CHECK_ORDER_LOW(LIBRAW_PROGRESS_IDENTIFY);
+  frame_index_t &fi = libraw_internal_data.frame_index;
+
+  if (!libraw_internal_data.internal_data.input)
+    return LIBRAW_INPUT_CLOSED;
+  if (int(frame) >= frame_count())
+    return LIBRAW_REQUEST_FOR_NONEXISTENT_IMAGE;
+  if (!fi.count || !fi.saved_state)
+    return LIBRAW_SUCCESS; /* single frame, nothing to switch */
+
+  try
+  {
+    libraw_frame_state_t *st = (libraw_frame_state_t *)fi.saved_state;
+
+    free_raw_rows_cache();
+    free_render_cache();
+    if (imgdata.image)
+    {
+      free(imgdata.image);
+      imgdata.image = 0;
+    }
+    if (imgdata.rawdata.raw_alloc)
+    {
+      free(imgdata.rawdata.raw_alloc);
+      imgdata.rawdata.raw_alloc = 0;
+    }
+    if (libraw_internal_data.internal_data.meta_data)
+    {
+      free(libraw_internal_data.internal_data.meta_data);
+      libraw_internal_data.internal_data.meta_data = 0;
+    }
+    imgdata.rawdata.raw_image = 0;
+    imgdata.rawdata.color4_image = 0;
+    imgdata.rawdata.color3_image = 0;
+    imgdata.rawdata.float_image = 0;
+    imgdata.rawdata.float3_image = 0;
+    imgdata.rawdata.float4_image = 0;
+
+    memmove(&imgdata.idata, &st->idata, sizeof(st->idata));
+    memmove(&imgdata.sizes, &st->sizes, sizeof(st->sizes));
+    memmove(&imgdata.color, &st->color, sizeof(st->color));
+    memmove(&libraw_internal_data.internal_output_params, &st->ioparams,
+            sizeof(st->ioparams));
+    /* CR3 per-track offset tables are built lazily, keep current ones */
+    INT64 *sample_offsets[LIBRAW_CRXTRACKS_MAXCOUNT];
+    for (int i = 0; i < LIBRAW_CRXTRACKS_MAXCOUNT; i++)
+      sample_offsets[i] =
+          libraw_internal_data.unpacker_data.crx_header[i].sample_offsets;
+    memmove(&libraw_internal_data.unpacker_data, &st->unpacker_data,
+            sizeof(st->unpacker_data));
+    for (int i = 0; i < LIBRAW_CRXTRACKS_MAXCOUNT; i++)
+      libraw_internal_data.unpacker_data.crx_header[i].sample_offsets =
+          sample_offsets[i];
+    load_raw = st->load_raw;
+    imgdata.progress_flags = st->progress_flags;
+
+    frame_index_entry_t &e = fi.frames[frame];
+    imgdata.rawparams.shot_select = e.shot_select;
+
+    switch (fi.kind)
+    {
+    case LIBRAW_FRAMEINDEX_CR3:
+    {
+      int track = libraw_internal_data.unpacker_data.crx_track_selected;
+      libraw_internal_data.unpacker_data.crx_header[track].MediaOffset = e.offset;
+      libraw_internal_data.unpacker_data.crx_header[track].MediaSize =
+          uint32_t(e.size);
+      libraw_internal_data.unpacker_data.data_offset = e.offset;
+      libraw_internal_data.unpacker_data.data_size = e.size;
+      /* per-frame exposure data */
+      for (int i = 0; i <= libraw_internal_data.unpacker_data.crx_track_count &&
+                      i < LIBRAW_CRXTRACKS_MAXCOUNT;
+           i++)
+        if (libraw_internal_data.unpacker_data.crx_header[i].MediaType == 3 &&
+            !selectCRXFrame(i, frame))
+          parseCR3_CTMD(i);
+    }
+    break;
+    case LIBRAW_FRAMEINDEX_CINE:
+      libraw_internal_data.unpacker_data.data_offset = e.offset;
+      break;
+    case LIBRAW_FRAMEINDEX_TIFFIFD:
+      libraw_internal_data.unpacker_data.data_offset = e.offset;
+      libraw_internal_data.unpacker_data.data_size = e.size;
+      break;
+    default: /* LIBRAW_FRAMEINDEX_SINAR4SHOT: decoder uses shot_select */
+      break;
+    }
+
+    memmove(&imgdata.rawdata.color, &imgdata.color, sizeof(imgdata.color));
+    memmove(&imgdata.rawdata.sizes, &imgdata.sizes, sizeof(imgdata.sizes));
+    memmove(&imgdata.rawdata.iparams, &imgdata.idata, sizeof(imgdata.idata));
+    memmove(&imgdata.rawdata.ioparams,
+            &libraw_internal_data.internal_output_params,
+            sizeof(libraw_internal_data.internal_output_params));
+    fi.selected = frame;
+  }
+  catch (const std::bad_alloc&)
+  {
+    EXCEPTION_HANDLER(LIBRAW_EXCEPTION_ALLOC);
+  }
+  catch (const LibRaw_exceptions& err)
+  {
+    EXCEPTION_HANDLER(err);
+  }
+  catch (const std::exception& )
+  {
+    EXCEPTION_HANDLER(LIBRAW_EXCEPTION_IO_CORRUPT);
+  }
+  return LIBRAW_SUCCESS;
+}
+
+int LibRaw::unpack_frame(unsigned frame, void *buffer, size_t buffer_size)
+{
+  int ret = select_frame(frame);
+  if (ret != LIBRAW_SUCCESS)
+    return ret;
+  if (buffer)
+  {
+    size_t needed = frame_buffer_size();
+    if (!needed)
+      return LIBRAW_NOT_IMPLEMENTED;
+    if (buffer_size < needed)
+      return LIBRAW_UNSPECIFIED_ERROR;
+  }
+  libraw_internal_data.internal_data.user_raw_buffer = buffer;
+  libraw_internal_data.internal_data.user_raw_buffer_size = buffer ? buffer_size : 0;
+  ret = unpack();
+  libraw_internal_data.internal_data.user_raw_buffer = 0;
+  libraw_internal_data.internal_data.user_raw_buffer_size = 0;
+  return ret;
+}
@@ -148,6 +148,7 @@ void LibRaw::recycle()
   FREE(libraw_internal_data.internal_data.meta_data);
   FREE(libraw_internal_data.output_data.histogram);
   FREE(libraw_internal_data.output_data.oprof);
+  FREE(libraw_internal_data.output_data.fused.lut);
   FREE(imgdata.color.profile);
   FREE(imgdata.rawdata.ph1_cblack);
   FREE(imgdata.rawdata.ph1_rblack);
@@ -155,6 +156,9 @@ void LibRaw::recycle()
   FREE(imgdata.idata.xmpdata);
 
   parseCR3_Free();
+  free_frame_index();
+  free_raw_rows_cache();
+  free_render_cache();
 
 #undef FREE
 
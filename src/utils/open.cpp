@@ -1326,9 +1326,18 @@ int LibRaw::open_datastream(LibRaw_abstract_datastream *stream)
 
 final:;
 
+  return open_datastream_tail();
+}
+
+/* Size adjustments that depend on output parameters, common for
+   open_datastream() and open_with_snapshot() */
+int LibRaw::open_datastream_tail()
+{
   if (P1.raw_count < 1)
     return LIBRAW_FILE_UNSUPPORTED;
 
+  ID.identified_width = S.width;
+  ID.identified_height = S.height;
   write_fun = &LibRaw::write_ppm_tiff;
 
   if (load_raw == &LibRaw::kodak_ycbcr_load_raw)
@@ -1359,5 +1368,7 @@ final:;
 
   SET_PROC_FLAG(LIBRAW_PROGRESS_SIZE_ADJUST);
 
+  init_frame_index();
+
   return LIBRAW_SUCCESS;
 }
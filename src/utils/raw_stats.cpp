@@ -0,0 +1,346 @@
+/* -*- C++ -*-
+ * Copyright 2019-2024 LibRaw LLC (info@libraw.org)
+ *
+ * Raw data statistics: per-channel counts, sums, minimum/maximum,
+ * histograms, clipped pixels, masked area black and auto white balance
+ * sums, collected in single (optionally subsampled) pass over raw data.
+
+ LibRaw is free software; you can redistribute it and/or modify
+ it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+
+#include "../../internal/libraw_cxx_defs.h"
+
+namespace
+{
+struct raw_stats_ctx_t
+{
+  const void *data;
+  size_t pitch; /* in pixels */
+  int top, left, height, width;
+  int period; /* CFA period, sampling unit */
+  int step;
+  unsigned clip;
+  unsigned char cfa[48][48]; /* channel by visible row%48, col%48 */
+  /* auto WB */
+  int gx, gy, gright, gbottom, bandorg;
+  int black[4], awb_max;
+  const unsigned *pattern;
+  int prows, pcols;
+  float fscale;
+};
+
+struct raw_stats_acc_t
+{
+  INT64 count[4], sum[4], clipped[4];
+  unsigned vmin[4], vmax[4];
+  double awb[8];
+  unsigned *hist;
+};
+
+struct raw_stats_ushort
+{
+  typedef ushort type;
+  unsigned operator()(ushort v, float) const { return v; }
+};
+
+struct raw_stats_float
+{
+  typedef float type;
+  unsigned operator()(float v, float scale) const
+  {
+    float f = v * scale;
+    return f <= 0.f ? 0 : (f >= 65535.f ? 65535 : unsigned(f + 0.5f));
+  }
+};
+
+/* Visible rows [band*8 + bandorg, +8): pixel statistics and auto WB blocks
+   started in this band */
+template <class Conv>
+void raw_stats_band(const raw_stats_ctx_t &x, int band, raw_stats_acc_t &a)
+{
+  typedef typename Conv::type pixel_t;
+  Conv conv;
+  const pixel_t *data = (const pixel_t *)x.data;
+  int bs = band * 8 + x.bandorg;
+  int r0 = MAX(bs, 0), r1 = MIN(bs + 8, x.height);
+
+  for (int row = r0; row < r1; row++)
+  {
+    if ((row / x.period) % x.step)
+      continue;
+    const pixel_t *src = data + size_t(row + x.top) * x.pitch + x.left;
+    const unsigned char *cfa = x.cfa[row % 48];
+    for (int col0 = 0; col0 < x.width; col0 += x.period * x.step)
+    {
+      int col1 = MIN(col0 + x.period, x.width);
+      for (int col = col0; col < col1; col++)
+      {
+        unsigned val = conv(src[col], x.fscale);
+        unsigned c = cfa[col % 48];
+        a.count[c]++;
+        a.sum[c] += val;
+        a.clipped[c] += val >= x.clip;
+        if (val < a.vmin[c])
+          a.vmin[c] = val;
+        if (val > a.vmax[c])
+          a.vmax[c] = val;
+        a.hist[c * LIBRAW_RAWSTATS_HISTOGRAM_SIZE + (val >> 3)]++;
+      }
+    }
+  }
+
+  /* same 8x8 blocks as in scale_colors() */
+  if (bs < x.gy || bs >= x.gbottom || ((bs - x.gy) / 8) % x.step)
+    return;
+  int ye = MIN(bs + 8, x.gbottom);
+  for (int bx = x.gx, bn = 0; bx < x.gright; bx += 8, bn++)
+  {
+    if (bn % x.step)
+      continue;
+    double sum[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    int xe = MIN(bx + 8, x.gright);
+    for (int y = bs; y < ye; y++)
+    {
+      const pixel_t *src = data + size_t(y + x.top) * x.pitch + x.left;
+      const unsigned char *cfa = x.cfa[y % 48];
+      const unsigned *prow =
+          x.pattern ? x.pattern + (y % x.prows) * x.pcols : 0;
+      for (int col = bx; col < xe; col++)
+      {
+        unsigned c = cfa[col % 48];
+        int val = int(conv(src[col], x.fscale)) - x.black[c] -
+                  (prow ? int(prow[col % x.pcols]) : 0);
+        if (val > x.awb_max - 25)
+          goto skip_block;
+        if (val < 0)
+          val = 0;
+        sum[c] += val;
+        sum[c + 4]++;
+      }
+    }
+    for (int c = 0; c < 8; c++)
+      a.awb[c] += sum[c];
+  skip_block:;
+  }
+}
+} // namespace
+
+int LibRaw::get_raw_stats(libraw_raw_stats_t *stats, unsigned step)
+{
+  CHECK_ORDER_LOW(LIBRAW_PROGRESS_LOAD_RAW);
+  if (!stats)
+    return LIBRAW_UNSPECIFIED_ERROR;
+  if (!imgdata.rawdata.raw_image && !imgdata.rawdata.float_image)
+    return LIBRAW_NOT_IMPLEMENTED; /* no data or not single channel */
+  if (libraw_internal_data.internal_output_params.fuji_width)
+    return LIBRAW_NOT_IMPLEMENTED;
+
+  try
+  {
+    /* unpack() state, processing may change imgdata.sizes/color */
+    const libraw_image_sizes_t &rs = imgdata.rawdata.sizes;
+    const libraw_colordata_t &rc = imgdata.rawdata.color;
+    unsigned filters = imgdata.rawdata.iparams.filters;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->step = step = MAX(step, 1u);
+
+    raw_stats_ctx_t x;
+    memset(&x, 0, sizeof(x));
+    x.step = step;
+    x.top = rs.top_margin;
+    x.left = rs.left_margin;
+    x.height = MIN(int(rs.height), int(rs.raw_height) - x.top);
+    x.width = MIN(int(rs.width), int(rs.raw_width) - x.left);
+    if (x.height <= 0 || x.width <= 0)
+      return LIBRAW_NOT_IMPLEMENTED;
+
+    if (imgdata.rawdata.raw_image)
+    {
+      x.data = imgdata.rawdata.raw_image;
+      x.pitch = rs.raw_pitch / 2;
+      x.clip = rc.maximum;
+      x.fscale = 1.f;
+    }
+    else
+    {
+      x.data = imgdata.rawdata.float_image;
+      x.pitch = rs.raw_pitch / 4;
+      x.clip = 65535;
+      x.fscale = rc.fmaximum > 0.f ? 65535.f / rc.fmaximum : 1.f;
+    }
+
+    if (filters == 9)
+    {
+      x.period = 6;
+      for (int r = 0; r < 48; r++)
+        for (int c = 0; c < 48; c++)
+          x.cfa[r][c] = imgdata.rawdata.iparams.xtrans[r % 6][c % 6] & 3;
+    }
+    else if (filters >= 1000)
+    {
+      x.period = 2;
+      for (int r = 0; r < 48; r++)
+        for (int c = 0; c < 48; c++)
+          x.cfa[r][c] = filters >> ((((r << 1) & 14) | (c & 1)) << 1) & 3;
+    }
+    else if (filters)
+    {
+      x.period = 2;
+      for (int r = 0; r < 48; r++)
+        for (int c = 0; c < 48; c++)
+          x.cfa[r][c] = fcol(r, c) & 3;
+    }
+    else
+      x.period = 1; /* monochrome */
+
+    /* black levels: per channel, common part (as after adjust_bl()) and
+       optional repeating pattern */
+    int common = 0x7fffffff, pcommon = 0;
+    for (int c = 0; c < 4; c++)
+    {
+      x.black[c] = rc.black + rc.cblack[c];
+      common = MIN(common, x.black[c]);
+    }
+    if (rc.cblack[4] && rc.cblack[5] &&
+        rc.cblack[4] * rc.cblack[5] <= LIBRAW_CBLACK_SIZE - 6)
+    {
+      x.pattern = rc.cblack + 6;
+      x.prows = rc.cblack[4];
+      x.pcols = rc.cblack[5];
+      pcommon = x.pattern[0];
+      for (int i = 1; i < x.prows * x.pcols; i++)
+        pcommon = MIN(pcommon, int(x.pattern[i]));
+    }
+    x.awb_max = int(x.clip) - (x.data == imgdata.rawdata.raw_image
+                                   ? common + pcommon
+                                   : 0);
+    if (x.data != imgdata.rawdata.raw_image)
+    {
+      /* float data is not black subtracted by LibRaw */
+      memset(x.black, 0, sizeof(x.black));
+      x.pattern = 0;
+    }
+
+    x.gx = MIN(O.greybox[0], unsigned(x.width));
+    x.gy = MIN(O.greybox[1], unsigned(x.height));
+    x.gright = int(MIN(INT64(O.greybox[0]) + O.greybox[2], INT64(x.width)));
+    x.gbottom = int(MIN(INT64(O.greybox[1]) + O.greybox[3], INT64(x.height)));
+    x.bandorg = x.gy % 8 ? x.gy % 8 - 8 : 0;
+    int bands = (x.height - x.bandorg + 7) / 8;
+
+    for (int c = 0; c < 4; c++)
+      stats->channel_minimum[c] = 0xffffffffU;
+    int failed = 0;
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp parallel
+#endif
+    {
+      raw_stats_acc_t a;
+      memset(&a, 0, sizeof(a));
+      for (int c = 0; c < 4; c++)
+        a.vmin[c] = 0xffffffffU;
+      a.hist = (unsigned *)::calloc(4 * LIBRAW_RAWSTATS_HISTOGRAM_SIZE,
+                                    sizeof(unsigned));
+      if (a.hist)
+      {
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp for schedule(dynamic)
+#endif
+        for (int band = 0; band < bands; band++)
+        {
+          if (x.data == imgdata.rawdata.raw_image)
+            raw_stats_band<raw_stats_ushort>(x, band, a);
+          else
+            raw_stats_band<raw_stats_float>(x, band, a);
+        }
+      }
+#if defined(LIBRAW_USE_OPENMP)
+#pragma omp critical(dataupdate)
+#endif
+      {
+        if (!a.hist)
+          failed = 1;
+        else
+        {
+          for (int c = 0; c < 4; c++)
+          {
+            stats->count[c] += a.count[c];
+            stats->sum[c] += a.sum[c];
+            stats->clipped[c] += a.clipped[c];
+            stats->awb_sum[c] += a.awb[c];
+            stats->awb_count[c] += a.awb[c + 4];
+            if (a.count[c])
+            {
+              if (a.vmax[c] > stats->channel_maximum[c])
+                stats->channel_maximum[c] = a.vmax[c];
+              if (a.vmin[c] < stats->channel_minimum[c])
+                stats->channel_minimum[c] = a.vmin[c];
+            }
+          }
+          unsigned *dst = &stats->histogram[0][0];
+          for (int i = 0; i < 4 * LIBRAW_RAWSTATS_HISTOGRAM_SIZE; i++)
+            dst[i] += a.hist[i];
+        }
+      }
+      ::free(a.hist);
+    }
+    if (failed)
+      throw LIBRAW_EXCEPTION_ALLOC;
+
+    for (int c = 0; c < 4; c++)
+    {
+      if (!stats->count[c])
+        stats->channel_minimum[c] = 0;
+      stats->data_maximum = MAX(stats->data_maximum,
+                                stats->channel_maximum[c]);
+    }
+
+    /* masked area: same rectangles as crop_masked_pixels() */
+    for (int m = 0; m < 8; m++)
+    {
+      int r0 = MAX(rs.mask[m][0], 0), r1 = MIN(rs.mask[m][2], int(rs.raw_height));
+      int c0 = MAX(rs.mask[m][1], 0), c1 = MIN(rs.mask[m][3], int(rs.raw_width));
+      for (int row = r0; row < r1; row++)
+      {
+        const unsigned char *cfa = x.cfa[(row + 48 * 1024 - x.top) % 48];
+        for (int col = c0; col < c1; col++)
+        {
+          unsigned c = cfa[(col + 48 * 1024 - x.left) % 48];
+          unsigned val =
+              x.data == imgdata.rawdata.raw_image
+                  ? imgdata.rawdata.raw_image[size_t(row) * x.pitch + col]
+                  : raw_stats_float()(
+                        imgdata.rawdata.float_image[size_t(row) * x.pitch + col],
+                        x.fscale);
+          stats->masked_black[c] += val;
+          stats->masked_count[c]++;
+        }
+      }
+    }
+    for (int c = 0; c < 4; c++)
+      if (stats->masked_count[c])
+        stats->masked_black[c] /= double(stats->masked_count[c]);
+    return LIBRAW_SUCCESS;
+  }
+  catch (const std::bad_alloc&)
+  {
+    EXCEPTION_HANDLER(LIBRAW_EXCEPTION_ALLOC);
+  }
+  catch (const LibRaw_exceptions& err)
+  {
+    EXCEPTION_HANDLER(err);
+  }
+  catch (const std::exception& )
+  {
+    EXCEPTION_HANDLER(LIBRAW_EXCEPTION_IO_CORRUPT);
+  }
+}
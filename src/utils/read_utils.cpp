@@ -174,3 +174,29 @@ void LibRaw::read_shorts(ushort *pixel, unsigned count)
   if ((order == 0x4949) == (ntohs(0x1234) == 0x1234))
     libraw_swab(pixel, count * 2);
 }
+
+/* Same as read_shorts() called for each of rows: one read, one derror()
+   per incomplete row (missing data is zero); byte order is fixed by rows
+   in parallel. */
+void LibRaw::read_shorts_rows(ushort *pixel, unsigned rows, unsigned rowlen)
+{
+  if (!rows || !rowlen)
+    return;
+  const size_t count = size_t(rows) * rowlen;
+  const size_t got = fread(pixel, 2, count, ifp);
+  if (got < count)
+  {
+    /* no leftovers of previous block in truncated rows */
+    memset(pixel + got, 0, (count - got) * 2);
+    for (unsigned r = unsigned(got / rowlen); r < rows; r++)
+      derror();
+  }
+  if ((order == 0x4949) == (ntohs(0x1234) == 0x1234))
+  {
+#ifdef LIBRAW_USE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int r = 0; r < int(rows); r++)
+      libraw_swab(pixel + size_t(r) * rowlen, int(rowlen * 2));
+  }
+}
@@ -0,0 +1,746 @@
+/* -*- C++ -*-
+ * Copyright 2019-2024 LibRaw LLC (info@libraw.org)
+ *
+ * Metadata snapshot: post-identify state is saved into compact binary
+ * blob and restored by open_with_snapshot() without file parsing.
+
+ LibRaw is free software; you can redistribute it and/or modify
+ it under the terms of the one of two licenses as you choose:
+
+1. GNU LESSER GENERAL PUBLIC LICENSE version 2.1
+   (See file LICENSE.LGPL provided in LibRaw distribution archive for details).
+
+2. COMMON DEVELOPMENT AND DISTRIBUTION LICENSE (CDDL) Version 1.0
+   (See file LICENSE.CDDL provided in LibRaw distribution archive for details).
+
+ */
+
+#include "../../internal/libraw_cxx_defs.h"
+
+/* Fixed part of identify() results; pointers are cleared, pointed data
+   is stored in separate sections */
+struct libraw_snapshot_state_t
+{
+  libraw_iparams_t idata;
+  libraw_image_sizes_t sizes;
+  libraw_lensinfo_t lens;
+  libraw_makernotes_t makernotes;
+  libraw_shootinginfo_t shootinginfo;
+  libraw_colordata_t color;
+  libraw_imgother_t other;
+  libraw_thumbnail_t thumbnail;
+  libraw_thumbnail_list_t thumbs_list;
+  unsigned process_warnings;
+  libraw_internal_output_params_t ioparams;
+  identify_data_t identify_data;
+  unpacker_data_t unpacker_data;
+  INT64 profile_offset, toffset;
+  unsigned pana_black[4];
+  ushort identified_width, identified_height;
+};
+
+namespace
+{
+struct snapshot_header_t
+{
+  char magic[8];
+  unsigned version;       /* LIBRAW_SNAPSHOT_VERSION */
+  int libraw_version;     /* LIBRAW_VERSION */
+  unsigned layout;        /* hash of saved structures sizes */
+  unsigned shot_select, options; /* rawparams used by identify() */
+  INT64 file_size, file_mtime;
+  UINT64 head_hash;       /* first LIBRAW_SNAPSHOT_HEADBYTES of file */
+  UINT64 body_size, body_hash;
+};
+
+const char snapshot_magic[8] = {'L', 'R', 'S', 'N', 'A', 'P', 0, 0};
+
+enum snapshot_sections
+{
+  SNAP_STATE = 1,
+  SNAP_TIFF_IFD,
+  SNAP_DECODER,
+  SNAP_COMPONENT_DECODER,
+  SNAP_XMP,
+  SNAP_PROFILE,
+  SNAP_BURSTTABLE,
+  SNAP_AFDATA,
+  SNAP_IFD_STRIP_OFFSETS,
+  SNAP_IFD_STRIP_BYTES,
+  SNAP_IFD_CBLACK,
+  SNAP_IFD_FCBLACK,
+  SNAP_CRX_STSC,
+  SNAP_CRX_SAMPLE_SIZES,
+  SNAP_CRX_CHUNK_OFFSETS
+};
+
+UINT64 fnv1a(const void *data, size_t size, UINT64 h = 0xcbf29ce484222325ULL)
+{
+  const uchar *p = (const uchar *)data;
+  for (size_t i = 0; i < size; i++)
+    h = (h ^ p[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+unsigned snapshot_layout()
+{
+  const unsigned sizes[] = {
+      unsigned(sizeof(libraw_snapshot_state_t)), unsigned(sizeof(tiff_ifd_t)),
+      unsigned(LIBRAW_IFD_MAXCOUNT), unsigned(sizeof(crx_sample_to_chunk_t)),
+      unsigned(LIBRAW_CRXTRACKS_MAXCOUNT), unsigned(LIBRAW_AFDATA_MAXCOUNT),
+      unsigned(LIBRAW_CBLACK_SIZE)};
+  return unsigned(fnv1a(sizes, sizeof(sizes)));
+}
+
+INT64 stream_mtime(LibRaw_abstract_datastream *stream)
+{
+#ifndef LIBRAW_WIN32_CALLS
+  struct stat st;
+  if (stream->fname() && !stat(stream->fname(), &st))
+    return INT64(st.st_mtime);
+#else
+  struct _stati64 st;
+  if (stream->fname() && !_stati64(stream->fname(), &st))
+    return INT64(st.st_mtime);
+#ifdef LIBRAW_WIN32_UNICODEPATHS
+  if (stream->wfname() && !_wstati64(stream->wfname(), &st))
+    return INT64(st.st_mtime);
+#endif
+#endif
+  return 0;
+}
+
+UINT64 stream_head_hash(LibRaw_abstract_datastream *stream)
+{
+  uchar buf[LIBRAW_SNAPSHOT_HEADBYTES];
+  stream->seek(0, SEEK_SET);
+  int got = stream->read(buf, 1, sizeof(buf));
+  return fnv1a(buf, got > 0 ? size_t(got) : 0);
+}
+
+/* Sections are [id][index][size] varints followed by zero-run coded data:
+   [literal count][literal bytes][zero count]... until size bytes */
+struct snapshot_writer
+{
+  std::vector<uchar> out;
+
+  void varint(UINT64 v)
+  {
+    for (; v >= 0x80; v >>= 7)
+      out.push_back(uchar(v | 0x80));
+    out.push_back(uchar(v));
+  }
+
+  void section(unsigned id, unsigned index, const void *data, size_t size)
+  {
+    if (!data || !size)
+      return;
+    const uchar *src = (const uchar *)data;
+    varint(id);
+    varint(index);
+    varint(size);
+    for (size_t i = 0; i < size;)
+    {
+      /* literal run ends at 8 or more zero bytes */
+      size_t lit = i;
+      while (lit < size)
+      {
+        if (src[lit])
+        {
+          lit++;
+          continue;
+        }
+        size_t z = lit;
+        while (z < size && !src[z] && z - lit < 8)
+          z++;
+        if (z - lit >= 8 || z == size)
+          break;
+        lit = z;
+      }
+      varint(lit - i);
+      out.insert(out.end(), src + i, src + lit);
+      size_t z = lit;
+      while (z < size && !src[z])
+        z++;
+      varint(z - lit);
+      i = z;
+    }
+  }
+};
+
+struct snapshot_reader
+{
+  const uchar *p, *end;
+  bool ok;
+
+  UINT64 varint()
+  {
+    UINT64 v = 0;
+    for (int sh = 0; ok && sh < 64; sh += 7)
+    {
+      if (p >= end)
+        break;
+      uchar b = *p++;
+      v |= UINT64(b & 0x7f) << sh;
+      if (!(b & 0x80))
+        return v;
+    }
+    ok = false;
+    return 0;
+  }
+
+  bool data(uchar *dst, UINT64 size)
+  {
+    for (UINT64 pos = 0; ok && pos < size;)
+    {
+      UINT64 lit = varint();
+      if (!ok || lit > size - pos || lit > UINT64(end - p))
+        return ok = false;
+      memcpy(dst + pos, p, size_t(lit));
+      p += lit;
+      pos += lit;
+      UINT64 z = varint();
+      if (!ok || z > size - pos || (!lit && !z))
+        return ok = false;
+      memset(dst + pos, 0, size_t(z));
+      pos += z;
+    }
+    return ok;
+  }
+};
+} // namespace
+
+/* Selects load_raw by decoder name (as returned by unpack_function_name()) */
+bool LibRaw::snapshot_select_decoder(const char *name)
+{
+  typedef void (LibRaw::*loader_t)();
+  static const loader_t loaders[] = {
+      &LibRaw::android_tight_load_raw,
+      &LibRaw::android_loose_load_raw,
+      &LibRaw::vc5_dng_load_raw_placeholder,
+      &LibRaw::jxl_dng_load_raw_placeholder,
+      &LibRaw::canon_600_load_raw,
+      &LibRaw::fuji_compressed_load_raw,
+      &LibRaw::fuji_14bit_load_raw,
+      &LibRaw::canon_load_raw,
+      &LibRaw::lossless_jpeg_load_raw,
+      &LibRaw::canon_sraw_load_raw,
+      &LibRaw::crxLoadRaw,
+      &LibRaw::lossless_dng_load_raw,
+      &LibRaw::packed_dng_load_raw,
+      &LibRaw::pentax_load_raw,
+      &LibRaw::nikon_load_raw,
+      &LibRaw::nikon_coolscan_load_raw,
+      &LibRaw::nikon_he_load_raw_placeholder,
+      &LibRaw::nikon_load_sraw,
+      &LibRaw::nikon_yuv_load_raw,
+      &LibRaw::rollei_load_raw,
+      &LibRaw::phase_one_load_raw,
+      &LibRaw::phase_one_load_raw_c,
+      &LibRaw::phase_one_load_raw_s,
+      &LibRaw::hasselblad_load_raw,
+      &LibRaw::leaf_hdr_load_raw,
+      &LibRaw::unpacked_load_raw,
+      &LibRaw::unpacked_load_raw_reversed,
+      &LibRaw::sinar_4shot_load_raw,
+      &LibRaw::imacon_full_load_raw,
+      &LibRaw::hasselblad_full_load_raw,
+      &LibRaw::packed_load_raw,
+      &LibRaw::broadcom_load_raw,
+      &LibRaw::nokia_load_raw,
+      &LibRaw::panasonic_load_raw,
+      &LibRaw::panasonicC6_load_raw,
+      &LibRaw::panasonicC7_load_raw,
+      &LibRaw::panasonicC8_load_raw,
+      &LibRaw::olympus14_load_raw,
+      &LibRaw::minolta_rd175_load_raw,
+      &LibRaw::quicktake_100_load_raw,
+      &LibRaw::kodak_radc_load_raw,
+      &LibRaw::kodak_jpeg_load_raw,
+      &LibRaw::lossy_dng_load_raw,
+      &LibRaw::kodak_dc120_load_raw,
+      &LibRaw::eight_bit_load_raw,
+      &LibRaw::kodak_c330_load_raw,
+      &LibRaw::kodak_c603_load_raw,
+      &LibRaw::kodak_262_load_raw,
+      &LibRaw::kodak_65000_load_raw,
+      &LibRaw::kodak_ycbcr_load_raw,
+      &LibRaw::kodak_rgb_load_raw,
+      &LibRaw::sony_load_raw,
+      &LibRaw::sony_ljpeg_load_raw,
+      &LibRaw::sony_ycbcr_load_raw,
+      &LibRaw::sony_arw_load_raw,
+      &LibRaw::sony_arw2_load_raw,
+      &LibRaw::sony_arq_load_raw,
+      &LibRaw::samsung_load_raw,
+      &LibRaw::samsung2_load_raw,
+      &LibRaw::samsung3_load_raw,
+      &LibRaw::smal_v6_load_raw,
+      &LibRaw::smal_v9_load_raw,
+      &LibRaw::x3f_load_raw,
+      &LibRaw::pentax_4shot_load_raw,
+      &LibRaw::deflate_dng_load_raw,
+      &LibRaw::uncompressed_fp_dng_load_raw,
+      &LibRaw::nikon_load_striped_packed_raw,
+      &LibRaw::nikon_load_padded_packed_raw,
+      &LibRaw::nikon_14bit_load_raw,
+      &LibRaw::unpacked_load_raw_fuji_f700s20,
+      &LibRaw::unpacked_load_raw_FujiDBP,
+#ifdef USE_6BY9RPI
+      &LibRaw::rpi_load_raw8,
+      &LibRaw::rpi_load_raw12,
+      &LibRaw::rpi_load_raw14,
+      &LibRaw::rpi_load_raw16,
+#endif
+  };
+  for (unsigned i = 0; i < sizeof(loaders) / sizeof(loaders[0]); i++)
+  {
+    load_raw = loaders[i];
+    const char *n = unpack_function_name();
+    if (n && !strcmp(n, name))
+      return true;
+  }
+  load_raw = 0;
+  return false;
+}
+
+int LibRaw::save_snapshot(void **snapshot, size_t *snapshot_size)
+{
+  CHECK_ORDER_LOW(LIBRAW_PROGRESS_IDENTIFY);
+  CHECK_ORDER_HIGH(LIBRAW_PROGRESS_LOAD_RAW);
+  if (!snapshot || !snapshot_size)
+    return LIBRAW_UNSPECIFIED_ERROR;
+  *snapshot = 0;
+  *snapshot_size = 0;
+  if (!ID.input)
+    return LIBRAW_INPUT_CLOSED;
+  const char *decoder = unpack_function_name();
+  if (!decoder || _x3f_data)
+    return LIBRAW_NOT_IMPLEMENTED; /* decoder keeps own parser state */
+
+  try
+  {
+    std::vector<libraw_snapshot_state_t> stv(1);
+    libraw_snapshot_state_t &st = stv[0];
+    st.idata = imgdata.idata;
+    st.sizes = imgdata.sizes;
+    st.lens = imgdata.lens;
+    st.makernotes = imgdata.makernotes;
+    st.shootinginfo = imgdata.shootinginfo;
+    st.color = imgdata.color;
+    st.other = imgdata.other;
+    st.thumbnail = imgdata.thumbnail;
+    st.thumbs_list = imgdata.thumbs_list;
+    st.process_warnings = imgdata.process_warnings;
+    st.ioparams = libraw_internal_data.internal_output_params;
+    st.identify_data = libraw_internal_data.identify_data;
+    st.unpacker_data = libraw_internal_data.unpacker_data;
+    st.profile_offset = ID.profile_offset;
+    st.toffset = ID.toffset;
+    memmove(st.pana_black, ID.pana_black, sizeof(st.pana_black));
+    st.identified_width = ID.identified_width;
+    st.identified_height = ID.identified_height;
+
+    st.idata.xmpdata = 0;
+    st.color.profile = 0;
+    st.thumbnail.thumb = 0;
+    st.makernotes.nikon.BurstTable_0x0056 = 0;
+    for (int i = 0; i < LIBRAW_AFDATA_MAXCOUNT; i++)
+      st.makernotes.common.afdata[i].AFInfoData = 0;
+    for (int i = 0; i < LIBRAW_CRXTRACKS_MAXCOUNT; i++)
+    {
+      crx_data_header_t &h = st.unpacker_data.crx_header[i];
+      h.stsc_data = 0;
+      h.sample_sizes = 0;
+      h.chunk_offsets = 0;
+      h.sample_offsets = 0;
+    }
+    /* tone curve is identity for most files: store difference */
+    for (int i = 0; i < 0x10000; i++)
+      st.color.curve[i] ^= ushort(i);
+
+    std::vector<tiff_ifd_t> ifds(tiff_ifd, tiff_ifd + LIBRAW_IFD_MAXCOUNT);
+    for (int i = 0; i < LIBRAW_IFD_MAXCOUNT; i++)
+    {
+      ifds[i].strip_offsets = 0;
+      ifds[i].strip_byte_counts = 0;
+      ifds[i].dng_levels.dng_cblack = 0;
+      ifds[i].dng_levels.dng_fcblack = 0;
+    }
+
+    snapshot_writer w;
+    w.out.resize(sizeof(snapshot_header_t));
+    w.section(SNAP_STATE, 0, &st, sizeof(st));
+    w.section(SNAP_TIFF_IFD, 0, ifds.data(), ifds.size() * sizeof(tiff_ifd_t));
+    w.section(SNAP_DECODER, 0, decoder, strlen(decoder) + 1);
+    if (pentax_component_load_raw)
+    {
+      void (LibRaw::*save_load_raw)() = load_raw;
+      load_raw = pentax_component_load_raw;
+      const char *n = unpack_function_name();
+      load_raw = save_load_raw;
+      if (!n)
+        return LIBRAW_NOT_IMPLEMENTED;
+      w.section(SNAP_COMPONENT_DECODER, 0, n, strlen(n) + 1);
+    }
+    w.section(SNAP_XMP, 0, imgdata.idata.xmpdata, imgdata.idata.xmplen);
+    w.section(SNAP_PROFILE, 0, imgdata.color.profile, imgdata.color.profile_length);
+    w.section(SNAP_BURSTTABLE, 0, MN.nikon.BurstTable_0x0056,
+              MN.nikon.BurstTable_0x0056_len);
+    for (int i = 0; i < LIBRAW_AFDATA_MAXCOUNT; i++)
+      w.section(SNAP_AFDATA, i, MN.common.afdata[i].AFInfoData,
+                MN.common.afdata[i].AFInfoData_length);
+    for (int i = 0; i < LIBRAW_IFD_MAXCOUNT; i++)
+    {
+      tiff_ifd_t &t = tiff_ifd[i];
+      w.section(SNAP_IFD_STRIP_OFFSETS, i, t.strip_offsets,
+                MAX(t.strip_offsets_count, 0) * sizeof(INT64));
+      w.section(SNAP_IFD_STRIP_BYTES, i, t.strip_byte_counts,
+                MAX(t.strip_byte_counts_count, 0) * sizeof(INT64));
+      w.section(SNAP_IFD_CBLACK, i, t.dng_levels.dng_cblack,
+                LIBRAW_CBLACK_SIZE * sizeof(unsigned));
+      w.section(SNAP_IFD_FCBLACK, i, t.dng_levels.dng_fcblack,
+                LIBRAW_CBLACK_SIZE * sizeof(float));
+    }
+    for (int i = 0; i < LIBRAW_CRXTRACKS_MAXCOUNT; i++)
+    {
+      crx_data_header_t &h = libraw_internal_data.unpacker_data.crx_header[i];
+      w.section(SNAP_CRX_STSC, i, h.stsc_data,
+                h.stsc_count * sizeof(crx_sample_to_chunk_t));
+      w.section(SNAP_CRX_SAMPLE_SIZES, i, h.sample_sizes,
+                h.sample_count * sizeof(int32_t));
+      w.section(SNAP_CRX_CHUNK_OFFSETS, i, h.chunk_offsets,
+                h.chunk_count * sizeof(INT64));
+    }
+
+    snapshot_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memmove(hdr.magic, snapshot_magic, sizeof(hdr.magic));
+    hdr.version = LIBRAW_SNAPSHOT_VERSION;
+    hdr.libraw_version = LIBRAW_VERSION;
+    hdr.layout = snapshot_layout();
+    hdr.shot_select = imgdata.rawparams.shot_select;
+    hdr.options = imgdata.rawparams.options;
+    hdr.file_size = ID.input->size();
+    hdr.file_mtime = stream_mtime(ID.input);
+    hdr.head_hash = stream_head_hash(ID.input);
+    hdr.body_size = w.out.size() - sizeof(hdr);
+    hdr.body_hash = fnv1a(w.out.data() + sizeof(hdr), size_t(hdr.body_size));
+    memmove(w.out.data(), &hdr, sizeof(hdr));
+
+    void *blob = ::malloc(w.out.size());
+    if (!blob)
+      return LIBRAW_UNSUFFICIENT_MEMORY;
+    memmove(blob, w.out.data(), w.out.size());
+    *snapshot = blob;
+    *snapshot_size = w.out.size();
+    return LIBRAW_SUCCESS;
+  }
+  catch (const std::bad_alloc &)
+  {
+    return LIBRAW_UNSUFFICIENT_MEMORY;
+  }
+  catch (const LibRaw_exceptions &)
+  {
+    return LIBRAW_IO_ERROR;
+  }
+}
+
+void LibRaw::free_snapshot(void *snapshot)
+{
+  if (snapshot)
+    ::free(snapshot);
+}
+
+/* Restores state saved by save_snapshot(); false if snapshot is damaged
+   (all sections are checked before state is changed) */
+bool LibRaw::snapshot_restore(const uchar *data, size_t size)
+{
+  snapshot_reader r;
+  r.p = data;
+  r.end = data + size;
+  r.ok = true;
+  bool have_state = false, have_ifds = false, have_decoder = false;
+  std::vector<libraw_snapshot_state_t> stv(1);
+  libraw_snapshot_state_t &st = stv[0];
+  std::vector<tiff_ifd_t> ifds(LIBRAW_IFD_MAXCOUNT);
+  char decoder[64], component[64];
+  component[0] = 0;
+  /* pointed data sections are kept until state is in place */
+  struct blob_t
+  {
+    unsigned id, index;
+    std::vector<uchar> data;
+  };
+  std::vector<blob_t> blobs;
+
+  while (r.ok && r.p < r.end)
+  {
+    unsigned id = unsigned(r.varint());
+    UINT64 index = r.varint();
+    UINT64 len = r.varint();
+    if (!r.ok || len > UINT64(256) * 1024 * 1024)
+      return false;
+    if (id == SNAP_STATE)
+    {
+      if (len != sizeof(st) || !r.data((uchar *)&st, len))
+        return false;
+      have_state = true;
+    }
+    else if (id == SNAP_TIFF_IFD)
+    {
+      if (len != ifds.size() * sizeof(tiff_ifd_t) ||
+          !r.data((uchar *)ifds.data(), len))
+        return false;
+      have_ifds = true;
+    }
+    else if (id == SNAP_DECODER || id == SNAP_COMPONENT_DECODER)
+    {
+      char *dst = id == SNAP_DECODER ? decoder : component;
+      if (len > sizeof(decoder) || !r.data((uchar *)dst, len) ||
+          dst[len - 1])
+        return false;
+      have_decoder |= id == SNAP_DECODER;
+    }
+    else if (id >= SNAP_XMP && id <= SNAP_CRX_CHUNK_OFFSETS)
+    {
+      blobs.push_back(blob_t());
+      blob_t &b = blobs.back();
+      b.id = id;
+      b.index = unsigned(index);
+      b.data.resize(size_t(len));
+      if (!r.data(b.data.data(), len))
+        return false;
+    }
+    else
+      return false;
+  }
+  if (!r.ok || !have_state || !have_ifds || !have_decoder)
+    return false;
+  /* all sections are checked before any state is changed */
+  for (size_t k = 0; k < blobs.size(); k++)
+  {
+    const blob_t &b = blobs[k];
+    const unsigned i = b.index;
+    if ((b.id == SNAP_AFDATA && i >= LIBRAW_AFDATA_MAXCOUNT) ||
+        (b.id >= SNAP_IFD_STRIP_OFFSETS && b.id <= SNAP_IFD_FCBLACK &&
+         i >= LIBRAW_IFD_MAXCOUNT) ||
+        (b.id >= SNAP_CRX_STSC && i >= LIBRAW_CRXTRACKS_MAXCOUNT) ||
+        ((b.id == SNAP_IFD_CBLACK || b.id == SNAP_IFD_FCBLACK) &&
+         b.data.size() != LIBRAW_CBLACK_SIZE * 4))
+      return false;
+  }
+
+  if (component[0])
+  {
+    if (!snapshot_select_decoder(component))
+      return false;
+    pentax_component_load_raw = load_raw;
+  }
+  if (!snapshot_select_decoder(decoder))
+    return false;
+
+  for (int i = 0; i < 0x10000; i++)
+    st.color.curve[i] ^= ushort(i);
+  imgdata.idata = st.idata;
+  imgdata.sizes = st.sizes;
+  imgdata.lens = st.lens;
+  imgdata.makernotes = st.makernotes;
+  imgdata.shootinginfo = st.shootinginfo;
+  imgdata.color = st.color;
+  imgdata.other = st.other;
+  imgdata.thumbnail = st.thumbnail;
+  imgdata.thumbs_list = st.thumbs_list;
+  imgdata.process_warnings = st.process_warnings;
+  libraw_internal_data.internal_output_params = st.ioparams;
+  libraw_internal_data.identify_data = st.identify_data;
+  libraw_internal_data.unpacker_data = st.unpacker_data;
+  ID.profile_offset = st.profile_offset;
+  ID.toffset = st.toffset;
+  memmove(ID.pana_black, st.pana_black, sizeof(st.pana_black));
+  S.width = st.identified_width;
+  S.height = st.identified_height;
+  memmove(tiff_ifd, ifds.data(), sizeof(tiff_ifd));
+  /* pointers stored in snapshot are meaningless: all pointed data is
+     either restored from sections below or not allocated */
+  imgdata.idata.xmpdata = 0;
+  imgdata.idata.xmplen = 0;
+  imgdata.color.profile = 0;
+  imgdata.color.profile_length = 0;
+  imgdata.thumbnail.thumb = 0;
+  MN.nikon.BurstTable_0x0056 = 0;
+  MN.nikon.BurstTable_0x0056_len = 0;
+  for (int i = 0; i < LIBRAW_AFDATA_MAXCOUNT; i++)
+  {
+    MN.common.afdata[i].AFInfoData = 0;
+    MN.common.afdata[i].AFInfoData_length = 0;
+  }
+  for (int i = 0; i < LIBRAW_IFD_MAXCOUNT; i++)
+  {
+    tiff_ifd[i].strip_offsets = 0;
+    tiff_ifd[i].strip_offsets_count = 0;
+    tiff_ifd[i].strip_byte_counts = 0;
+    tiff_ifd[i].strip_byte_counts_count = 0;
+    tiff_ifd[i].dng_levels.dng_cblack = 0;
+    tiff_ifd[i].dng_levels.dng_fcblack = 0;
+  }
+  for (int i = 0; i < LIBRAW_CRXTRACKS_MAXCOUNT; i++)
+  {
+    crx_data_header_t &h = libraw_internal_data.unpacker_data.crx_header[i];
+    h.stsc_data = 0;
+    h.sample_sizes = 0;
+    h.chunk_offsets = 0;
+    h.sample_offsets = 0;
+    h.stsc_count = h.chunk_count = 0;
+    if (h.sample_size == 0)
+      h.sample_count = 0;
+  }
+
+  for (size_t k = 0; k < blobs.size(); k++)
+  {
+    blob_t &b = blobs[k];
+    size_t len = b.data.size();
+    void *p = calloc(len + 1, 1);
+    if (!p)
+      throw LIBRAW_EXCEPTION_ALLOC;
+    memmove(p, b.data.data(), len);
+    unsigned i = b.index;
+    switch (b.id)
+    {
+    case SNAP_XMP:
+      imgdata.idata.xmpdata = (char *)p;
+      imgdata.idata.xmplen = unsigned(len);
+      break;
+    case SNAP_PROFILE:
+      imgdata.color.profile = p;
+      imgdata.color.profile_length = unsigned(len);
+      break;
+    case SNAP_BURSTTABLE:
+      MN.nikon.BurstTable_0x0056 = (uchar *)p;
+      MN.nikon.BurstTable_0x0056_len = unsigned(len);
+      break;
+    default:
+      crx_data_header_t &h = libraw_internal_data.unpacker_data.crx_header[i % LIBRAW_CRXTRACKS_MAXCOUNT];
+      switch (b.id)
+      {
+      case SNAP_AFDATA:
+        MN.common.afdata[i].AFInfoData = (uchar *)p;
+        MN.common.afdata[i].AFInfoData_length = unsigned(len);
+        break;
+      case SNAP_IFD_STRIP_OFFSETS:
+        tiff_ifd[i].strip_offsets = (INT64 *)p;
+        tiff_ifd[i].strip_offsets_count = int(len / sizeof(INT64));
+        break;
+      case SNAP_IFD_STRIP_BYTES:
+        tiff_ifd[i].strip_byte_counts = (INT64 *)p;
+        tiff_ifd[i].strip_byte_counts_count = int(len / sizeof(INT64));
+        break;
+      case SNAP_IFD_CBLACK:
+        tiff_ifd[i].dng_levels.dng_cblack = (unsigned *)p;
+        break;
+      case SNAP_IFD_FCBLACK:
+        tiff_ifd[i].dng_levels.dng_fcblack = (float *)p;
+        break;
+      case SNAP_CRX_STSC:
+        h.stsc_data = (crx_sample_to_chunk_t *)p;
+        h.stsc_count = uint32_t(len / sizeof(crx_sample_to_chunk_t));
+        break;
+      case SNAP_CRX_SAMPLE_SIZES:
+        h.sample_sizes = (int32_t *)p;
+        h.sample_count = uint32_t(len / sizeof(int32_t));
+        break;
+      case SNAP_CRX_CHUNK_OFFSETS:
+        h.chunk_offsets = (INT64 *)p;
+        h.chunk_count = uint32_t(len / sizeof(INT64));
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+int LibRaw::open_with_snapshot(LibRaw_abstract_datastream *stream,
+                               const void *snapshot, size_t snapshot_size)
+{
+  if (!stream)
+    return ENOENT;
+  if (!stream->valid())
+    return LIBRAW_IO_ERROR;
+  const snapshot_header_t *hdr = (const snapshot_header_t *)snapshot;
+  if (!snapshot || snapshot_size < sizeof(snapshot_header_t) ||
+      memcmp(hdr->magic, snapshot_magic, sizeof(hdr->magic)) ||
+      hdr->version != LIBRAW_SNAPSHOT_VERSION ||
+      hdr->libraw_version != LIBRAW_VERSION ||
+      hdr->layout != snapshot_layout() ||
+      hdr->body_size != snapshot_size - sizeof(snapshot_header_t) ||
+      hdr->shot_select != imgdata.rawparams.shot_select ||
+      hdr->options != imgdata.rawparams.options)
+    return LIBRAW_SNAPSHOT_MISMATCH;
+  const uchar *body = (const uchar *)snapshot + sizeof(snapshot_header_t);
+  if (hdr->body_hash != fnv1a(body, size_t(hdr->body_size)))
+    return LIBRAW_SNAPSHOT_MISMATCH;
+  /* same file: size, modification time (if known) and header bytes */
+  if (hdr->file_size != stream->size() ||
+      hdr->file_mtime != stream_mtime(stream) ||
+      hdr->head_hash != stream_head_hash(stream))
+    return LIBRAW_SNAPSHOT_MISMATCH;
+
+  recycle();
+  try
+  {
+    ID.input = stream;
+    SET_PROC_FLAG(LIBRAW_PROGRESS_OPEN);
+    if (!snapshot_restore(body, size_t(hdr->body_size)))
+    {
+      ID.input = 0;
+      recycle();
+      return LIBRAW_SNAPSHOT_MISMATCH;
+    }
+    SET_PROC_FLAG(LIBRAW_PROGRESS_IDENTIFY);
+  }
+  catch (const std::bad_alloc&)
+  {
+    EXCEPTION_HANDLER(LIBRAW_EXCEPTION_ALLOC);
+  }
+  catch (const LibRaw_exceptions& err)
+  {
+    EXCEPTION_HANDLER(err);
+  }
+  return open_datastream_tail();
+}
+
+int LibRaw::open_file_with_snapshot(const char *fname, const void *snapshot,
+                                    size_t snapshot_size)
+{
+  LibRaw_abstract_datastream *stream;
+  try
+  {
+#ifdef LIBRAW_WIN32_CALLS
+    stream = new LibRaw_bigfile_buffered_datastream(fname);
+#else
+    stream = new LibRaw_bigfile_datastream(fname);
+#endif
+  }
+  catch (const std::bad_alloc&)
+  {
+    recycle();
+    return LIBRAW_UNSUFFICIENT_MEMORY;
+  }
+  if (!stream->valid())
+  {
+    delete stream;
+    return LIBRAW_IO_ERROR;
+  }
+  ID.input_internal = 0; // preserve from deletion on error
+  int ret = open_with_snapshot(stream, snapshot, snapshot_size);
+  if (ret == LIBRAW_SUCCESS)
+  {
+    ID.input_internal = 1; // flag to delete datastream on recycle
+  }
+  else
+  {
+    delete stream;
+    ID.input_internal = 0;
+  }
+  return ret;
+}
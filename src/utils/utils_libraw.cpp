@@ -55,6 +55,8 @@ extern "C"
       return "Decoder not implemented for this data format";
     case LIBRAW_REQUEST_FOR_NONEXISTENT_THUMBNAIL:
       return "Request for nonexisting thumbnail number";
+    case LIBRAW_SNAPSHOT_MISMATCH:
+      return "Metadata snapshot does not match file or library version";
     case LIBRAW_MEMPOOL_OVERFLOW:
       return "Libraw internal mempool overflowed";
     case LIBRAW_UNSUFFICIENT_MEMORY:
@@ -345,6 +347,7 @@ int LibRaw::is_curve_linear()
 
 void LibRaw::free_image(void)
 {
+  fused_output_reset();
   if (imgdata.image)
   {
     free(imgdata.image);
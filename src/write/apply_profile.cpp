@@ -65,7 +65,16 @@ void LibRaw::apply_profile(const char *input, const char *output)
   RUN_CALLBACK(LIBRAW_PROGRESS_APPLY_PROFILE, 0, 2);
   hTransform = cmsCreateTransform(hInProfile, TYPE_RGBA_16, hOutProfile,
                                   TYPE_RGBA_16, INTENT_PERCEPTUAL, 0);
-  cmsDoTransform(hTransform, image, image, width * height);
+  if (imgdata.params.fused_output)
+  {
+    /* sample transform on grid, applied by output functions */
+    ushort(*grid)[4] = fused_output_grid();
+    cmsDoTransform(hTransform, grid, grid,
+                   LIBRAW_FUSED_LUT_SIZE * LIBRAW_FUSED_LUT_SIZE *
+                       LIBRAW_FUSED_LUT_SIZE);
+  }
+  else
+    cmsDoTransform(hTransform, image, image, width * height);
   raw_color = 1; /* Don't use rgb_cam with a profile */
   cmsDeleteTransform(hTransform);
   cmsCloseProfile(hOutProfile);
@@ -168,6 +168,8 @@ void LibRaw::write_ppm_tiff()
         if (fuji_width)
             perc /= 2;
         if (!((highlight & ~2) || no_auto_bright))
+        {
+            fused_output_histogram();
             for (t_white = c = 0; c < colors; c++)
             {
                 for (val = 0x2000, total = 0; --val > 32;)
@@ -176,6 +178,7 @@ void LibRaw::write_ppm_tiff()
                 if (t_white < val)
                     t_white = val;
             }
+        }
         gamma_curve(gamm[0], gamm[1], 2, int((t_white << 3) / bright));
         iheight = height;
         iwidth = width;
@@ -224,13 +227,30 @@ void LibRaw::write_ppm_tiff()
         soff = flip_index(0, 0);
         cstep = flip_index(0, 1) - soff;
         rstep = flip_index(1, 0) - flip_index(0, width);
+        /* fused output: image is converted row by row */
+        const bool fused = libraw_internal_data.output_data.fused.active != 0;
+        std::vector<ushort> fused_row(fused ? width * 4 : 0);
+        ushort(*fused_buf)[4] = (ushort(*)[4])fused_row.data();
         for (row = 0; row < height; row++, soff += rstep)
         {
-            for (col = 0; col < width; col++, soff += cstep)
-                if (output_bps == 8)
-                    FORCC ppm[col * colors + c] = curve[image[soff][c]] >> 8;
-                else
-                    FORCC ppm2[col * colors + c] = curve[image[soff][c]];
+            if (fused)
+            {
+                fused_output_row(soff, cstep, width, fused_buf);
+                soff += width * cstep;
+                for (col = 0; col < width; col++)
+                    if (output_bps == 8)
+                        FORCC ppm[col * colors + c] = curve[fused_buf[col][c]] >> 8;
+                    else
+                        FORCC ppm2[col * colors + c] = curve[fused_buf[col][c]];
+            }
+            else
+            {
+                for (col = 0; col < width; col++, soff += cstep)
+                    if (output_bps == 8)
+                        FORCC ppm[col * colors + c] = curve[image[soff][c]] >> 8;
+                    else
+                        FORCC ppm2[col * colors + c] = curve[image[soff][c]];
+            }
             if (output_bps == 16 && !output_tiff && htons(0x55aa) != 0x55aa)
                 libraw_swab(ppm2, width * colors * 2);
             fwrite(ppm.data(), colors * output_bps / 8, width, ofp);